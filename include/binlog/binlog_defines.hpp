@@ -12,6 +12,8 @@ inline constexpr size_t ST_SERVER_VER_LEN = 50;
 inline constexpr size_t ST_SERVER_VER_SPLIT_LEN = 3;
 inline constexpr size_t LOG_EVENT_HEADER_LEN = 19;
 inline constexpr size_t BINLOG_CHECKSUM_ALG_DESC_LEN = 1;
+inline constexpr uint8_t BINLOG_CHECKSUM_ALG_OFF = 0;
+inline constexpr uint8_t BINLOG_CHECKSUM_ALG_CRC32 = 1;
 inline constexpr size_t MAX_DBS_IN_EVENT_MTS = 16;
 inline constexpr size_t NAME_CHAR_LEN = 64;
 inline constexpr size_t SYSTEM_CHARSET_MBMAXLEN = 3;
@@ -35,6 +37,8 @@ struct Uuid {
   static constexpr size_t BYTE_LENGTH = 16;
 
   std::array<unsigned char, BYTE_LENGTH> bytes;
+
+  auto operator<=>(const Uuid&) const = default;
 };
 
 struct Tag {
@@ -2,6 +2,7 @@
 #define _BINLOG_EVENTS_HPP
 
 #include <binlog/binlog_defines.hpp>
+#include <utils/shared_view.hpp>
 #include <utils/string_buffer_reader.hpp>
 
 #include <cstdint>
@@ -211,6 +212,9 @@ struct FormatDescriptionEvent : BinlogEvent {
   bool dont_set_created;
   uint8_t common_header_len;
   std::vector<uint8_t> post_header_len;
+  /// Checksum algorithm of the events described, `BINLOG_CHECKSUM_ALG_*`.
+  uint8_t checksum_alg{BINLOG_CHECKSUM_ALG_OFF};
+  /// The events described end with a CRC32 checksum.
   bool has_checksum{false};
 };
 
@@ -232,8 +236,13 @@ public:
       ENCODED_FLAG_LENGTH + ENCODED_SID_LENGTH + ENCODED_GNO_LENGTH +
       LOGICAL_TIMESTAMP_TYPECODE_LENGTH + LOGICAL_TIMESTAMP_LENGTH;
 
+  /// @brief Start of a transaction, also of an anonymous one, which has the same layout.
+  /// Fields after the logical timestamps are read if the server writes them.
+  GtidEvent(utils::StringBufferReader& reader, FormatDescriptionEvent* fde);
   virtual ~GtidEvent() = default;
 
+  void show(std::ostream& out = std::cout) const;
+
   struct GtidInfo {
     int32_t rpl_gtid_sidno;
     int64_t rpl_gtid_gno;
@@ -249,12 +258,12 @@ public:
   unsigned const char FLAG_MAY_HAVE_SBR = 1;
   bool may_have_sbr_stmts;
   unsigned char gtid_flags = 0;
-  uint64_t original_commit_timestamp;
-  uint64_t immediate_commit_timestamp;
-  bool has_commit_timestamps;
-  uint64_t transaction_length;
-  uint32_t original_server_version;
-  uint32_t immediate_server_version;
+  uint64_t original_commit_timestamp{0};
+  uint64_t immediate_commit_timestamp{0};
+  bool has_commit_timestamps{false};
+  uint64_t transaction_length{0};
+  uint32_t original_server_version{0};
+  uint32_t immediate_server_version{0};
   uint64_t commit_group_ticket{kGroupTicketUnset};
 
   GtidInfo gtid_info_struct;
@@ -325,6 +334,9 @@ struct PreviousGtidEvent : BinlogEvent {
   using UPtr = std::unique_ptr<PreviousGtidEvent>;
   using SPtr = std::shared_ptr<PreviousGtidEvent>;
 
+  /// @brief Transactions written to the preceding binlog files, stored in `buf` in the
+  /// binary form of `GtidSet`.
+  PreviousGtidEvent(utils::StringBufferReader& reader, FormatDescriptionEvent* fde);
   virtual ~PreviousGtidEvent() = default;
 
   std::string buf;
@@ -340,6 +352,10 @@ struct QueryEvent : BinlogEvent {
     TERNARY_ON
   };
 
+  QueryEvent() = default;
+  /// @brief Statement logged as text. Only the fields of the post-header, `db` and
+  /// `query` are read, the status variables are skipped.
+  QueryEvent(utils::StringBufferReader& reader, FormatDescriptionEvent* fde);
   virtual ~QueryEvent() = default;
 
   std::string query;
@@ -426,7 +442,14 @@ struct RowsEvent : BinlogEvent {
   using SPtr = std::shared_ptr<RowsEvent>;
 
   explicit RowsEvent(LogEventType type);
-  RowsEvent(utils::StringBufferReader& reader, FormatDescriptionEvent* fde);
+  /**
+   * @param[in] owner Owner of the memory read by `reader`. If it is set `row` views the
+   * memory instead of copying it.
+   */
+  RowsEvent(
+      utils::StringBufferReader& reader, FormatDescriptionEvent* fde,
+      std::shared_ptr<const void> owner = nullptr
+  );
 
   virtual ~RowsEvent() = default;
 
@@ -440,14 +463,18 @@ struct RowsEvent : BinlogEvent {
   uint16_t var_header_len;
   std::vector<uint8_t> columns_before_image;
   std::vector<uint8_t> columns_after_image;
-  std::vector<uint8_t> row;
+  /// @brief Row images. Always owns its memory.
+  utils::SharedView row;
 };
 
 struct DeleteRowsEvent : RowsEvent {
   using UPtr = std::unique_ptr<DeleteRowsEvent>;
   using SPtr = std::shared_ptr<DeleteRowsEvent>;
 
-  DeleteRowsEvent(utils::StringBufferReader& reader, FormatDescriptionEvent* fde);
+  DeleteRowsEvent(
+      utils::StringBufferReader& reader, FormatDescriptionEvent* fde,
+      std::shared_ptr<const void> owner = nullptr
+  );
 
   virtual ~DeleteRowsEvent() = default;
 
@@ -458,7 +485,10 @@ struct UpdateRowsEvent : RowsEvent {
   using UPtr = std::unique_ptr<UpdateRowsEvent>;
   using SPtr = std::shared_ptr<UpdateRowsEvent>;
 
-  UpdateRowsEvent(utils::StringBufferReader& reader, FormatDescriptionEvent* fde);
+  UpdateRowsEvent(
+      utils::StringBufferReader& reader, FormatDescriptionEvent* fde,
+      std::shared_ptr<const void> owner = nullptr
+  );
 
   virtual ~UpdateRowsEvent() = default;
 
@@ -469,7 +499,10 @@ struct WriteRowsEvent : RowsEvent {
   using UPtr = std::unique_ptr<WriteRowsEvent>;
   using SPtr = std::shared_ptr<WriteRowsEvent>;
 
-  WriteRowsEvent(utils::StringBufferReader& reader, FormatDescriptionEvent* fde);
+  WriteRowsEvent(
+      utils::StringBufferReader& reader, FormatDescriptionEvent* fde,
+      std::shared_ptr<const void> owner = nullptr
+  );
 
   virtual ~WriteRowsEvent() = default;
 
@@ -671,8 +704,12 @@ struct XidEvent : BinlogEvent {
   using UPtr = std::unique_ptr<XidEvent>;
   using SPtr = std::shared_ptr<XidEvent>;
 
+  /// @brief Commit of a transaction. `header.log_pos` is the position after it.
+  XidEvent(utils::StringBufferReader& reader, FormatDescriptionEvent* fde);
   virtual ~XidEvent() = default;
 
+  void show(std::ostream& out = std::cout) const;
+
   uint64_t xid;
 };
 
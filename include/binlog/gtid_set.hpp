@@ -0,0 +1,72 @@
+#ifndef _BINLOG_GTID_SET_HPP
+#define _BINLOG_GTID_SET_HPP
+
+#include <binlog/binlog_defines.hpp>
+#include <defines.hpp>
+#include <utils/string_buffer_reader.hpp>
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace binlog {
+
+/**
+ * @brief Set of global transaction identifiers, `uuid:gno`, as intervals of numbers per
+ * server uuid.
+ *
+ * Numbers of one server grow by one per transaction, so a set of a replication stream
+ * stays one interval per server and adding to it is constant time.
+ */
+class GtidSet {
+public:
+  DECLARE_EXCEPTION(GtidSetError);
+
+  GtidSet() = default;
+
+  /**
+   * @brief Parses the text form of `gtid_executed`: `uuid:1-5:7,uuid:1-3`.
+   * @throws `GtidSetError` Thrown if the text is malformed.
+   */
+  static GtidSet parse(std::string_view text);
+
+  /**
+   * @brief Reads the binary form of previous GTIDs events.
+   * @throws `utils::BadStream` Thrown if the data is truncated.
+   */
+  static GtidSet decode(utils::StringBufferReader& reader);
+
+  void add(const Uuid& uuid, int64_t gno);
+  void merge(const GtidSet& other);
+  bool contains(const Uuid& uuid, int64_t gno) const noexcept;
+  bool empty() const noexcept;
+
+  /// @returns The text form, accepted by `parse` and `SET GTID_PURGED`.
+  std::string toString() const;
+
+  /// @returns Size of the binary form sent with `COM_BINLOG_DUMP_GTID`.
+  size_t encodedSize() const noexcept;
+  /// @brief Writes the binary form of `encodedSize()` bytes.
+  void encode(unsigned char* out) const noexcept;
+
+  bool operator==(const GtidSet& other) const;
+
+private:
+  /// Numbers `[start, end)`.
+  struct Interval {
+    int64_t start;
+    int64_t end;
+  };
+
+  /// @brief Sorts the intervals of every server and joins overlapping ones.
+  void normalize();
+
+  /// Sorted, disjoint and not adjacent intervals of every server.
+  std::map<Uuid, std::vector<Interval>> intervals;
+};
+
+} // namespace binlog
+
+#endif
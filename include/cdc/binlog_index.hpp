@@ -0,0 +1,126 @@
+#ifndef _CDC_BINLOG_INDEX_HPP
+#define _CDC_BINLOG_INDEX_HPP
+
+#include <binlog/binlog_defines.hpp>
+#include <cdc/checkpoint.hpp>
+#include <utils/mapped_file.hpp>
+
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <span>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+namespace cdc {
+
+struct BinlogIndexOptions {
+  /// Every `interval`-th event is indexed besides the starts of transactions. `0` indexes
+  /// the starts only.
+  uint32_t interval{1024};
+};
+
+/// @brief Indexed event, stored as is in the index file.
+struct BinlogIndexEntry {
+  enum Flags : uint8_t {
+    TRANSACTION_START = 1,
+    /// `uuid` and `gno` are the GTID of the transaction.
+    HAS_GTID = 2
+  };
+
+  /// Offset of the event in the binlog file.
+  uint64_t offset;
+  /// Table of table map and rows events, `0` for other events.
+  uint64_t table_id;
+  int64_t gno;
+  binlog::Uuid uuid;
+  /// Timestamp of the event, `header.when`.
+  uint32_t when;
+  uint8_t type;
+  uint8_t flags;
+  uint16_t reserved;
+
+  bool transactionStart() const noexcept
+  {
+    return flags & TRANSACTION_START;
+  }
+};
+
+static_assert(std::is_trivially_copyable_v<BinlogIndexEntry>);
+static_assert(sizeof(BinlogIndexEntry) == 48);
+
+/**
+ * @brief Sidecar index of a binlog file, `<binlog>.idx`, to start reading at a time, a
+ * GTID or an arbitrary event without scanning the file from its start.
+ *
+ * The index records the starts of transactions and every `interval`-th event. Updating
+ * the index reads the events appended since the last update only, so the index of the
+ * file being written by the server is kept up to date cheaply. The index is mapped into
+ * memory for the lookups.
+ */
+class BinlogIndex {
+public:
+  DECLARE_EXCEPTION(BinlogIndexError);
+
+  /// @returns Path of the index of the binlog file.
+  static std::string pathOf(const std::string& binlog_path);
+
+  /**
+   * @brief Indexes the events of the binlog file appended since the last update. The
+   * index is built anew if it was built with another interval or the file was replaced.
+   *
+   * @returns Number of the newly indexed events.
+   * @throws `BinlogIndexError` Thrown if the binlog file is corrupted.
+   */
+  static uint64_t update(const std::string& binlog_path, BinlogIndexOptions options = {});
+
+  /// @brief Updates the index of the binlog file and maps it.
+  static BinlogIndex
+  open(const std::string& binlog_path, BinlogIndexOptions options = {});
+
+  std::span<const BinlogIndexEntry> entries() const noexcept
+  {
+    return items;
+  }
+
+  /// @returns Size of the indexed part of the binlog file.
+  uint64_t indexedBytes() const noexcept
+  {
+    return indexed_bytes;
+  }
+
+  /// @returns The last entry at or before `position`, reading from it reaches the event
+  /// at `position`. With `transaction_start` the last transaction starting there.
+  const BinlogIndexEntry* atPosition(uint64_t position, bool transaction_start) const;
+
+  /// @returns The first transaction starting at `when` or later. Timestamps of the events
+  /// are expected to grow along the file.
+  const BinlogIndexEntry* atTime(uint32_t when) const;
+
+  /// @returns Start of the transaction with the GTID.
+  const BinlogIndexEntry* atGtid(const binlog::Uuid& uuid, int64_t gno) const;
+
+  /**
+   * @brief Looks for the first transaction starting at `when` or later in the binlog
+   * files, updating their indexes on the way.
+   *
+   * @param[in] binlog_paths Files in the order of the binlog.
+   * @returns Position of the transaction, `std::nullopt` if the files end before `when`.
+   */
+  static std::optional<BinlogPosition> seekTime(
+      const std::vector<std::string>& binlog_paths, uint32_t when,
+      BinlogIndexOptions options = {}
+  );
+
+private:
+  BinlogIndex(std::shared_ptr<const utils::MappedFile> mapping);
+
+  std::shared_ptr<const utils::MappedFile> mapping;
+  std::span<const BinlogIndexEntry> items;
+  uint64_t indexed_bytes{0};
+};
+
+} // namespace cdc
+
+#endif
@@ -2,20 +2,35 @@
 #define _BUFFER_SOURCE_HPP
 
 #include <binlog/binlog_events.hpp>
+#include <binlog/gtid_set.hpp>
+#include <cdc/checkpoint.hpp>
+#include <cdc/row_decoder.hpp>
+#include <cdc/table_schema.hpp>
+#include <cdc/verification.hpp>
 #include <conveyor.hpp>
 #include <utils/bit_buffer_reader.hpp>
+#include <utils/buffer_pool.hpp>
+#include <utils/shared_view.hpp>
+#include <utils/spsc_ring.hpp>
 #include <utils/string_buffer_reader.hpp>
 
+#include <components/cursor/cursor.hpp>
 #include <components/document/document.hpp>
+#include <components/logical_plan/node_create_index.hpp>
 #include <components/logical_plan/node_delete.hpp>
 #include <components/logical_plan/node_insert.hpp>
 #include <components/logical_plan/node_update.hpp>
 #include <components/logical_plan/param_storage.hpp>
+#include <atomic>
 #include <concepts>
+#include <condition_variable>
 #include <functional>
+#include <future>
 #include <integration/cpp/otterbrix.hpp>
 //#include <mysql/mysql.h>
 #include <mysql.h>
+#include <mutex>
+#include <thread>
 #include <span>
 #include <type_traits>
 #include <variant>
@@ -24,17 +39,21 @@ namespace cdc {
 
 struct TableDiff;
 
+struct TransactionBatch;
+
 struct ExtendedNode;
 
-using Buffer = std::string_view;
+/// Owning if the buffer source keeps its buffers after the next fetch.
+using Buffer = utils::SharedView;
 using Binlog = binlog::event::BinlogEvent::UPtr;
 using RotateBinlog = binlog::event::RotateEvent::UPtr;
 using BufferSourceI = conveyor::Source<Buffer>;
 using EventSourceI = conveyor::Source<Binlog>;
 using TableDiffSourceI = conveyor::Source<TableDiff>;
-using OtterBrixDiffSinkI = conveyor::Sink<TableDiff>;
+using TransactionSourceI = conveyor::Source<TransactionBatch>;
+using OtterBrixDiffSinkI = conveyor::Sink<TransactionBatch>;
 using OtterBrixConsumerI = conveyor::Sink<ExtendedNode>;
-using MainProcess = conveyor::Universal<TableDiff>;
+using MainProcess = conveyor::Universal<TransactionBatch>;
 
 using node_t = components::logical_plan::node_t;
 using node_ptr = components::logical_plan::node_ptr;
@@ -55,27 +74,66 @@ using map_t = std::unordered_map<K, V>;
 template<typename T>
 using set_t = std::unordered_set<T>;
 
+/// @brief Dependency of a transaction on the previous ones, numbered per binlog file.
+struct LogicalClock {
+  /// Number of the last transaction committed before this one was prepared.
+  int64_t last_committed;
+  int64_t sequence_number;
+};
+
 struct TableDiff {
   enum Type {
     INSERT,
     DELETE,
-    UPDATE
+    UPDATE,
+    /// End of a transaction. Has `position` only.
+    COMMIT,
+    /// The diffs since the last `COMMIT` are sent again and must be discarded.
+    ROLLBACK
   } type;
 
-  std::string collection_name;
-  std::string table_name;
-  std::string column_types;
-  std::string column_metatypes;
-  std::vector<std::string> column_name_list;
-  std::vector<uint16_t> column_primary_key_list;
-  std::string column_signedness;
-  std::vector<uint8_t> row;
-  int64_t width{0};
+  /// Shared by all diffs of the table until its definition changes.
+  TableSchema::SPtr schema{};
+  /// Row images of the rows event, shared with it.
+  utils::SharedView row{};
+  /// Columns present in before-images of deletes and updates, as described by
+  /// `binlog_row_image`. Empty means all columns.
+  std::vector<uint8_t> columns_before_image{};
+  /// Columns present in after-images of inserts and updates. Empty means all columns.
+  std::vector<uint8_t> columns_after_image{};
+  /// Position after the transaction of `COMMIT`.
+  std::optional<BinlogPosition> position{};
+  /// Logical clock of the transaction of `COMMIT` if the server writes it.
+  std::optional<LogicalClock> clock{};
+};
+
+/// @brief Table diffs of one transaction, the last one is its `COMMIT`.
+struct TransactionBatch {
+  std::vector<TableDiff> diffs;
 };
 
 struct ExtendedNode {
-  node_ptr node;
-  components::logical_plan::parameter_node_ptr parameter;
+  node_ptr node{};
+  components::logical_plan::parameter_node_ptr parameter{};
+  /// Inserted documents or the `$set` document of an update.
+  std::vector<components::document::document_ptr> documents{};
+  /// Primary keys of the affected rows. For inserts the i-th key belongs to the i-th
+  /// document.
+  std::vector<std::string> keys{};
+  /// Set on checkpoint markers, which have no plan: every change before the position
+  /// is in the preceding plans.
+  std::optional<BinlogPosition> checkpoint{};
+  /// Partition of the keys of the plan, see `PlanBatchOptions::partitions`.
+  size_t partition{0};
+};
+
+struct PrefetchOptions {
+  /// Fetch events on a dedicated thread ahead of the consumer.
+  bool enabled{false};
+  /// Maximum number of fetched buffers waiting for the consumer.
+  size_t depth{1024};
+  /// Limit of memory kept by released buffers for reuse.
+  size_t pool_bytes{64 * 1024 * 1024};
 };
 
 struct DBBufferSource final : BufferSourceI {
@@ -83,16 +141,34 @@ struct DBBufferSource final : BufferSourceI {
   DECLARE_EXCEPTION(DBConnectionError);
   DECLARE_EXCEPTION(DBBinlogError);
 
+  /**
+   * @param[in] prefetch_options Without prefetching buffers are views of the connection
+   * buffer, valid until the next fetch. With prefetching every buffer owns a copy of the
+   * event taken from a buffer pool.
+   * @param[in] start_position Position to resume from, usually the loaded checkpoint.
+   * If it has a GTID set, the stream is requested by `COM_BINLOG_DUMP_GTID` from it, and
+   * reconnects resume after the received transactions instead of a file position.
+   */
   DBBufferSource(
       const char* host, const char* user, const char* passwd, const char* db,
-      unsigned int port
+      unsigned int port, PrefetchOptions prefetch_options = {},
+      std::optional<BinlogPosition> start_position = std::nullopt
   );
   virtual ~DBBufferSource();
 
+  /// @brief Without prefetching every fetch may wait for the network, so batches hold one
+  /// buffer. With prefetching batches take the already fetched buffers.
+  virtual bool ready() const final override;
+
 protected:
   virtual std::optional<Buffer> getDataImpl() final override;
 
 private:
+  struct Fetched {
+    std::optional<Buffer> buffer;
+    std::exception_ptr error;
+  };
+
   void connect();
   void disconnect();
   void rotate();
@@ -100,6 +176,10 @@ private:
   std::string_view nextEventBuffer();
   void process(std::string_view buffer);
 
+  /// @brief Body of the fetching thread.
+  void prefetch();
+  void stopPrefetch();
+
   MYSQL conn;
   MYSQL_RPL rpl;
   binlog::event::FormatDescriptionEvent fde{
@@ -112,118 +192,501 @@ private:
   const int port;
   std::string file_path;
   uint32_t next_pos{4};
+  /// The server positions the stream by `received` instead of `file_path`.
+  bool gtid_positioning{false};
+  /// Start set and the transactions received completely since.
+  binlog::GtidSet received;
+  /// GTID of the transaction being received.
+  std::optional<std::pair<binlog::Uuid, int64_t>> current_gtid;
+
+  const PrefetchOptions prefetch_options;
+  std::shared_ptr<utils::BufferPool> pool;
+  std::unique_ptr<utils::SpscRing<Fetched>> fetched;
+  std::atomic<bool> stopping{false};
+  bool finished{false};
+  std::thread fetcher;
+};
+
+/**
+ * @brief Parses event buffers. Events of unprocessed types are skipped.
+ *
+ * Transactions of the applied GTID set are skipped as a whole: their events after the
+ * GTID event are dropped without being parsed.
+ */
+struct EventParser {
+  EventParser() = default;
+  explicit EventParser(binlog::GtidSet applied);
+
+  /// @returns Parsed event or `nullptr` if the event is not processed.
+  Binlog parse(const Buffer& buffer);
+
+private:
+  binlog::GtidSet applied;
+  /// The current transaction is in `applied`.
+  bool skipping{false};
+  /// The last format description event of the stream.
+  binlog::event::FormatDescriptionEvent fde{
+      binlog::BINLOG_VERSION, binlog::SERVER_VERSION
+  };
+};
+
+/// @brief Joins rows events with the table map events preceding them.
+struct TableDiffAssembler {
+
+  DECLARE_EXCEPTION(TableDiffSourceError);
+
+  /**
+   * @param[in] executed GTID set of the transactions applied before the stream. If it is
+   * empty, the set is known from the previous GTIDs event of the first binlog file.
+   */
+  explicit TableDiffAssembler(binlog::GtidSet executed = {});
+
+  /**
+   * @brief Consumes the next event of the stream.
+   *
+   * A transaction ends with an XID event or a `COMMIT` query. Rows of a transaction
+   * without either end before the next GTID event or `BEGIN` query. A GTID event of the
+   * current transaction starts it anew, its rows so far are rolled back.
+   *
+   * @returns The table diff if the event is a rows event, `COMMIT` diff if it ends a
+   * transaction.
+   * @throws `TableDiffSourceError` Thrown if the table of a rows event is unknown.
+   */
+  std::optional<TableDiff> process(Binlog&& event);
+
+  /**
+   * @brief Ends the stream. A transaction the stream ends inside is dropped, so it is
+   * never applied in part. A restart reads it again from the checkpoint.
+   *
+   * @returns `ROLLBACK` diff if rows follow the last commit.
+   */
+  std::optional<TableDiff> finish();
+
+private:
+  /// Binlog file of the events, known from the rotate event starting the stream.
+  std::string binlog_file;
+  /// Transactions committed so far. Not known if the stream starts in the middle of a
+  /// file and no set was given.
+  std::optional<binlog::GtidSet> executed;
+  /// GTID of the current transaction, added to `executed` when it ends.
+  std::optional<std::pair<binlog::Uuid, int64_t>> current_gtid;
+  std::optional<LogicalClock> current_clock;
+  /// Rows diffs of the current transaction are passed on.
+  bool has_rows{false};
+
+  /// @returns `COMMIT` diff of the current transaction ending at the position.
+  TableDiff commit(uint64_t position);
+  void finishTransaction();
+  void submitTableInfo(const binlog::event::TableMapEvent& tm_event);
+  /// @returns Schema of the table mapped to the id or `nullptr` if it is unknown.
+  const TableSchema::SPtr* findTableInfo(const uint64_t table_id) const;
+
+  TableSchemaCache schemas;
+  map_t<uint64_t, TableSchema::SPtr> table_info_map;
+};
+
+/**
+ * @brief Groups table diffs into transactions, so a transaction is passed on only once
+ * it is committed. Rows before `ROLLBACK` are dropped, e.g. the rows left at the end of
+ * the stream, see `TableDiffAssembler::finish()`.
+ */
+struct TransactionAssembler {
+  /// @returns The transaction if the diff is its `COMMIT`.
+  std::optional<TransactionBatch> process(TableDiff&& diff);
+
+private:
+  std::vector<TableDiff> diffs;
+};
+
+/// @brief Thresholds of coalescing rows of consecutive diffs into one plan.
+struct PlanBatchOptions {
+  /// Rows of one collection per plan. `1` disables coalescing.
+  size_t max_documents{1024};
+  /// Bytes of the row images of one plan.
+  size_t max_bytes{4 * 1024 * 1024};
+  /// Rows are split by a hash of the collection and the primary key, so every plan
+  /// affects the rows of one partition only. `1` keeps the rows of a collection together.
+  size_t partitions{1};
+};
+
+/**
+ * @brief Converts table diffs into otterbrix plans.
+ *
+ * Inserted and deleted rows are held per collection and partition and passed on as one
+ * plan once a threshold of `PlanBatchOptions` is hit: inserts sorted by `_id`, deletes
+ * as one `delete_many` matching all keys. A diff of another type of the collection
+ * flushes its pending rows first, so the order of the changes of every collection is
+ * kept.
+ *
+ * Commits are passed on as checkpoint markers once no rows are pending, so batches span
+ * transactions and the marker still follows all changes before it.
+ */
+struct PlanBuilder {
+
+  DECLARE_EXCEPTION(OtterBrixDiffSinkError);
+
+  explicit PlanBuilder(
+      std::pmr::memory_resource* resource, PlanBatchOptions batch_options = {}
+  );
+
+  /// @brief Converts the diff into plans appended to `nodes`.
+  void convert(const TableDiff& data, std::vector<ExtendedNode>& nodes);
+
+  /// @brief Appends plans of all pending rows.
+  void flushPending(std::vector<ExtendedNode>& nodes);
+
+  /// @brief Appends plans deleting the rows of the insert plan by their keys, so the
+  /// rows aren't duplicated if they are inserted already.
+  void deleteInserted(const ExtendedNode& insert, std::vector<ExtendedNode>& nodes);
+
+private:
+  /// Parameters of one plan are numbered by `uint16_t`.
+  static constexpr size_t MAX_DELETE_KEYS = 0xfffe;
+
+  struct PendingRows {
+    /// `INSERT` or `DELETE`.
+    TableDiff::Type type;
+    /// Keeps the names of the collection alive.
+    TableSchema::SPtr schema;
+    /// Documents are kept for inserts only.
+    std::vector<std::pair<std::string, components::document::document_ptr>> rows{};
+    size_t bytes{0};
+    size_t partition{0};
+  };
+
+  static bool isCollectionOf(const PendingRows& pending, const TableDiff& data);
+  /// @returns Partition of the row, see `PlanBatchOptions::partitions`.
+  size_t partitionOf(const TableSchema& schema, std::string_view key) const;
+  /// @returns Pending rows of the partition of the collection of the diff, prepared for
+  /// rows of the diff.
+  PendingRows&
+  pendingFor(const TableDiff& data, size_t partition, std::vector<ExtendedNode>& nodes);
+  /// @brief Appends the plan of the pending rows and forgets them.
+  void flushRows(PendingRows& pending, std::vector<ExtendedNode>& nodes);
+  /// @brief Appends the marker of the last commit if no rows are pending.
+  void flushCheckpoint(std::vector<ExtendedNode>& nodes);
+  void flushInsertRows(PendingRows& pending, std::vector<ExtendedNode>& nodes);
+  void flushDeleteRows(PendingRows& pending, std::vector<ExtendedNode>& nodes);
+  /// @brief Appends rows of the diff to the pending rows of its collection.
+  void appendRows(const TableDiff& data, std::vector<ExtendedNode>& nodes);
+
+  struct ReadContext {
+    explicit ReadContext(const TableDiff& data);
+
+    utils::StringBufferReader row_r;
+    const TableDiff& data;
+    const RowDecoder& decoder;
+  };
+
+  void sendNodesUpdate(const TableDiff& data, std::vector<ExtendedNode>& nodes);
+
+  components::document::document_ptr getDocument(ReadContext& context);
+
+  std::pair<compare_expression_ptr, parameter_node_ptr>
+  getSelectionParameters(const std::string& key);
+
+  /**
+   * @brief Builds the match of sorted unique keys: a range if the keys are
+   * consecutive numbers, otherwise a union of equalities.
+   */
+  std::pair<compare_expression_ptr, parameter_node_ptr>
+  getSelectionParameters(const std::vector<std::string>& keys);
+
+  std::pmr::memory_resource* resource;
+  const PlanBatchOptions batch_options;
+  /// Few collections are written at once, so they are searched linearly.
+  std::vector<PendingRows> pending_rows;
+  /// Position of the last commit not passed on yet.
+  std::optional<BinlogPosition> pending_checkpoint;
 };
 
 struct EventSource final : EventSourceI {
-  EventSource(BufferSourceI::UPtr buffer_source, DataHandler event_handler);
+  /// @param[in] applied Transactions to skip, see `EventParser`.
+  EventSource(
+      BufferSourceI::UPtr buffer_source, DataHandler event_handler,
+      binlog::GtidSet applied = {}
+  );
   virtual ~EventSource() = default;
 
+  virtual bool ready() const final override;
+
 protected:
   virtual std::optional<Binlog> getDataImpl() final override;
+  virtual void getBatchImpl(std::vector<Binlog>& out, size_t max_items) final override;
 
 private:
   BufferSourceI::UPtr buffer_source;
+  EventParser parser;
+  std::vector<Buffer> buffers;
 };
 
 struct TableDiffSource final : TableDiffSourceI {
 
-  DECLARE_EXCEPTION(TableDiffSourceError);
+  using TableDiffSourceError = TableDiffAssembler::TableDiffSourceError;
 
-  TableDiffSource(EventSourceI::UPtr event_source, DataHandler table_diff_handler);
+  /// @param[in] executed See `TableDiffAssembler`.
+  TableDiffSource(
+      EventSourceI::UPtr event_source, DataHandler table_diff_handler,
+      binlog::GtidSet executed = {}
+  );
   virtual ~TableDiffSource() = default;
 
+  virtual bool ready() const final override;
+
 protected:
   virtual std::optional<TableDiff> getDataImpl() final override;
+  virtual void getBatchImpl(std::vector<TableDiff>& out, size_t max_items) final override;
 
 private:
-  using TablePtr = binlog::event::TableMapEvent::UPtr;
-  using RowsPtr = binlog::event::RowsEvent::UPtr;
-  using EventPackage = std::pair<TablePtr, RowsPtr>;
+  EventSourceI::UPtr event_source;
+  TableDiffAssembler assembler;
+  std::vector<Binlog> events;
+};
 
-  EventPackage getEventPackage();
+struct TransactionSource final : TransactionSourceI {
+  TransactionSource(
+      TableDiffSourceI::UPtr table_diff_source, DataHandler transaction_handler
+  );
+  virtual ~TransactionSource() = default;
 
-  void submitTableInfo(TablePtr&& tm_event);
-  TablePtr extractTableInfo(const uint64_t table_id);
+  virtual bool ready() const final override;
 
-  EventSourceI::UPtr event_source;
-  map_t<uint64_t, binlog::event::TableMapEvent::UPtr> table_info_map;
+protected:
+  virtual std::optional<TransactionBatch> getDataImpl() final override;
+  virtual void
+  getBatchImpl(std::vector<TransactionBatch>& out, size_t max_items) final override;
+
+private:
+  TableDiffSourceI::UPtr table_diff_source;
+  TransactionAssembler assembler;
+  std::vector<TableDiff> diffs;
 };
 
+/**
+ * @brief Converts transactions into plans. Rows are coalesced within a batch of
+ * transactions, the plans of which are passed to the consumer followed by the marker of
+ * the last one, so no marker ever follows a transaction in part.
+ */
 struct OtterBrixDiffSink final : OtterBrixDiffSinkI {
 
-  DECLARE_EXCEPTION(OtterBrixDiffSinkError);
+  using OtterBrixDiffSinkError = PlanBuilder::OtterBrixDiffSinkError;
 
   OtterBrixDiffSink(
-      OtterBrixConsumerI::UPtr otterbrix_consumer, std::pmr::memory_resource* resource
+      OtterBrixConsumerI::UPtr otterbrix_consumer, std::pmr::memory_resource* resource,
+      PlanBatchOptions batch_options = {}
   );
   virtual ~OtterBrixDiffSink() = default;
 
 protected:
-  virtual void putDataImpl(const TableDiff& data) final override;
+  virtual void putDataImpl(const TransactionBatch& data) final override;
+  virtual void putBatchImpl(std::span<const TransactionBatch> batch) final override;
+  virtual void flushImpl() final override;
+  virtual void idleImpl() final override;
 
 private:
-  using node_ptr = components::logical_plan::node_ptr;
+  /// @brief Passes accumulated plans to the consumer as one batch.
+  void submitNodes();
 
-  static const std::string PK_FIELD_NAME;
-  static const std::string PK_JSON_POINTER;
-
-  struct ReadContext {
-    explicit ReadContext(const TableDiff& data);
+  OtterBrixConsumerI::UPtr otterbrix_consumer;
+  PlanBuilder builder;
+  std::vector<ExtendedNode> nodes;
+};
 
-    utils::StringBufferReader column_metatype_r;
-    utils::StringBufferReader column_type_r;
-    utils::StringBufferReader row_r;
-    utils::BitBufferReader<utils::BitOrder::BIG_END> signedness_r;
-    const TableDiff& data;
+struct SecondaryIndex {
+  /// Full name of the collection `database.collection`.
+  std::string collection;
+  /// Indexed fields. Several fields make a composite index.
+  std::vector<std::string> fields;
+};
 
-    struct CachedData {
-      std::vector<bool> null_bitmap;
-      std::string json_pointer{[]() {
-        std::string json_pointer;
-        json_pointer.reserve(64);
-        return json_pointer;
-      }()};
-    } cached_data;
-  };
+/// @brief Indexes created by `OtterBrixConsumerSink` along with their collections.
+struct IndexOptions {
+  /// Index `_id`, which updates and deletes match, so they don't scan the collection.
+  bool primary_key{true};
+  std::vector<SecondaryIndex> secondary{};
+};
 
-  void sendNodesInsert(const TableDiff& data);
-  void sendNodesDelete(const TableDiff& data);
-  void sendNodesUpdate(const TableDiff& data);
+/**
+ * @brief Applies plans to otterbrix.
+ *
+ * Plans passed as data are applied once a checkpoint marker follows them, all plans up to
+ * the marker in one open transaction, see `beginTransaction()`. Verification scans every
+ * collection with no transaction open, so it never sees one applied in part.
+ */
+struct OtterBrixConsumerSink : OtterBrixConsumerI {
 
-  components::document::document_ptr getDocument(ReadContext& context);
+  DECLARE_EXCEPTION(OtterBrixConsumerError);
 
-  std::pair<compare_expression_ptr, parameter_node_ptr> getSelectionParameters(
-      const components::document::document_ptr& doc, ReadContext& context
+  /**
+   * @param[in] checkpoints Store of the positions of applied checkpoint markers. If it
+   * has a checkpoint, the otterbrix data of the previous run is kept to resume from it.
+   * Verification is disabled then, since digests of that data are unknown. Transactions
+   * after the checkpoint may have been applied before the restart, so the rows of every
+   * insert are deleted before it until the stream passes the last applied position, see
+   * `CheckpointStore::loadApplied()` and `extendReplayWindow()`.
+   * @param[in] index_options Indexes created before the first plan of a collection.
+   */
+  explicit OtterBrixConsumerSink(
+      DataHandler data_handler, VerificationOptions verification_options = {},
+      CheckpointStore::SPtr checkpoints = nullptr, IndexOptions index_options = {}
   );
+  virtual ~OtterBrixConsumerSink();
+
+  std::pmr::memory_resource* resource() const noexcept;
 
   /**
-   * @brief Returns the index of the column that is the primary key.
-   *
-   * @param[in] context Read context information
+   * @brief Keeps deleting the rows of inserts for `markers` checkpoint markers after the
+   * stream passes the last applied position. Callers applying up to `markers`
+   * transactions ahead of the committed marker call it, since such transactions may have
+   * been applied before the restart too.
+   */
+  void extendReplayWindow(size_t markers);
+
+  /**
+   * @brief Compares the digests of the applied data with a scan of every known
+   * collection. Every collection is scanned between transactions with applying
+   * suspended, which resumes before the next collection. So applying stalls for the scan
+   * of the largest collection at most, not for the whole check. The calling thread has
+   * no transaction open.
    *
-   * @returns The index of the primary key or '-1' if the primary keys of the table are
-   * invalid.
+   * @returns `true` if all collections match their digests.
    */
-  static int getPrimaryKeyIndex(const ReadContext& context) noexcept;
+  bool verify();
 
-  OtterBrixConsumerI::UPtr otterbrix_consumer;
-  std::pmr::memory_resource* resource;
-};
+  /**
+   * @brief Opens a transaction, which may span the calls of several threads, e.g. the
+   * plans of a transaction spread over partitions. Verification waits until all open
+   * transactions end and holds new ones back meanwhile.
+   */
+  void beginTransaction();
+  /// @brief Ends a transaction opened by `beginTransaction()`, on any thread.
+  void endTransaction();
+
+  /// @brief Keeps a transaction open in its scope.
+  class OpenTransaction {
+  public:
+    explicit OpenTransaction(OtterBrixConsumerSink& sink) :
+        sink(sink)
+    {
+      sink.beginTransaction();
+    }
+    ~OpenTransaction()
+    {
+      sink.endTransaction();
+    }
+
+    OpenTransaction(const OpenTransaction&) = delete;
+    OpenTransaction& operator=(const OpenTransaction&) = delete;
+
+  private:
+    OtterBrixConsumerSink& sink;
+  };
 
-struct OtterBrixConsumerSink : OtterBrixConsumerI {
-  explicit OtterBrixConsumerSink(DataHandler data_handler);
-  virtual ~OtterBrixConsumerSink() = default;
+  /// @brief Executes the plans in order at once, bypasses the data handler.
+  void consume(std::span<const ExtendedNode> batch);
 
-  std::pmr::memory_resource* resource() const noexcept;
+  /**
+   * @brief Executes plans of transactions the caller has opened, see
+   * `beginTransaction()`. Transactions may be passed from several threads at once.
+   * Checkpoint markers are committed as they are passed, bypasses the data handler.
+   *
+   * Every thread passes a session of its own, so the dispatcher tells the calls apart and
+   * the plans of the threads are executed concurrently. Only the creation of databases,
+   * collections and indexes is serialized.
+   */
+  void consumeConcurrently(
+      std::span<const ExtendedNode> plans, const otterbrix::session_id_t& session
+  );
+
+  /**
+   * @brief Executes the plans up to the last checkpoint marker of the batch, together
+   * with the plans kept from the previous batches. The plans after it are kept until the
+   * next marker. Used by the static pipeline, bypasses the data handler.
+   */
+  void consumeCommitted(std::span<const ExtendedNode> batch);
+
+  /**
+   * @brief Same as `verify()` but the scan is run on a background thread. If a check is
+   * already in progress its result is returned instead of starting a new one.
+   */
+  std::shared_future<bool> verifyAsync();
 
 protected:
   virtual void putDataImpl(const ExtendedNode& extended_node) override;
-
-  void processContextStorage(node_ptr node);
-  void selectStage();
+  virtual void putBatchImpl(std::span<const ExtendedNode> batch) override;
+  virtual void flushImpl() override;
+
+  /// @brief Executes the plan. The caller has a transaction open.
+  void apply(const ExtendedNode& extended_node, const otterbrix::session_id_t& session);
+  /// @brief Ends the deletes before inserts once the stream is past the window of the
+  /// replayed transactions.
+  void passMarker(const BinlogPosition& position);
+  /// @brief Executes the plan in the session, every plan of the sink is executed here.
+  virtual components::cursor::cursor_t_ptr execute(
+      node_ptr node, parameter_node_ptr params, const otterbrix::session_id_t& session
+  );
+  /// @brief Creates the database and the collection of the plan unless they exist. The
+  /// caller holds `catalog_mutex`.
+  void processContextStorage(node_ptr node, const otterbrix::session_id_t& session);
+  /**
+   * @brief Creates the indexes of `IndexOptions` for the new collection.
+   * @param[in] existing The collection is kept from the previous run, which created the
+   * indexes already.
+   */
+  void createIndexes(
+      const std::string& database_name, const std::string& collection_name, bool existing,
+      const otterbrix::session_id_t& session
+  );
+  void createIndex(
+      const components::logical_plan::collection_full_name_t& collection,
+      const std::vector<std::string>& fields, bool existing,
+      const otterbrix::session_id_t& session
+  );
+  /// @brief Scans the collection and compares it with its digest. The caller holds the
+  /// transactions back, see `pauseTransactions()`.
+  bool checkDigest(const std::string& database_name, const std::string& collection_name);
 
   otterbrix::otterbrix_ptr otterbrix_service;
   map_t<std::string, set_t<std::string>> context_storage;
+
+  const CheckpointStore::SPtr checkpoints;
+  /// The data of the previous run is kept.
+  const bool resumed;
+  const VerificationOptions verification_options;
+  const IndexOptions index_options;
+  DigestTracker digests;
+  size_t applied_plans{0};
+  /// Plans of transactions the markers of which are not received yet.
+  std::vector<ExtendedNode> uncommitted;
+  /// Session of the plans applied by `consume` and `consumeCommitted`.
+  const otterbrix::session_id_t serial_session{};
+
+  /// @brief Waits until no transaction is open and holds new ones back.
+  void pauseTransactions();
+  void resumeTransactions();
+
+  /// Guards the counters of the transactions, which keep otterbrix and `digests` from
+  /// background verification.
+  std::mutex transactions_mutex;
+  /// Signalled when a transaction ends or verification resumes them.
+  std::condition_variable transactions_changed;
+  size_t open_transactions{0};
+  bool transactions_paused{false};
+  /// Guards `context_storage` and the creation of collections from concurrent
+  /// transactions.
+  std::mutex catalog_mutex;
+  /// Guards `digests`, `applied_plans` and the replay window from concurrent
+  /// transactions.
+  std::mutex state_mutex;
+  /// Position of the last marker applied before the restart, `std::nullopt` if unknown.
+  std::optional<BinlogPosition> last_applied;
+  /// Markers after `last_applied` to keep deleting for, see `extendReplayWindow()`.
+  size_t window_markers{0};
+  size_t markers_after_applied{0};
+  /// Inserts are preceded by deletes of their rows.
+  std::atomic<bool> replaying{false};
+  std::mutex verification_mutex;
+  std::shared_future<bool> pending_verification;
 };
 
 } // namespace cdc
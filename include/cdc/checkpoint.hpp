@@ -0,0 +1,109 @@
+#ifndef _CDC_CHECKPOINT_HPP
+#define _CDC_CHECKPOINT_HPP
+
+#include <defines.hpp>
+
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+
+namespace cdc {
+
+/// @brief Position in the binlog of the server. Events from it on are not applied.
+struct BinlogPosition {
+  std::string file;
+  uint64_t position{4};
+  /// Text form of `binlog::GtidSet` of the applied transactions. Empty if the server
+  /// doesn't use GTIDs or the set isn't known.
+  std::string gtid_set{};
+
+  bool operator==(const BinlogPosition&) const = default;
+};
+
+/**
+ * @returns Whether binlog file `lhs` precedes `rhs`. The numbers of the files outgrow
+ * their padding, e.g. `mysql-bin.999999` precedes `mysql-bin.1000000`.
+ */
+bool binlogFileBefore(std::string_view lhs, std::string_view rhs) noexcept;
+
+/// @returns Whether position `lhs` precedes `rhs` in the binlog.
+bool binlogPositionBefore(const BinlogPosition& lhs, const BinlogPosition& rhs) noexcept;
+
+struct CheckpointOptions {
+  /// File of the checkpoint. A temporary file next to it is used while writing.
+  std::string path{"/tmp/test_collection_sql/checkpoint"};
+  /// Committed positions are written at most once per interval.
+  std::chrono::milliseconds flush_interval{1000};
+};
+
+/**
+ * @brief Persistent position of the last transaction applied to otterbrix.
+ *
+ * A new position replaces the file by a rename, so a crash leaves either the old or the
+ * new checkpoint. Positions committed between writes are lost on a crash, their events
+ * are replayed on the next start, see `OtterBrixConsumerSink`. The last committed
+ * position is also overwritten in place in `<path>.applied` at every commit, without
+ * waiting for the disk, to tell how far the replayed events were applied.
+ */
+class CheckpointStore {
+public:
+  using SPtr = std::shared_ptr<CheckpointStore>;
+
+  DECLARE_EXCEPTION(CheckpointError);
+
+  explicit CheckpointStore(CheckpointOptions options = {});
+  /// @brief Writes the last committed position.
+  ~CheckpointStore();
+
+  CheckpointStore(const CheckpointStore&) = delete;
+  CheckpointStore& operator=(const CheckpointStore&) = delete;
+
+  /**
+   * @returns The last written position or `std::nullopt` if there is no checkpoint.
+   * @throws `CheckpointError` Thrown if the checkpoint can't be read.
+   */
+  std::optional<BinlogPosition> load() const;
+
+  /**
+   * @returns The last committed position, which is ahead of `load()` after a crash.
+   * `std::nullopt` if it isn't recorded or the record is damaged, e.g. by a power loss.
+   */
+  std::optional<BinlogPosition> loadApplied() const;
+
+  /**
+   * @brief Records the position after the plans of all preceding events are applied.
+   * It is written if `flush_interval` has passed since the last write, and recorded as
+   * applied at once.
+   *
+   * @throws `CheckpointError` Thrown if the checkpoint can't be written.
+   */
+  void commit(const BinlogPosition& position);
+
+  /// @brief Writes the last committed position if it is not written yet.
+  void flush();
+
+private:
+  using Clock = std::chrono::steady_clock;
+
+  /// @brief The caller holds `mutex`.
+  void write();
+  /// @brief Overwrites the record of the applied position. The caller holds `mutex`.
+  void writeApplied(const BinlogPosition& position);
+
+  const CheckpointOptions options;
+
+  std::mutex mutex;
+  std::optional<BinlogPosition> committed;
+  bool dirty{false};
+  Clock::time_point last_write;
+  /// Descriptor of `<path>.applied`, opened at the first commit.
+  int applied_fd{-1};
+};
+
+} // namespace cdc
+
+#endif
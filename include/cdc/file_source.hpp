@@ -0,0 +1,141 @@
+#ifndef _CDC_FILE_SOURCE_HPP
+#define _CDC_FILE_SOURCE_HPP
+
+#include <cdc/cdc.hpp>
+#include <utils/mapped_file.hpp>
+
+#include <functional>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace cdc {
+
+/// @returns Owning buffer of a rotate event switching the stream to `file` at `position`.
+/// Its `log_pos` is zero, as of the rotate event starting a stream of the server. With
+/// `checksum` it ends with a zero checksum, as the events described by a format
+/// description event with checksums.
+Buffer makeRotateEvent(const std::string& file, uint64_t position, bool checksum = false);
+
+/**
+ * @brief Replays binlog files, e.g. an archive of a server, without a connection.
+ *
+ * Every file is mapped into memory at once and read sequentially. Buffers are views of
+ * the mapping sharing its ownership, so events are neither read by system calls nor
+ * copied, and the buffers stay valid after the next fetch and on other threads.
+ *
+ * Before the events of a file the source yields a rotate event naming it, as the server
+ * does at the start of a stream, so the checkpoints refer to the replayed files. The
+ * rotate event ending a file names the file replayed next. If the archive doesn't have
+ * it, the replay ends there.
+ */
+struct BinlogFileBufferSource final : BufferSourceI {
+
+  DECLARE_EXCEPTION(BinlogFileError);
+
+  /**
+   * @param[in] paths Files in the order of the binlog, e.g. `mysql-bin.000001`,
+   * `mysql-bin.000002`. The names of the files are the names of the binlog files.
+   * @param[in] start_position Position to resume from, usually the loaded checkpoint.
+   * Files before its file are skipped, its file is read from the position.
+   * @throws `BinlogFileError` Thrown if the file of the position is missing.
+   */
+  explicit BinlogFileBufferSource(
+      std::vector<std::string> paths,
+      std::optional<BinlogPosition> start_position = std::nullopt
+  );
+  virtual ~BinlogFileBufferSource() = default;
+
+  /**
+   * @param[in] path Directory of binlog files, binlog index file listing them or a single
+   * binlog file.
+   * @returns Binlog files in the order of the binlog. Files of a directory are the ones
+   * with numeric extensions, ordered by their numbers.
+   * @throws `BinlogFileError` Thrown if there are no binlog files.
+   */
+  static std::vector<std::string> discover(const std::string& path);
+
+  /**
+   * @param[in] paths Files in the order of the binlog.
+   * @returns Index of the file of `position`, `paths.size()` if the file follows them,
+   * e.g. a checkpoint of the live stream.
+   * @throws `BinlogFileError` Thrown if the file is missing among the paths, its events
+   * can't be replayed.
+   */
+  static size_t startFile(
+      const std::vector<std::string>& paths, const BinlogPosition& position
+  );
+
+  /// @returns Position after the last passed event, where the binlog continues after the
+  /// replay.
+  const BinlogPosition& position() const noexcept
+  {
+    return replayed;
+  }
+
+protected:
+  virtual std::optional<Buffer> getDataImpl() final override;
+
+private:
+  /// @brief Maps the next file.
+  /// @returns Rotate event of the mapped file.
+  Buffer openNext();
+  /// @returns The next event of the mapped file, `std::nullopt` at its end.
+  /// @throws `BinlogFileError` Thrown if a file other than the last one ends inside an
+  /// event. The last file may still be written by the server.
+  std::optional<Buffer> nextEvent();
+  /// @brief Chooses the file following the mapped one.
+  void finishFile();
+
+  const std::vector<std::string> paths;
+  std::optional<BinlogPosition> start_position;
+  size_t next_file{0};
+
+  /// Keeps the mapped file alive, buffers share it.
+  std::shared_ptr<const utils::MappedFile> mapping;
+  std::string_view content;
+  size_t offset{0};
+  /// Offset to jump to after the format description event of the file.
+  size_t resume_offset{0};
+  /// Format of the events of the mapped file.
+  binlog::event::FormatDescriptionEvent fde{
+      binlog::BINLOG_VERSION, binlog::SERVER_VERSION
+  };
+  /// Position named by the rotate event of the mapped file.
+  std::optional<BinlogPosition> rotated_to;
+  BinlogPosition replayed;
+};
+
+/**
+ * @brief Replays archived binlog files and continues with the live stream of the server
+ * from where they end, so a replica is rebuilt from the archive without reading the whole
+ * binlog from the primary.
+ */
+struct CatchUpBufferSource final : BufferSourceI {
+  /// Opens the live stream at the position given.
+  using LiveFactory = std::function<BufferSourceI::UPtr(const BinlogPosition&)>;
+
+  CatchUpBufferSource(
+      std::unique_ptr<BinlogFileBufferSource> replay, LiveFactory connect_live
+  );
+  virtual ~CatchUpBufferSource() = default;
+
+  virtual bool ready() const final override;
+
+protected:
+  virtual std::optional<Buffer> getDataImpl() final override;
+  virtual void getBatchImpl(std::vector<Buffer>& out, size_t max_items) final override;
+
+private:
+  void switchToLive();
+
+  std::unique_ptr<BinlogFileBufferSource> replay;
+  LiveFactory connect_live;
+  BufferSourceI::UPtr live;
+};
+
+} // namespace cdc
+
+#endif
@@ -0,0 +1,193 @@
+#ifndef _CDC_PARALLEL_APPLY_HPP
+#define _CDC_PARALLEL_APPLY_HPP
+
+#include <cdc/cdc.hpp>
+#include <utils/spsc_ring.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <latch>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace cdc {
+
+struct ParallelApplyOptions {
+  /// Threads converting and applying transactions.
+  size_t workers{4};
+  /// Transactions scheduled but not applied yet.
+  size_t max_scheduled{1024};
+};
+
+/**
+ * @brief Applies independent transactions on a pool of workers, as the multi-threaded
+ * replica of MySQL does.
+ *
+ * A transaction is started once every scheduled transaction numbered up to its
+ * `last_committed` is applied. Transactions prepared together on the server don't depend
+ * on each other, so they run concurrently. Transactions without the logical clock and the
+ * first ones of a binlog file wait for all scheduled transactions.
+ *
+ * Workers convert every transaction into plans of its own, without coalescing rows with
+ * other transactions. Checkpoint markers are committed in the order of the transactions,
+ * once all transactions before them are applied.
+ *
+ * Every worker executes its plans in a session of its own, so the plans of independent
+ * transactions are executed concurrently, see
+ * `OtterBrixConsumerSink::consumeConcurrently()`.
+ */
+class ParallelDiffSink final : public OtterBrixDiffSinkI {
+public:
+  ParallelDiffSink(
+      std::unique_ptr<OtterBrixConsumerSink> otterbrix_consumer,
+      ParallelApplyOptions options = {}, PlanBatchOptions batch_options = {}
+  );
+  /// @brief Stops the workers. Transactions not applied yet are dropped.
+  virtual ~ParallelDiffSink();
+
+protected:
+  virtual void putDataImpl(const TransactionBatch& data) final override;
+  virtual void putBatchImpl(std::span<const TransactionBatch> batch) final override;
+  /// @brief Waits for all scheduled transactions.
+  virtual void flushImpl() final override;
+
+private:
+  struct Scheduled {
+    int64_t sequence_number;
+    /// Checkpoint marker of the transaction.
+    ExtendedNode marker;
+    bool applied{false};
+  };
+
+  struct Task {
+    /// Number of the transaction among all scheduled ones.
+    uint64_t ticket;
+    TransactionBatch transaction;
+  };
+
+  /// @brief Waits for the transactions the transaction depends on and schedules it.
+  void schedule(const TransactionBatch& transaction);
+  void work();
+  /// @brief Commits the markers of the applied transactions preceded by no pending one.
+  /// The caller holds `mutex`.
+  void completeApplied(const otterbrix::session_id_t& session);
+  /// @brief Rethrows the first error of the workers. The caller holds `mutex`.
+  void checkError() const;
+
+  const std::unique_ptr<OtterBrixConsumerSink> otterbrix_consumer;
+  const ParallelApplyOptions options;
+  const PlanBatchOptions batch_options;
+
+  std::mutex mutex;
+  /// Signalled when a task is added or the workers are stopped.
+  std::condition_variable task_added;
+  /// Signalled when a transaction is applied.
+  std::condition_variable applied;
+  std::deque<Task> tasks;
+  /// Transactions not completed yet in the order of scheduling, the first one has
+  /// `first_ticket`.
+  std::deque<Scheduled> scheduled;
+  uint64_t first_ticket{0};
+  /// Sequence number of the last scheduled transaction.
+  int64_t last_sequence_number{0};
+  std::exception_ptr error;
+  bool stopping{false};
+  std::vector<std::thread> workers;
+};
+
+struct PartitionStats {
+  /// Plans waiting for the worker.
+  size_t queued{0};
+  /// Plans applied by the worker.
+  uint64_t applied{0};
+  /// Time the worker spent applying them.
+  std::chrono::nanoseconds busy{0};
+};
+
+/**
+ * @brief Applies plans on workers owning a partition of the rows each, see
+ * `PlanBatchOptions::partitions`. Plans of a row are applied by its worker in order,
+ * plans of other partitions in parallel.
+ *
+ * Checkpoint markers are passed to every worker and committed by the last one reaching
+ * the marker, once all plans before it are applied. The plans up to a marker are one
+ * transaction of `OtterBrixConsumerSink::beginTransaction()`, which the last worker ends,
+ * so verification never sees a transaction spanning partitions applied in part.
+ *
+ * Every worker executes its plans in a session of its own, so the partitions are
+ * applied concurrently, see `OtterBrixConsumerSink::consumeConcurrently()`.
+ */
+class PartitionedConsumerSink final : public OtterBrixConsumerI {
+public:
+  /// @param[in] workers Number of workers, the partitions of plans are taken modulo it.
+  PartitionedConsumerSink(
+      std::unique_ptr<OtterBrixConsumerSink> otterbrix_consumer, size_t workers,
+      size_t queue_capacity = conveyor::DEFAULT_STAGE_CAPACITY
+  );
+  virtual ~PartitionedConsumerSink();
+
+  /// @returns Statistics of every worker, to size their number.
+  std::vector<PartitionStats> stats() const;
+
+protected:
+  virtual void putDataImpl(const ExtendedNode& extended_node) final override;
+  virtual void putBatchImpl(std::span<const ExtendedNode> batch) final override;
+  /// @brief Waits until all workers apply their plans and ends the open transaction.
+  virtual void flushImpl() final override;
+
+private:
+  struct Marker {
+    ExtendedNode node;
+    /// Workers which haven't reached the marker yet.
+    std::atomic<size_t> remaining;
+    /// Plans precede the marker, the last worker ends their transaction.
+    bool ends_transaction;
+  };
+
+  struct Item {
+    enum Command {
+      PLAN,
+      MARKER,
+      FLUSH,
+      STOP
+    } command;
+
+    ExtendedNode plan{};
+    std::shared_ptr<Marker> marker{};
+    std::latch* done{nullptr};
+  };
+
+  struct Worker {
+    explicit Worker(size_t queue_capacity) :
+        ring(queue_capacity)
+    {}
+
+    utils::SpscRing<Item> ring;
+    const otterbrix::session_id_t session{};
+    std::atomic<uint64_t> applied{0};
+    std::atomic<int64_t> busy_ns{0};
+    std::thread thread;
+  };
+
+  void run(Worker& worker);
+  /// @brief Runs `func` unless a worker has already failed and saves its exception.
+  template<typename Func>
+  void guarded(Func&& func);
+  void rethrowError();
+
+  const std::unique_ptr<OtterBrixConsumerSink> otterbrix_consumer;
+  std::vector<std::unique_ptr<Worker>> workers;
+  /// Plans were passed after the last marker, their transaction is open.
+  bool transaction_open{false};
+  std::mutex error_mutex;
+  std::exception_ptr error;
+  std::atomic<bool> failed{false};
+};
+
+} // namespace cdc
+
+#endif
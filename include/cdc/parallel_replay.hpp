@@ -0,0 +1,125 @@
+#ifndef _CDC_PARALLEL_REPLAY_HPP
+#define _CDC_PARALLEL_REPLAY_HPP
+
+#include <cdc/cdc.hpp>
+#include <utils/mapped_file.hpp>
+
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace cdc {
+
+struct ParallelReplayOptions {
+  /// Threads parsing the chunks.
+  size_t workers{4};
+  /// Bytes of a chunk, it ends with the first transaction ending after them.
+  size_t chunk_bytes{16 * 1024 * 1024};
+  /// Chunks cut ahead of the consumer, parsed or waiting for a worker.
+  size_t max_chunks{16};
+};
+
+/**
+ * @brief Replays binlog files parsing their chunks concurrently.
+ *
+ * The files are cut into chunks where `TableDiffAssembler` ends transactions: after XID
+ * events, `COMMIT` and statements logged alone. Only the headers of the other events are
+ * read. A chunk ending inside a transaction, at the end of a file, drops it as a serial
+ * stream does at its end. Workers parse the chunks into transactions with an
+ * `EventParser`, a `TableDiffAssembler` and a `TransactionAssembler` of their own, and
+ * the transactions are passed on in the order of the binlog.
+ *
+ * A chunk is parsed as if a stream started there: it is preceded by a rotate event naming
+ * its file, the format description event of the file and a previous GTIDs event of the
+ * set executed before the chunk, which is collected while cutting. Table map events
+ * precede the rows events of every transaction, so chunks need no context of the table
+ * maps.
+ */
+class ParallelReplaySource final : public TransactionSourceI {
+public:
+  DECLARE_EXCEPTION(ParallelReplayError);
+
+  /**
+   * @param[in] paths Files in the order of the binlog, see `BinlogFileBufferSource`.
+   * @param[in] start_position Position to resume from, files before its file are skipped.
+   * @param[in] applied Transactions to skip, also the set executed before the files.
+   * @throws `BinlogFileBufferSource::BinlogFileError` Thrown if the file of the start
+   * position is missing.
+   */
+  ParallelReplaySource(
+      std::vector<std::string> paths, ParallelReplayOptions options = {},
+      std::optional<BinlogPosition> start_position = std::nullopt,
+      binlog::GtidSet applied = {}
+  );
+  /// @brief Stops the workers. Chunks not parsed yet are dropped.
+  virtual ~ParallelReplaySource();
+
+protected:
+  virtual std::optional<TransactionBatch> getDataImpl() final override;
+
+private:
+  struct Chunk {
+    std::shared_ptr<const utils::MappedFile> mapping;
+    /// Events parsed before the chunk, as at the start of a stream.
+    std::vector<Buffer> seeds;
+    size_t begin;
+    size_t end;
+
+    std::vector<TransactionBatch> transactions;
+    std::exception_ptr error;
+    bool done{false};
+  };
+
+  /// @brief Cuts chunks until `max_chunks` of them are ahead of the consumer.
+  void schedule();
+  /// @returns The next chunk of the files, `nullptr` at their end.
+  std::shared_ptr<Chunk> cutChunk();
+  /// @brief Maps the next file.
+  void openNext();
+  void work();
+  void parse(Chunk& chunk) const;
+
+  const std::vector<std::string> paths;
+  const ParallelReplayOptions options;
+  const binlog::GtidSet applied;
+  std::optional<BinlogPosition> start_position;
+
+  // State of cutting, used by the consumer only.
+  size_t next_file{0};
+  std::shared_ptr<const utils::MappedFile> mapping;
+  std::string_view content;
+  size_t offset{0};
+  std::string file_name;
+  /// Format description event of the file and its offset.
+  Buffer format;
+  size_t format_offset{0};
+  binlog::event::FormatDescriptionEvent fde{
+      binlog::BINLOG_VERSION, binlog::SERVER_VERSION
+  };
+  /// Set executed before `offset`, as `TableDiffAssembler` knows it.
+  std::optional<binlog::GtidSet> executed;
+
+  /// Chunks cut in the order of the binlog, the first one is consumed.
+  std::deque<std::shared_ptr<Chunk>> chunks;
+  std::shared_ptr<Chunk> current;
+  size_t next_transaction{0};
+
+  std::mutex mutex;
+  /// Signalled when a chunk is cut or the workers are stopped.
+  std::condition_variable task_added;
+  /// Signalled when a chunk is parsed.
+  std::condition_variable chunk_done;
+  std::deque<std::shared_ptr<Chunk>> tasks;
+  bool stopping{false};
+  std::vector<std::thread> workers;
+};
+
+} // namespace cdc
+
+#endif
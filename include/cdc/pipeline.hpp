@@ -0,0 +1,170 @@
+#ifndef _CDC_PIPELINE_HPP
+#define _CDC_PIPELINE_HPP
+
+#include <cdc/cdc.hpp>
+#include <conveyor.hpp>
+
+namespace cdc {
+
+/**
+ * @brief Stages of the CDC chain for `conveyor::Pipeline`. They share the cores of the
+ * dynamic stages, so both chains produce the same plans.
+ *
+ * @tparam Handler Callable invoked with every produced item, `conveyor::NoHandler` by
+ * default.
+ */
+template<typename Handler = conveyor::NoHandler>
+struct ParseStage {
+  /// @param[in] applied Transactions to skip, see `EventParser`.
+  explicit ParseStage(binlog::GtidSet applied = {}, Handler handler = {}) :
+      parser(std::move(applied)),
+      handler(std::move(handler))
+  {}
+
+  template<typename Emit>
+  void operator()(const Buffer& buffer, Emit&& emit)
+  {
+    if (auto event = parser.parse(buffer)) {
+      conveyor::notify(handler, event);
+      emit(std::move(event));
+    }
+  }
+
+private:
+  EventParser parser;
+  [[no_unique_address]] Handler handler;
+};
+
+/// @copydoc ParseStage
+template<typename Handler = conveyor::NoHandler>
+struct TableDiffStage {
+  /// @param[in] executed See `TableDiffAssembler`.
+  explicit TableDiffStage(binlog::GtidSet executed = {}, Handler handler = {}) :
+      assembler(std::move(executed)),
+      handler(std::move(handler))
+  {}
+
+  template<typename Emit>
+  void operator()(Binlog&& event, Emit&& emit)
+  {
+    pass(assembler.process(std::move(event)), emit);
+  }
+
+  /// @brief Drops the rows after the last commit, see `TableDiffAssembler::finish()`.
+  template<typename Emit>
+  void finish(Emit&& emit)
+  {
+    pass(assembler.finish(), emit);
+  }
+
+private:
+  template<typename Emit>
+  void pass(std::optional<TableDiff>&& diff, Emit& emit)
+  {
+    if (diff) {
+      conveyor::notify(handler, diff.value());
+      emit(std::move(diff.value()));
+    }
+  }
+
+  TableDiffAssembler assembler;
+  [[no_unique_address]] Handler handler;
+};
+
+/// @copydoc ParseStage
+template<typename Handler = conveyor::NoHandler>
+struct TransactionStage {
+  explicit TransactionStage(Handler handler = {}) :
+      handler(std::move(handler))
+  {}
+
+  template<typename Emit>
+  void operator()(TableDiff&& diff, Emit&& emit)
+  {
+    if (auto transaction = assembler.process(std::move(diff))) {
+      conveyor::notify(handler, transaction.value());
+      emit(std::move(transaction.value()));
+    }
+  }
+
+private:
+  TransactionAssembler assembler;
+  [[no_unique_address]] Handler handler;
+};
+
+/**
+ * @copydoc ParseStage
+ *
+ * Rows of the transactions of one portion of the head are coalesced by `PlanBuilder` and
+ * passed downstream as one batch, ending with the marker of the last transaction.
+ */
+template<typename Handler = conveyor::NoHandler>
+struct PlanStage {
+  explicit PlanStage(
+      std::pmr::memory_resource* resource, PlanBatchOptions batch_options = {},
+      Handler handler = {}
+  ) :
+      builder(resource, batch_options),
+      handler(std::move(handler))
+  {}
+
+  template<typename Emit>
+  void operator()(const TransactionBatch& transaction, Emit&&)
+  {
+    const auto begin = nodes.size();
+
+    for (const auto& diff : transaction.diffs) {
+      builder.convert(diff, nodes);
+    }
+    notifyFrom(begin);
+  }
+
+  template<typename Emit>
+  void flush(Emit&& emit)
+  {
+    const auto begin = nodes.size();
+
+    builder.flushPending(nodes);
+    notifyFrom(begin);
+
+    if (nodes.empty()) {
+      return;
+    }
+
+    emit(std::span<const ExtendedNode>(nodes));
+    nodes.clear();
+  }
+
+private:
+  void notifyFrom(size_t begin)
+  {
+    for (auto i = begin; i < nodes.size(); ++i) {
+      conveyor::notify(handler, nodes[i]);
+    }
+  }
+
+  PlanBuilder builder;
+  std::vector<ExtendedNode> nodes;
+  [[no_unique_address]] Handler handler;
+};
+
+/// @brief Last stage. Applies batches of plans with the consumer it refers to, see
+/// `OtterBrixConsumerSink::consumeCommitted`.
+struct ApplyStage {
+  explicit ApplyStage(OtterBrixConsumerSink& consumer) noexcept :
+      consumer(&consumer)
+  {}
+
+  template<typename Emit>
+  void operator()(std::span<const ExtendedNode> batch, Emit&&)
+  {
+    consumer->consumeCommitted(batch);
+  }
+
+private:
+  OtterBrixConsumerSink* consumer;
+};
+
+} // namespace cdc
+
+#endif
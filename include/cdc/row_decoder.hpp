@@ -0,0 +1,193 @@
+#ifndef _CDC_ROW_DECODER_HPP
+#define _CDC_ROW_DECODER_HPP
+
+#include <cdc/table_schema.hpp>
+#include <defines.hpp>
+#include <utils/string_buffer_reader.hpp>
+
+#include <components/document/document.hpp>
+#include <cstdint>
+#include <memory_resource>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace cdc {
+
+/**
+ * @brief Decode program of the row images of one table.
+ *
+ * The schema is interpreted once: every column gets an operation specialized by its type,
+ * signedness and metadata, and the JSON pointer of its field. Decoding of a row just runs
+ * the operations in order.
+ */
+class RowDecoder {
+public:
+  DECLARE_EXCEPTION(RowDecoderError);
+
+  static const std::string PK_FIELD_NAME;
+  static const std::string PK_JSON_POINTER;
+
+  /// Bit `i` is set if column `i` is present in the row images, as in rows events.
+  /// Empty means all columns are present.
+  using ColumnBitmap = std::span<const uint8_t>;
+
+  struct Update {
+    /// Primary key of the before-image.
+    std::string key;
+    /// Fields of the changed columns or `nullptr` if no column changed.
+    components::document::document_ptr changes;
+  };
+
+  /**
+   * @throws `RowDecoderError` Thrown if the primary key of the table is not a single
+   * unsigned `BIGINT` column named `PK_FIELD_NAME`.
+   */
+  explicit RowDecoder(const TableSchema& schema);
+
+  /**
+   * @brief Decodes the next row image of `row_r` into a document.
+   *
+   * Columns absent from the image have no fields in the document.
+   *
+   * @param[in] present_columns Columns present in the image.
+   * @throws `RowDecoderError` Thrown if the row has a value of an unsupported type or no
+   * value of the primary key.
+   */
+  components::document::document_ptr decode(
+      utils::StringBufferReader& row_r, std::pmr::memory_resource* resource,
+      ColumnBitmap present_columns = {}
+  ) const;
+
+  /**
+   * @brief Skips the next row image of `row_r` and returns its primary key only.
+   *
+   * Values are neither converted nor allocated, other columns are skipped by length.
+   *
+   * @returns The key formatted as the `PK_FIELD_NAME` field of `decode`.
+   * @throws `RowDecoderError` Thrown if the row has a value of an unsupported type or no
+   * value of the primary key.
+   */
+  std::string
+  extractKey(utils::StringBufferReader& row_r, ColumnBitmap present_columns = {}) const;
+
+  /**
+   * @brief Decodes the next pair of before- and after-images of `row_r` into the
+   * changed columns only.
+   *
+   * Values are compared as bytes, only differing ones are converted. Columns absent from
+   * the before-image are changes if they are in the after-image, so a minimal
+   * before-image holding the primary key only gives all columns of the after-image.
+   * The primary key is never a change.
+   *
+   * @param[in] before_columns Columns present in the before-image.
+   * @param[in] after_columns Columns present in the after-image.
+   * @throws `RowDecoderError` Thrown if the row has a value of an unsupported type or no
+   * value of the primary key.
+   */
+  Update decodeUpdate(
+      utils::StringBufferReader& row_r, ColumnBitmap before_columns,
+      ColumnBitmap after_columns, std::pmr::memory_resource* resource
+  ) const;
+
+  /**
+   * @brief Decodes a row of the text protocol, as returned by `SELECT` of all columns in
+   * their order, into the same document as `decode` gives for its row image.
+   *
+   * @param[in] values Values of the columns. NULL has `nullptr` data.
+   * @throws `RowDecoderError` Thrown if a value can't be converted to the type of its
+   * column or the primary key is NULL.
+   */
+  components::document::document_ptr decodeText(
+      std::span<const std::string_view> values, std::pmr::memory_resource* resource
+  ) const;
+
+  /// @returns The index of the primary key column.
+  size_t primaryKeyIndex() const noexcept;
+
+private:
+  enum class Op : uint8_t {
+    PRIMARY_KEY,
+    INT8,
+    UINT8,
+    INT16,
+    UINT16,
+    INT24,
+    UINT24,
+    INT32,
+    UINT32,
+    INT64,
+    UINT64,
+    FLOAT,
+    DOUBLE,
+    BOOL,
+    VARCHAR8,
+    VARCHAR16,
+    STRING,
+    /// The value can't be decoded, only NULL is accepted.
+    UNSUPPORTED
+  };
+
+  struct Column {
+    Op op;
+    /// Padded length of `STRING` values.
+    uint16_t length{0};
+    std::string json_pointer;
+  };
+
+  /// @brief Null bitmap of a row image. It has bits of the present columns only.
+  class RowImage {
+  public:
+    /// @brief Reads the null bitmap at the start of the image.
+    RowImage(
+        const RowDecoder& decoder, ColumnBitmap present_columns,
+        utils::StringBufferReader& row_r
+    );
+
+    bool isPresent(size_t index) const noexcept;
+    /// @returns `true` if the value of the next present column is NULL.
+    bool nextIsNull() noexcept;
+
+  private:
+    ColumnBitmap present_columns;
+    const uint8_t* null_bitmap;
+    size_t null_bit{0};
+  };
+
+  /**
+   * @brief Skips the values of the image and passes each of them, empty for NULL, to
+   * `on_value(index, bytes)`.
+   *
+   * @returns The primary key.
+   */
+  template<typename OnValue>
+  std::string
+  readImage(RowImage& image, utils::StringBufferReader& row_r, OnValue&& on_value) const;
+
+  /// @brief Decodes the non-NULL value of the column into the field of `doc`.
+  void decodeValue(
+      size_t index, utils::StringBufferReader& row_r,
+      const components::document::document_ptr& doc, std::pmr::memory_resource* resource
+  ) const;
+  /// @brief Skips the non-NULL value of the column.
+  void skipValue(size_t index, utils::StringBufferReader& row_r) const;
+  /// @brief Decodes the non-NULL text value of the column into the field of `doc`.
+  void decodeTextValue(
+      size_t index, std::string_view text, const components::document::document_ptr& doc,
+      std::pmr::memory_resource* resource
+  ) const;
+  template<typename T>
+  T parseNumber(size_t index, std::string_view text) const;
+
+  [[noreturn]] void throwNullKey() const;
+  [[noreturn]] void throwUnsupported(size_t index) const;
+
+  const TableSchema& schema;
+  std::vector<Column> columns;
+  size_t pk_index;
+};
+
+} // namespace cdc
+
+#endif
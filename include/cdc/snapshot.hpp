@@ -0,0 +1,93 @@
+#ifndef _CDC_SNAPSHOT_HPP
+#define _CDC_SNAPSHOT_HPP
+
+#include <cdc/cdc.hpp>
+#include <cdc/checkpoint.hpp>
+#include <cdc/table_schema.hpp>
+#include <defines.hpp>
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace cdc {
+
+struct SnapshotOptions {
+  /// Connections reading chunks in parallel.
+  size_t workers{4};
+  /// Rows of one chunk.
+  uint64_t chunk_rows{100000};
+  /// Rows per insert plan.
+  size_t batch_documents{1024};
+};
+
+/**
+ * @brief Copies the tables of a database into otterbrix as of one binlog position, from
+ * which `DBBufferSource` continues.
+ *
+ * Every worker opens a consistent snapshot while the tables are locked for the read of
+ * the binlog position, so all of them see the data as of that position. Tables are cut
+ * into chunks of `chunk_rows` rows, which the workers read and decode in parallel. A
+ * chunk is cut when a worker takes it, by finding its last key with an index scan, so
+ * neither memory nor the number of chunks depends on how sparse the keys are. Rows are
+ * decoded by the decoder of the table schema, the same as the rows of binlog events.
+ */
+class SnapshotLoader {
+public:
+  DECLARE_EXCEPTION(SnapshotError);
+
+  SnapshotLoader(
+      const char* host, const char* user, const char* passwd, const char* db,
+      unsigned int port, SnapshotOptions options = {}
+  );
+
+  /**
+   * @brief Inserts all rows into `consumer`.
+   *
+   * @returns Position of the snapshot.
+   * @throws `SnapshotError` Thrown if the server can't be queried.
+   * @throws `RowDecoder::RowDecoderError` Thrown if a row can't be decoded.
+   */
+  BinlogPosition load(OtterBrixConsumerSink& consumer);
+
+private:
+  /// Rows of the table with keys in `(after, last]`.
+  struct Chunk {
+    TableSchema::SPtr schema;
+    /// `std::nullopt` from the first key of the table.
+    std::optional<uint64_t> after;
+    /// `std::nullopt` up to the last key of the table.
+    std::optional<uint64_t> last;
+  };
+
+  class Connection;
+  /// State of cutting the tables into chunks, shared by the workers.
+  struct Cutter;
+
+  std::unique_ptr<Connection> connect() const;
+  /// @returns Schemas of the base tables. Tables rows of which can't be decoded are
+  /// skipped, as are the ones without an unsigned integer primary key `_id`.
+  std::vector<TableSchema::SPtr> describeTables(Connection& connection) const;
+  /// @returns The next chunk of the tables, `std::nullopt` after the last one.
+  /// @throws `SnapshotError` Thrown if the last key of the chunk can't be read.
+  std::optional<Chunk> cutChunk(
+      Connection& connection, const std::vector<TableSchema::SPtr>& schemas,
+      Cutter& cutter
+  ) const;
+  /// @brief Reads and inserts the rows of the chunk.
+  void copyChunk(
+      Connection& connection, const Chunk& chunk, OtterBrixConsumerSink& consumer
+  ) const;
+
+  const std::string host;
+  const std::string user;
+  const std::string passwd;
+  const std::string db;
+  const unsigned int port;
+  const SnapshotOptions options;
+};
+
+} // namespace cdc
+
+#endif
@@ -0,0 +1,82 @@
+#ifndef _CDC_TABLE_SCHEMA_HPP
+#define _CDC_TABLE_SCHEMA_HPP
+
+#include <binlog/binlog_events.hpp>
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace cdc {
+
+class RowDecoder;
+
+/// @brief Column metadata of a table parsed once from its table map event. Immutable.
+struct TableSchema {
+  using SPtr = std::shared_ptr<const TableSchema>;
+
+  explicit TableSchema(const binlog::event::TableMapEvent& event);
+  /**
+   * @brief Column metadata in the form of a table map event, described by other means
+   * than the binlog, e.g. `information_schema` of a snapshot.
+   */
+  TableSchema(
+      std::string collection_name, std::string table_name, std::string column_types,
+      std::string column_metatypes, std::vector<std::string> column_name_list,
+      std::vector<uint16_t> column_primary_key_list, std::string column_signedness
+  );
+  ~TableSchema();
+
+  /**
+   * @returns Decode program of the rows of the table, compiled on the first call.
+   * @throws `RowDecoder::RowDecoderError` Thrown if rows of the table can't be decoded.
+   */
+  const RowDecoder& decoder() const;
+
+  /// @returns `true` if the schema was parsed from the same table map content.
+  bool matches(const binlog::event::TableMapEvent& event) const noexcept;
+
+  std::string collection_name;
+  std::string table_name;
+  std::string column_types;
+  std::string column_metatypes;
+  std::vector<std::string> column_name_list;
+  std::vector<uint16_t> column_primary_key_list;
+  std::string column_signedness;
+  int64_t width{0};
+
+private:
+  std::string null_bits;
+  std::string optional_metadata;
+
+  mutable std::once_flag decoder_flag;
+  mutable std::unique_ptr<const RowDecoder> compiled_decoder;
+};
+
+/**
+ * @brief Interns table schemas by database, table and hash of the column metadata.
+ *
+ * Table map events precede every transaction, but the tables they describe rarely change,
+ * so a known schema is looked up without allocations and shared with all rows events.
+ * A changed table gets a new schema, which replaces the old one in the cache, while diffs
+ * holding the old one keep it alive.
+ */
+class TableSchemaCache {
+public:
+  /// @returns The schema with the same content as the event, parsed if it is new.
+  TableSchema::SPtr intern(const binlog::event::TableMapEvent& event);
+
+  size_t size() const noexcept;
+
+private:
+  static uint64_t contentHash(const binlog::event::TableMapEvent& event) noexcept;
+
+  std::unordered_multimap<uint64_t, TableSchema::SPtr> schemas;
+};
+
+} // namespace cdc
+
+#endif
@@ -0,0 +1,72 @@
+#ifndef _CDC_VERIFICATION_HPP
+#define _CDC_VERIFICATION_HPP
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+namespace cdc {
+
+struct ExtendedNode;
+
+/// @brief Options of the verification mode of `OtterBrixConsumerSink`.
+struct VerificationOptions {
+  /// @brief Maintain digests of the applied data. Without it `verify()` always succeeds.
+  bool enabled{false};
+  /// @brief Schedule a background check every `sample_interval` applied plans.
+  /// `0` means checks are run on demand only.
+  size_t sample_interval{0};
+};
+
+/// @brief Order-independent digest of a collection content.
+struct CollectionDigest {
+  uint64_t rows{0};
+  uint64_t hash{0};
+
+  bool operator==(const CollectionDigest&) const = default;
+};
+
+/**
+ * @brief Incremental per-collection digest of the data applied to otterbrix.
+ *
+ * The hash of a row is a sum of hashes of its `key: value` pairs and the hash of a
+ * collection is a sum of hashes of its rows, so neither the order of the rows nor the
+ * order of the fields matters. Field hashes of every row are kept to fold partial `$set`
+ * updates in without reading the stored document back.
+ * Documents are taken in the form produced by `document_t::to_json()`.
+ */
+class DigestTracker {
+public:
+  /// @brief Applies the plan to the digests.
+  void apply(const ExtendedNode& extended_node);
+
+  /// @param[in] collection Full name of the collection `database.collection`
+  /// @param[in] id Primary key of the row
+  /// @param[in] json Whole document of the row
+  void insert(const std::string& collection, const std::string& id, std::string_view json);
+  /// @brief Overwrites fields of the row listed in `json`. Unknown rows are ignored.
+  void update(const std::string& collection, const std::string& id, std::string_view json);
+  /// @brief Removes the row. Unknown rows are ignored.
+  void erase(const std::string& collection, const std::string& id);
+
+  /// @returns Digest of the collection. Empty digest if nothing was applied to it.
+  CollectionDigest digest(const std::string& collection) const;
+
+  /// @returns Hash of the whole document in the same terms the digests are counted.
+  static uint64_t documentHash(std::string_view json);
+
+private:
+  using FieldHashes = std::unordered_map<std::string, uint64_t>;
+
+  struct CollectionState {
+    CollectionDigest digest;
+    std::unordered_map<std::string, FieldHashes> rows;
+  };
+
+  std::unordered_map<std::string, CollectionState> collections;
+};
+
+} // namespace cdc
+
+#endif
@@ -1,12 +1,36 @@
 #ifndef _CONVEYOR_HPP
 #define _CONVEYOR_HPP
 
+#include <utils/spsc_ring.hpp>
+
+#include <atomic>
+#include <exception>
 #include <functional>
+#include <future>
 #include <memory>
 #include <optional>
+#include <span>
+#include <thread>
+#include <tuple>
+#include <type_traits>
+#include <vector>
 
 namespace conveyor {
 
+/// @brief Default number of items buffered between two stages running on own threads.
+inline constexpr size_t DEFAULT_STAGE_CAPACITY = 1024;
+
+/// @brief Default maximum number of items moved by one `getBatch()`/`putBatch()`.
+inline constexpr size_t DEFAULT_BATCH_SIZE = 64;
+
+/// @brief How `Universal` drives its stages.
+enum class ExecutionMode {
+  /// Every item is pulled through the whole chain on the calling thread.
+  SYNCHRONOUS,
+  /// The source and the sink run on separate threads connected by a bounded queue.
+  PIPELINED
+};
+
 template<typename Data>
 struct Source {
   using UPtr = std::unique_ptr<Source>;
@@ -29,9 +53,54 @@ struct Source {
     return result_opt;
   }
 
+  /**
+   * @brief Appends up to `max_items` items to `out`. Waits for the first item only, the
+   * rest are taken while `ready()`. Views among the items stay valid until the next call
+   * of `getData()` or `getBatch()`.
+   *
+   * @returns Number of appended items. `0` means the end of data.
+   */
+  virtual size_t getBatch(std::vector<Data>& out, size_t max_items) final
+  {
+    const auto begin = out.size();
+
+    getBatchImpl(out, max_items);
+
+    if (data_handler) {
+      for (auto i = begin; i < out.size(); ++i) {
+        data_handler(out[i]);
+      }
+    }
+
+    return out.size() - begin;
+  }
+
+  /// @returns `false` if the next `getData()` is expected to wait for the data.
+  virtual bool ready() const
+  {
+    return true;
+  }
+
 protected:
   virtual std::optional<Data> getDataImpl() = 0;
 
+  /// @brief Default adapter for single-item sources.
+  virtual void getBatchImpl(std::vector<Data>& out, size_t max_items)
+  {
+    for (size_t i = 0; i < max_items; ++i) {
+      if (i != 0 && !ready()) {
+        break;
+      }
+
+      auto data = getDataImpl();
+
+      if (!data.has_value()) {
+        break;
+      }
+      out.push_back(std::move(data.value()));
+    }
+  }
+
 private:
   DataHandler data_handler;
 };
@@ -56,37 +125,520 @@ struct Sink {
     putDataImpl(data);
   }
 
+  /// @brief Same as `putData()` for every item of the batch.
+  virtual void putBatch(std::span<const Data> batch) final
+  {
+    if (data_handler) {
+      for (const auto& data : batch) {
+        data_handler(data);
+      }
+    }
+
+    putBatchImpl(batch);
+  }
+
+  /// @brief Waits until all received data is passed through the sink.
+  virtual void flush() final
+  {
+    flushImpl();
+  }
+
+  /// @brief Tells that the source has no data ready, so the sink may pass on buffered
+  /// data without delaying other items. Doesn't wait.
+  virtual void idle() final
+  {
+    idleImpl();
+  }
+
 protected:
   virtual void putDataImpl(const Data&) = 0;
 
+  /// @brief Default adapter for single-item sinks.
+  virtual void putBatchImpl(std::span<const Data> batch)
+  {
+    for (const auto& data : batch) {
+      putDataImpl(data);
+    }
+  }
+
+  virtual void flushImpl()
+  {}
+
+  virtual void idleImpl()
+  {}
+
 private:
   DataHandler data_handler;
 };
 
+/**
+ * @brief Source which runs the wrapped source on its own thread. Produced items are
+ * passed through a bounded queue, so the wrapped source works ahead of the consumer by at
+ * most `capacity` items. Exceptions of the wrapped source are rethrown by `getData()`.
+ *
+ * @note Destruction waits for the current `getData()` of the wrapped source to return.
+ */
+template<typename Data>
+struct StagedSource final : Source<Data> {
+  explicit StagedSource(
+      typename Source<Data>::UPtr source, size_t capacity = DEFAULT_STAGE_CAPACITY
+  ) :
+      source(std::move(source)),
+      ring(capacity),
+      worker([this]() {
+        run();
+      })
+  {}
+
+  virtual ~StagedSource()
+  {
+    stopping.store(true, std::memory_order_relaxed);
+
+    while (!finished) {
+      finished = !ring.pop().data.has_value();
+    }
+    worker.join();
+  }
+
+  virtual bool ready() const final override
+  {
+    return finished || ring.size() != 0;
+  }
+
+protected:
+  virtual std::optional<Data> getDataImpl() final override
+  {
+    if (finished) {
+      return std::nullopt;
+    }
+
+    auto item = ring.pop();
+
+    if (!item.data.has_value()) {
+      finished = true;
+
+      if (item.error) {
+        std::rethrow_exception(item.error);
+      }
+    }
+
+    return std::move(item.data);
+  }
+
+  virtual void getBatchImpl(std::vector<Data>& out, size_t max_items) final override
+  {
+    if (max_items == 0) {
+      return;
+    }
+
+    auto data = getDataImpl();
+
+    for (size_t taken = 1; data.has_value(); ++taken) {
+      out.push_back(std::move(data.value()));
+
+      if (taken == max_items || !ready()) {
+        break;
+      }
+      data = getDataImpl();
+    }
+  }
+
+private:
+  struct Item {
+    std::optional<Data> data;
+    std::exception_ptr error;
+  };
+
+  void run()
+  {
+    std::vector<Data> batch;
+    batch.reserve(DEFAULT_BATCH_SIZE);
+
+    try {
+      while (!stopping.load(std::memory_order_relaxed)) {
+        batch.clear();
+
+        if (source->getBatch(batch, DEFAULT_BATCH_SIZE) == 0) {
+          break;
+        }
+        for (auto& data : batch) {
+          ring.push(Item{std::move(data), nullptr});
+        }
+      }
+      ring.push(Item{std::nullopt, nullptr});
+    } catch (...) {
+      ring.push(Item{std::nullopt, std::current_exception()});
+    }
+  }
+
+  typename Source<Data>::UPtr source;
+  utils::SpscRing<Item> ring;
+  std::atomic<bool> stopping{false};
+  bool finished{false};
+  std::thread worker;
+};
+
+/**
+ * @brief Sink which runs the wrapped sink on its own thread. `putData()` copies the item
+ * into a bounded queue and returns unless the queue is full. An exception of the wrapped
+ * sink is rethrown by the next `putData()` or `flush()`.
+ */
+template<typename Data>
+struct StagedSink final : Sink<Data> {
+  explicit StagedSink(
+      typename Sink<Data>::UPtr sink, size_t capacity = DEFAULT_STAGE_CAPACITY
+  ) :
+      sink(std::move(sink)),
+      ring(capacity),
+      worker([this]() {
+        run();
+      })
+  {}
+
+  virtual ~StagedSink()
+  {
+    ring.push(Item{Item::STOP, std::nullopt, nullptr});
+    worker.join();
+  }
+
+protected:
+  virtual void putDataImpl(const Data& data) final override
+  {
+    rethrowError();
+    ring.push(Item{Item::DATA, data, nullptr});
+  }
+
+  virtual void putBatchImpl(std::span<const Data> batch) final override
+  {
+    rethrowError();
+
+    for (const auto& data : batch) {
+      ring.push(Item{Item::DATA, data, nullptr});
+    }
+  }
+
+  virtual void flushImpl() final override
+  {
+    std::promise<void> done;
+    auto done_future = done.get_future();
+
+    ring.push(Item{Item::FLUSH, std::nullopt, &done});
+    done_future.wait();
+    rethrowError();
+  }
+
+  virtual void idleImpl() final override
+  {
+    rethrowError();
+    ring.push(Item{Item::IDLE, std::nullopt, nullptr});
+  }
+
+private:
+  struct Item {
+    enum Command {
+      DATA,
+      FLUSH,
+      IDLE,
+      STOP
+    } command;
+
+    std::optional<Data> data;
+    std::promise<void>* done;
+  };
+
+  void run()
+  {
+    std::vector<Data> batch;
+    std::optional<Item> next;
+
+    batch.reserve(DEFAULT_BATCH_SIZE);
+
+    while (true) {
+      Item item = next.has_value() ? std::move(next.value()) : ring.pop();
+      next.reset();
+
+      switch (item.command) {
+      case Item::DATA:
+        batch.clear();
+        batch.push_back(std::move(item.data.value()));
+
+        // Take everything already queued, but keep order with the commands.
+        while (batch.size() < DEFAULT_BATCH_SIZE) {
+          auto queued = ring.tryPop();
+
+          if (!queued.has_value()) {
+            break;
+          }
+          if (queued->command != Item::DATA) {
+            next = std::move(queued);
+            break;
+          }
+          batch.push_back(std::move(queued->data.value()));
+        }
+
+        guarded([&]() {
+          sink->putBatch(batch);
+        });
+        break;
+      case Item::FLUSH:
+        guarded([&]() {
+          sink->flush();
+        });
+        item.done->set_value();
+        break;
+      case Item::IDLE:
+        // More items behind this one make the hint stale.
+        if (ring.size() == 0) {
+          guarded([&]() {
+            sink->idle();
+          });
+        }
+        break;
+      case Item::STOP:
+        return;
+      }
+    }
+  }
+
+  /// @brief Runs `func` unless the sink has already failed and saves its exception.
+  template<typename Func>
+  void guarded(Func&& func)
+  {
+    if (failed.load(std::memory_order_acquire)) {
+      return;
+    }
+
+    try {
+      func();
+    } catch (...) {
+      error = std::current_exception();
+      failed.store(true, std::memory_order_release);
+    }
+  }
+
+  void rethrowError()
+  {
+    if (failed.load(std::memory_order_acquire)) {
+      std::rethrow_exception(error);
+    }
+  }
+
+  typename Sink<Data>::UPtr sink;
+  utils::SpscRing<Item> ring;
+  std::exception_ptr error;
+  std::atomic<bool> failed{false};
+  std::thread worker;
+};
+
+/// @brief Handler placeholder of static stages. Calls of it are compiled out.
+struct NoHandler {};
+
+/// @brief Passes the item to the handler of a static stage unless it is `NoHandler`.
+template<typename Handler, typename Data>
+inline void notify(Handler& handler, const Data& data)
+{
+  if constexpr (!std::is_same_v<Handler, NoHandler>) {
+    handler(data);
+  }
+}
+
+/**
+ * @brief Source adapter for the head of `Pipeline`. Passes batches of the wrapped source
+ * downstream, so the only indirect calls left are one per batch.
+ *
+ * @tparam SourceT Source type. A `final` type lets the compiler devirtualize the calls.
+ */
+template<typename SourceT>
+struct SourceStage {
+  using Data = std::remove_cvref_t<decltype(std::declval<SourceT&>().getData().value())>;
+
+  explicit SourceStage(
+      std::unique_ptr<SourceT> source, size_t batch_size = DEFAULT_BATCH_SIZE
+  ) :
+      source(std::move(source)),
+      batch_size(batch_size)
+  {
+    batch.reserve(batch_size);
+  }
+
+  template<typename Emit>
+  bool pump(Emit&& emit)
+  {
+    batch.clear();
+
+    if (source->getBatch(batch, batch_size) == 0) {
+      return false;
+    }
+    for (auto& data : batch) {
+      emit(std::move(data));
+    }
+    return true;
+  }
+
+  bool ready() const
+  {
+    return source->ready();
+  }
+
+private:
+  std::unique_ptr<SourceT> source;
+  std::vector<Data> batch;
+  size_t batch_size;
+};
+
+/**
+ * @brief Chain of stages composed at compile time. Unlike `Universal` there is no virtual
+ * call and no `std::function` between the stages, so the compiler may inline the whole
+ * chain into `process()`.
+ *
+ * The head stage provides `bool pump(emit)`, which passes the next portion of items to
+ * `emit` and returns `false` at the end of data. Every other stage provides
+ * `operator()(item, emit)` and passes its results to `emit`; `emit` of the last stage
+ * drops them. Stages accumulating items may provide `flush(emit)`, which is called in
+ * order of the stages after every portion of the head. At the end of data or if `ready()`
+ * of the head is `false`, `idle(emit)` of the stages is called before that, as
+ * `Sink::idle()` is. Stages holding items of an unfinished unit may provide
+ * `finish(emit)`, which is called first at the end of data.
+ */
+template<typename Head, typename... Stages>
+struct Pipeline {
+  explicit Pipeline(Head head, Stages... stages) :
+      stages(std::move(head), std::move(stages)...)
+  {}
+
+  void process()
+  {
+    while (step()) {
+    }
+  }
+
+  /// @brief Passes one portion of the head through the chain.
+  /// @returns `false` at the end of data.
+  bool step()
+  {
+    auto& head = std::get<0>(stages);
+    const bool has_data = head.pump(emitter<1>());
+    bool idle = !has_data;
+
+    if constexpr (requires { head.ready(); }) {
+      idle = idle || !head.ready();
+    }
+    if (!has_data) {
+      finishFrom<1>();
+    }
+    if (idle) {
+      idleFrom<1>();
+    }
+    flushFrom<1>();
+    return has_data;
+  }
+
+  template<size_t Index>
+  auto& stage() noexcept
+  {
+    return std::get<Index>(stages);
+  }
+
+private:
+  static constexpr size_t STAGE_COUNT = sizeof...(Stages) + 1;
+
+  /// @returns Callable passing an item to the stage `Index`.
+  template<size_t Index>
+  auto emitter() noexcept
+  {
+    if constexpr (Index == STAGE_COUNT) {
+      return [](auto&&) {
+      };
+    } else {
+      return [this](auto&& data) {
+        std::get<Index>(stages)(std::forward<decltype(data)>(data), emitter<Index + 1>());
+      };
+    }
+  }
+
+  template<size_t Index>
+  void finishFrom()
+  {
+    if constexpr (Index < STAGE_COUNT) {
+      auto& stage = std::get<Index>(stages);
+
+      if constexpr (requires { stage.finish(emitter<Index + 1>()); }) {
+        stage.finish(emitter<Index + 1>());
+      }
+      finishFrom<Index + 1>();
+    }
+  }
+
+  template<size_t Index>
+  void idleFrom()
+  {
+    if constexpr (Index < STAGE_COUNT) {
+      auto& stage = std::get<Index>(stages);
+
+      if constexpr (requires { stage.idle(emitter<Index + 1>()); }) {
+        stage.idle(emitter<Index + 1>());
+      }
+      idleFrom<Index + 1>();
+    }
+  }
+
+  template<size_t Index>
+  void flushFrom()
+  {
+    if constexpr (Index < STAGE_COUNT) {
+      auto& stage = std::get<Index>(stages);
+
+      if constexpr (requires { stage.flush(emitter<Index + 1>()); }) {
+        stage.flush(emitter<Index + 1>());
+      }
+      flushFrom<Index + 1>();
+    }
+  }
+
+  std::tuple<Head, Stages...> stages;
+};
+
 template<typename Data>
 struct Universal {
 
   Universal(
-      std::unique_ptr<Source<Data>>&& source, std::unique_ptr<Sink<Data>>&& sink
-  ) noexcept :
-      source(std::move(source)),
-      sink(std::move(sink))
+      std::unique_ptr<Source<Data>>&& source, std::unique_ptr<Sink<Data>>&& sink,
+      ExecutionMode mode = ExecutionMode::SYNCHRONOUS,
+      size_t stage_capacity = DEFAULT_STAGE_CAPACITY,
+      size_t batch_size = DEFAULT_BATCH_SIZE
+  ) :
+      source(
+          mode == ExecutionMode::PIPELINED
+              ? std::make_unique<StagedSource<Data>>(std::move(source), stage_capacity)
+              : std::move(source)
+      ),
+      sink(std::move(sink)),
+      batch_size(batch_size)
   {}
 
   void process()
   {
+    std::vector<Data> batch;
+    batch.reserve(batch_size);
+
     while (true) {
-      const auto& opt_data = source->getData();
-      if (!opt_data.has_value()) {
+      batch.clear();
+      if (source->getBatch(batch, batch_size) == 0) {
         break;
       }
-      sink->putData(opt_data.value());
+      sink->putBatch(batch);
+
+      if (!source->ready()) {
+        sink->idle();
+      }
     }
+    sink->flush();
   }
 
 private:
   std::unique_ptr<Source<Data>> source;
   std::unique_ptr<Sink<Data>> sink;
+  const size_t batch_size;
 };
 
 } // namespace conveyor
@@ -0,0 +1,64 @@
+#ifndef _UTILS_BUFFER_POOL_HPP
+#define _UTILS_BUFFER_POOL_HPP
+
+#include <utils/shared_view.hpp>
+
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <string_view>
+#include <vector>
+
+namespace utils {
+
+/**
+ * @brief Thread-safe pool of reusable memory blocks grouped in power-of-2 size classes.
+ *
+ * A block is returned to the pool when its last owner is released, whatever thread does
+ * it. Requests larger than the biggest class are served by plain allocations. The pool is
+ * kept alive by its blocks, so they may outlive the owner of the pool.
+ */
+class BufferPool : public std::enable_shared_from_this<BufferPool> {
+public:
+  /// @brief Size of the smallest class.
+  static constexpr size_t MIN_BLOCK_SIZE = 256;
+  /// @brief Size of the biggest class.
+  static constexpr size_t MAX_BLOCK_SIZE = 16 * 1024 * 1024;
+
+  /// @param[in] max_cached_bytes Limit of memory kept by free blocks.
+  static std::shared_ptr<BufferPool> create(size_t max_cached_bytes);
+
+  BufferPool(const BufferPool&) = delete;
+
+  BufferPool& operator=(const BufferPool&) = delete;
+
+  /// @returns Writable block of at least `size` bytes.
+  std::shared_ptr<char[]> acquire(size_t size);
+
+  /// @returns Owning view of a copy of `data` made in a block of the pool.
+  SharedView copy(std::string_view data);
+
+  /// @returns Memory kept by free blocks.
+  size_t cachedBytes() const;
+
+private:
+  static constexpr size_t CLASS_COUNT =
+      std::bit_width(MAX_BLOCK_SIZE) - std::bit_width(MIN_BLOCK_SIZE) + 1;
+
+  explicit BufferPool(size_t max_cached_bytes) noexcept;
+
+  static size_t classIndex(size_t size) noexcept;
+
+  void release(char* block, size_t class_index) noexcept;
+
+  const size_t max_cached_bytes;
+  mutable std::mutex mutex;
+  std::array<std::vector<std::unique_ptr<char[]>>, CLASS_COUNT> free_blocks;
+  size_t cached_bytes{0};
+};
+
+} // namespace utils
+
+#endif
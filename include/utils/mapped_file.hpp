@@ -0,0 +1,51 @@
+#ifndef _UTILS_MAPPED_FILE_HPP
+#define _UTILS_MAPPED_FILE_HPP
+
+#include <defines.hpp>
+
+#include <memory>
+#include <string>
+#include <string_view>
+
+namespace utils {
+
+/**
+ * @brief Read-only memory mapping of a whole file.
+ *
+ * The content is valid while the mapping is alive, so views of it share the mapping as
+ * their owner, see `SharedView`. The mapping shows the file as it was mapped, bytes
+ * appended later aren't visible.
+ */
+class MappedFile {
+public:
+  DECLARE_EXCEPTION(MappedFileError);
+
+  /**
+   * @param[in] sequential The file is read from the start to the end, so its pages are
+   * read ahead aggressively and dropped soon after they are passed.
+   * @throws `MappedFileError` Thrown if the file can't be opened or mapped.
+   */
+  static std::shared_ptr<const MappedFile> open(const std::string& path, bool sequential);
+
+  MappedFile(const MappedFile&) = delete;
+
+  MappedFile& operator=(const MappedFile&) = delete;
+
+  ~MappedFile();
+
+  /// @returns Content of the file, empty for an empty file.
+  std::string_view content() const noexcept
+  {
+    return {static_cast<const char*>(address), size};
+  }
+
+private:
+  MappedFile(void* address, size_t size) noexcept;
+
+  void* const address;
+  const size_t size;
+};
+
+} // namespace utils
+
+#endif
@@ -0,0 +1,102 @@
+#ifndef _UTILS_SHARED_VIEW_HPP
+#define _UTILS_SHARED_VIEW_HPP
+
+#include <algorithm>
+#include <cstddef>
+#include <memory>
+#include <string_view>
+
+namespace utils {
+
+/**
+ * @brief Read-only view of bytes which may share ownership of the memory it points to.
+ *
+ * A view constructed from a plain `std::string_view` or a pointer owns nothing and is
+ * valid as long as the viewed memory is. A view with an owner keeps the memory alive, so
+ * it may be stored or passed to another thread.
+ */
+class SharedView {
+public:
+  SharedView() = default;
+
+  /// @brief Non-owning view.
+  SharedView(std::string_view view) noexcept :
+      content(view)
+  {}
+
+  /// @brief Non-owning view.
+  SharedView(const char* data, size_t size) noexcept :
+      content(data, size)
+  {}
+
+  /// @brief View of memory kept alive by `owner`.
+  SharedView(std::shared_ptr<const void> owner, std::string_view view) noexcept :
+      holder(std::move(owner)),
+      content(view)
+  {}
+
+  /// @returns Owning view of a heap copy of `data`.
+  static SharedView copy(std::string_view data)
+  {
+    if (data.empty()) {
+      return SharedView();
+    }
+
+    std::shared_ptr<char[]> storage = std::make_shared_for_overwrite<char[]>(data.size());
+    std::copy(data.begin(), data.end(), storage.get());
+
+    const std::string_view view(storage.get(), data.size());
+    return SharedView(std::move(storage), view);
+  }
+
+  const char* data() const noexcept
+  {
+    return content.data();
+  }
+
+  size_t size() const noexcept
+  {
+    return content.size();
+  }
+
+  bool empty() const noexcept
+  {
+    return content.empty();
+  }
+
+  std::string_view view() const noexcept
+  {
+    return content;
+  }
+
+  operator std::string_view() const noexcept
+  {
+    return content;
+  }
+
+  /// @returns `true` if the view keeps its memory alive.
+  bool owned() const noexcept
+  {
+    return static_cast<bool>(holder);
+  }
+
+  /// @returns Owner of the viewed memory, `nullptr` for a non-owning view.
+  const std::shared_ptr<const void>& owner() const noexcept
+  {
+    return holder;
+  }
+
+  /// @returns View of a part of this view sharing its ownership.
+  SharedView slice(size_t offset, size_t count = std::string_view::npos) const
+  {
+    return SharedView(holder, content.substr(offset, count));
+  }
+
+private:
+  std::shared_ptr<const void> holder;
+  std::string_view content;
+};
+
+} // namespace utils
+
+#endif
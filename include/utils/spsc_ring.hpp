@@ -0,0 +1,128 @@
+#ifndef _UTILS_SPSC_RING_HPP
+#define _UTILS_SPSC_RING_HPP
+
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <memory>
+#include <optional>
+
+namespace utils {
+
+/**
+ * @brief Bounded lock-free queue for exactly one producer thread and one consumer
+ * thread.
+ *
+ * `push()` blocks while the ring is full and `pop()` blocks while it is empty, which
+ * gives backpressure between the stages connected by the ring. Values are delivered in
+ * the order they were pushed.
+ *
+ * @tparam T Movable value type
+ */
+template<typename T>
+class SpscRing {
+public:
+  /// @param[in] capacity Maximum number of values in the ring. Rounded up to a power
+  /// of 2.
+  explicit SpscRing(size_t capacity) :
+      capacity(std::bit_ceil(capacity == 0 ? 1 : capacity)),
+      mask(this->capacity - 1),
+      slots(std::make_unique<std::optional<T>[]>(this->capacity))
+  {}
+
+  SpscRing(const SpscRing&) = delete;
+
+  SpscRing& operator=(const SpscRing&) = delete;
+
+  /// @brief Adds the value to the ring. Waits for a free slot if the ring is full.
+  void push(T value)
+  {
+    const auto tail_pos = tail.load(std::memory_order_relaxed);
+    auto head_pos = head.load(std::memory_order_acquire);
+
+    while (tail_pos - head_pos == capacity) {
+      head.wait(head_pos, std::memory_order_acquire);
+      head_pos = head.load(std::memory_order_acquire);
+    }
+
+    slots[tail_pos & mask].emplace(std::move(value));
+    tail.store(tail_pos + 1, std::memory_order_release);
+    tail.notify_one();
+  }
+
+  /// @brief Same as `push()` but fails instead of waiting.
+  /// @returns `false` if the ring is full. The value is left untouched then.
+  bool tryPush(T& value)
+  {
+    const auto tail_pos = tail.load(std::memory_order_relaxed);
+
+    if (tail_pos - head.load(std::memory_order_acquire) == capacity) {
+      return false;
+    }
+
+    slots[tail_pos & mask].emplace(std::move(value));
+    tail.store(tail_pos + 1, std::memory_order_release);
+    tail.notify_one();
+    return true;
+  }
+
+  /// @brief Extracts the oldest value. Waits for a value if the ring is empty.
+  T pop()
+  {
+    const auto head_pos = head.load(std::memory_order_relaxed);
+    auto tail_pos = tail.load(std::memory_order_acquire);
+
+    while (tail_pos == head_pos) {
+      tail.wait(tail_pos, std::memory_order_acquire);
+      tail_pos = tail.load(std::memory_order_acquire);
+    }
+
+    return extract(head_pos);
+  }
+
+  /// @brief Same as `pop()` but fails instead of waiting.
+  /// @returns `std::nullopt` if the ring is empty.
+  std::optional<T> tryPop()
+  {
+    const auto head_pos = head.load(std::memory_order_relaxed);
+
+    if (tail.load(std::memory_order_acquire) == head_pos) {
+      return std::nullopt;
+    }
+
+    return extract(head_pos);
+  }
+
+  /// @returns Number of values in the ring. Exact only for the producer or the consumer.
+  size_t size() const noexcept
+  {
+    return tail.load(std::memory_order_acquire) - head.load(std::memory_order_acquire);
+  }
+
+private:
+  T extract(size_t head_pos)
+  {
+    auto& slot = slots[head_pos & mask];
+    T value = std::move(*slot);
+
+    slot.reset();
+    head.store(head_pos + 1, std::memory_order_release);
+    head.notify_one();
+    return value;
+  }
+
+  static constexpr size_t CACHE_LINE = 64;
+
+  const size_t capacity;
+  const size_t mask;
+  std::unique_ptr<std::optional<T>[]> slots;
+
+  /// @brief Position of the next value to pop. Written by the consumer only.
+  alignas(CACHE_LINE) std::atomic<size_t> head{0};
+  /// @brief Position of the next value to push. Written by the producer only.
+  alignas(CACHE_LINE) std::atomic<size_t> tail{0};
+};
+
+} // namespace utils
+
+#endif
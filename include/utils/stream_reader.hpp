@@ -5,25 +5,43 @@
 #include <utils/common.hpp>
 
 #include <iostream>
+#include <string_view>
 #include <type_traits>
+#include <vector>
 
 namespace utils {
 
 /**
  * @brief Class for convenient relative reading from a stream.
  *
- * This class wraps around a standard input stream and provides helper methods for reading
- * binary data relative to the current position. It simplifies the use of standard stream
- * methods when dealing with binary data.
+ * This class wraps around a standard input stream or a file descriptor and provides
+ * helper methods for reading binary data relative to the current position. The input is
+ * read in large blocks into a window, which serves the reads and peeks, so the input is
+ * never seeked and may be a pipe or the standard input.
+ *
+ * Streams are read a whole block at a time. Descriptors are read as their data arrive,
+ * so a live pipe is better read through its descriptor.
  */
 struct StreamReader {
+  static constexpr size_t DEFAULT_BLOCK_SIZE = 1024 * 1024;
 
   /**
    * @brief Constructor from the required stream for convenient reading of binary data
    * relative to the current position
    * @param[in] in The stream from which to read binary data
+   * @param[in] block_size Bytes read from the stream at once
    */
-  explicit StreamReader(std::istream& in) noexcept;
+  explicit StreamReader(std::istream& in, size_t block_size = DEFAULT_BLOCK_SIZE);
+
+  /**
+   * @brief Constructor from a file descriptor, which stays owned by the caller
+   * @param[in] fd The descriptor from which to read binary data
+   * @param[in] block_size Bytes read from the descriptor at most at once
+   */
+  explicit StreamReader(int fd, size_t block_size = DEFAULT_BLOCK_SIZE);
+
+  StreamReader(const StreamReader&) = delete;
+  StreamReader& operator=(const StreamReader&) = delete;
 
   /**
    * @brief Read row data with advance to T value type and return it
@@ -80,17 +98,42 @@ struct StreamReader {
    */
   void peekCpy(char* dest, size_t offset, size_t size);
 
+  /**
+   * @brief Read a sequence with advance without copying it when it fits into the window.
+   * @param[in] size Size of required sequence
+   * @returns View of the window, valid until the next read or peek
+   * @throws `BadStream` Thrown if `size` more than available to read
+   */
+  std::string_view readView(size_t size);
+
   /**
    * @brief Check if the stream has reached its end.
    * @return true if end of stream, false otherwise
+   * @throws `BadStream` Thrown if reading the descriptor fails
    */
-  bool isEnd() noexcept;
+  bool isEnd();
 
 private:
-  /// @brief The stream from which to read binary data
-  std::istream& stream;
+  /// @brief Reads the input until `size` bytes are in the window or the input ends.
+  /// @returns `false` if the input ends before.
+  bool fill(size_t size);
+
+  /// @brief Reads at most `size` bytes into `dest`.
+  /// @returns Number of the read bytes, `0` at the end of the input.
+  size_t readInput(char* dest, size_t size);
+
+  /// @brief The stream from which to read binary data, `nullptr` for a descriptor
+  std::istream* stream;
+  int fd{-1};
+  const size_t block_size;
+
+  std::vector<char> buffer;
+  /// Window of the read but not consumed data in `buffer`.
+  size_t begin{0};
+  size_t end{0};
+  bool input_end{false};
 };
 
 } // namespace utils
 
-#endif
\ No newline at end of file
+#endif
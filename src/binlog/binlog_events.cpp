@@ -202,15 +202,22 @@ FormatDescriptionEvent::FormatDescriptionEvent(
   }
 
   size_t available_bytes = reader.available();
+  // The event itself is always checksummed, the algorithm precedes its checksum.
+  const bool describes_checksum = server_version_value() >= checksum_version_product;
 
-  if (server_version_value() >= checksum_version_product) {
+  if (describes_checksum) {
     available_bytes -= BINLOG_CHECKSUM_ALG_DESC_LEN + CHECKSUM_CRC32_SIGNATURE_LEN;
-    has_checksum = true;
   }
   number_of_event_types = available_bytes;
 
   post_header_len.resize(number_of_event_types);
   READ_ARR(post_header_len.data(), post_header_len.size());
+
+  // Servers configured with `binlog_checksum=NONE` write the events without checksums.
+  if (describes_checksum) {
+    READ(checksum_alg);
+    has_checksum = checksum_alg == BINLOG_CHECKSUM_ALG_CRC32;
+  }
 }
 
 void FormatDescriptionEvent::show(std::ostream& out) const
@@ -224,6 +231,7 @@ void FormatDescriptionEvent::show(std::ostream& out) const
   LOG_INFO(out) << "    dont_set_created: " << dont_set_created;
   LOG_INFO(out) << "   common_header_len: " << static_cast<int>(common_header_len);
   LOG_INFO(out) << "     post_header_len: " << post_header_len;
+  LOG_INFO(out) << "        checksum_alg: " << static_cast<int>(checksum_alg);
   LOG_INFO(out) << "        has_checksum: " << has_checksum;
 }
 
@@ -278,11 +286,13 @@ RowsEvent::RowsEvent(LogEventType type) :
     m_table_id(0),
     m_width(0),
     columns_before_image(0),
-    columns_after_image(0),
-    row(0)
+    columns_after_image(0)
 {}
 
-RowsEvent::RowsEvent(utils::StringBufferReader& reader, FormatDescriptionEvent* fde) :
+RowsEvent::RowsEvent(
+    utils::StringBufferReader& reader, FormatDescriptionEvent* fde,
+    std::shared_ptr<const void> owner
+) :
     BinlogEvent(reader, fde)
 {
   LogEventType type = header.type_code;
@@ -329,10 +339,10 @@ RowsEvent::RowsEvent(utils::StringBufferReader& reader, FormatDescriptionEvent*
     columns_after_image = columns_before_image;
   }
 
-  size_t data_size = reader.available();
+  const std::string_view data(reader.ptr(), reader.available());
 
-  row.resize(data_size);
-  READ_ARR(row.data(), row.size());
+  row = owner ? utils::SharedView(std::move(owner), data) : utils::SharedView::copy(data);
+  reader.skip(data.size());
 }
 
 void RowsEvent::show(std::ostream& out) const
@@ -348,13 +358,15 @@ void RowsEvent::show(std::ostream& out) const
   LOG_INFO(out) << "         var_header_len: " << var_header_len;
   LOG_INFO(out) << "   columns_before_image: " << columns_before_image;
   LOG_INFO(out) << "    columns_after_image: " << columns_after_image;
-  LOG_INFO(out) << "                    row: " << row;
+  LOG_INFO(out) << "                    row: "
+                << std::vector<uint8_t>(row.data(), row.data() + row.size());
 }
 
 DeleteRowsEvent::DeleteRowsEvent(
-    utils::StringBufferReader& reader, FormatDescriptionEvent* fde
+    utils::StringBufferReader& reader, FormatDescriptionEvent* fde,
+    std::shared_ptr<const void> owner
 ) :
-    RowsEvent(reader, fde)
+    RowsEvent(reader, fde, std::move(owner))
 {
   header.type_code = m_type;
 }
@@ -366,9 +378,10 @@ void DeleteRowsEvent::show(std::ostream& out) const
 }
 
 UpdateRowsEvent::UpdateRowsEvent(
-    utils::StringBufferReader& reader, FormatDescriptionEvent* fde
+    utils::StringBufferReader& reader, FormatDescriptionEvent* fde,
+    std::shared_ptr<const void> owner
 ) :
-    RowsEvent(reader, fde)
+    RowsEvent(reader, fde, std::move(owner))
 {
   header.type_code = m_type;
 }
@@ -380,9 +393,10 @@ void UpdateRowsEvent::show(std::ostream& out) const
 }
 
 WriteRowsEvent::WriteRowsEvent(
-    utils::StringBufferReader& reader, FormatDescriptionEvent* fde
+    utils::StringBufferReader& reader, FormatDescriptionEvent* fde,
+    std::shared_ptr<const void> owner
 ) :
-    RowsEvent(reader, fde)
+    RowsEvent(reader, fde, std::move(owner))
 {
   header.type_code = m_type;
 }
@@ -533,4 +547,121 @@ TableMapEvent::getOptionalField(OptinalMetadataType needed_type) const noexcept
   return std::nullopt;
 }
 
+GtidEvent::GtidEvent(utils::StringBufferReader& reader, FormatDescriptionEvent* fde) :
+    BinlogEvent(reader, fde)
+{
+  static constexpr uint8_t LOGICAL_TIMESTAMP_TYPECODE = 2;
+  static constexpr int COMMIT_TIMESTAMP_LENGTH = 7;
+  static constexpr uint64_t ORIGINAL_COMMIT_TIMESTAMP_FLAG = 1ULL << 55;
+  static constexpr uint32_t ORIGINAL_SERVER_VERSION_FLAG = 1U << 31;
+
+  READ(gtid_flags);
+  may_have_sbr_stmts = gtid_flags & FLAG_MAY_HAVE_SBR;
+  READ_ARR(tsid_parent_struct.m_uuid.bytes.data(), ENCODED_SID_LENGTH);
+  gtid_info_struct.rpl_gtid_sidno = 0;
+  READ(gtid_info_struct.rpl_gtid_gno);
+
+  last_committed = 0;
+  sequence_number = 0;
+
+  static constexpr size_t LOGICAL_CLOCK_LENGTH =
+      LOGICAL_TIMESTAMP_TYPECODE_LENGTH + LOGICAL_TIMESTAMP_LENGTH;
+
+  if (reader.available() >= LOGICAL_CLOCK_LENGTH &&
+      reader.read<uint8_t>() == LOGICAL_TIMESTAMP_TYPECODE)
+  {
+    READ(last_committed);
+    READ(sequence_number);
+  }
+
+  if (reader.available() >= COMMIT_TIMESTAMP_LENGTH) {
+    READ_ARR(&immediate_commit_timestamp, COMMIT_TIMESTAMP_LENGTH);
+    original_commit_timestamp = immediate_commit_timestamp;
+    has_commit_timestamps = true;
+
+    if (immediate_commit_timestamp & ORIGINAL_COMMIT_TIMESTAMP_FLAG) {
+      immediate_commit_timestamp &= ~ORIGINAL_COMMIT_TIMESTAMP_FLAG;
+      original_commit_timestamp = 0;
+      READ_ARR(&original_commit_timestamp, COMMIT_TIMESTAMP_LENGTH);
+    }
+  }
+
+  if (reader.available() > 0) {
+    transaction_length = get_packed_integer(reader);
+  }
+
+  if (reader.available() >= sizeof(immediate_server_version)) {
+    READ(immediate_server_version);
+    original_server_version = immediate_server_version;
+
+    if (immediate_server_version & ORIGINAL_SERVER_VERSION_FLAG) {
+      immediate_server_version &= ~ORIGINAL_SERVER_VERSION_FLAG;
+      READ(original_server_version);
+    }
+  }
+}
+
+void GtidEvent::show(std::ostream& out) const
+{
+  LOG_INFO(out) << "GtidEvent: ";
+  BinlogEvent::show(out);
+  LOG_INFO(out) << " Other info:";
+  LOG_INFO(out) << "               gno: " << gtid_info_struct.rpl_gtid_gno;
+  LOG_INFO(out) << "    last_committed: " << last_committed;
+  LOG_INFO(out) << "   sequence_number: " << sequence_number;
+  LOG_INFO(out) << "transaction_length: " << transaction_length;
+}
+
+PreviousGtidEvent::PreviousGtidEvent(
+    utils::StringBufferReader& reader, FormatDescriptionEvent* fde
+) :
+    BinlogEvent(reader, fde),
+    buf(reader.ptr(), reader.available())
+{}
+
+QueryEvent::QueryEvent(utils::StringBufferReader& reader, FormatDescriptionEvent* fde) :
+    BinlogEvent(reader, fde)
+{
+  const uint8_t post_header_size = fde->post_header_len[LogEventType::QUERY_EVENT - 1];
+  uint8_t db_len;
+
+  if (post_header_size < QUERY_HEADER_MINIMAL_LEN) {
+    THROW(std::runtime_error, "The post-header of the query event is too short");
+  }
+
+  READ(thread_id);
+  READ(query_exec_time);
+  READ(db_len);
+  READ(error_code);
+  status_vars_len = 0;
+  // Servers before 5.0 write no status variables.
+  if (post_header_size >= QUERY_HEADER_LEN) {
+    READ(status_vars_len);
+    reader.skip(post_header_size - QUERY_HEADER_LEN);
+  }
+  reader.skip(status_vars_len);
+
+  db.resize(db_len);
+  READ_ARR(db.data(), db_len);
+  // `db` is followed by a zero byte.
+  reader.skip(1);
+
+  query.resize(reader.available());
+  READ_ARR(query.data(), query.size());
+}
+
+XidEvent::XidEvent(utils::StringBufferReader& reader, FormatDescriptionEvent* fde) :
+    BinlogEvent(reader, fde)
+{
+  READ(xid);
+}
+
+void XidEvent::show(std::ostream& out) const
+{
+  LOG_INFO(out) << "XidEvent: ";
+  BinlogEvent::show(out);
+  LOG_INFO(out) << " Other info:";
+  LOG_INFO(out) << "             xid: " << xid;
+}
+
 } // namespace binlog::event
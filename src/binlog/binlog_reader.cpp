@@ -8,7 +8,9 @@
 #include <fstream>
 #include <iomanip>
 #include <iostream>
+#include <string_view>
 #include <type_traits>
+#include <unistd.h>
 
 #define READ(reader, value) ((value) = reader.read<decltype(value)>())
 #define PEEK(reader, value, ...) ((value) = reader.peek<decltype(value)>(__VA_ARGS__))
@@ -22,20 +24,16 @@ void processEvents(utils::StreamReader& reader, ProcessFunc&& func)
 
   FormatDescriptionEvent::UPtr fde =
       std::make_unique<FormatDescriptionEvent>(BINLOG_VERSION, SERVER_VERSION);
-  std::string buffer;
   uint32_t event_size;
   LogEventType event_type;
-  buffer.reserve(1024);
 
   while (!reader.isEnd()) {
     bool process_event = true;
     PEEK(reader, event_size, DATA_WRITTEN_OFFSET);
     PEEK(reader, event_type, EVENT_TYPE_OFFSET);
-    buffer.resize(event_size);
 
-    reader.readCpy(buffer.data(), buffer.size());
-
-    utils::StringBufferReader event_reader(buffer.data(), event_size);
+    // The event is a view of the window of the reader until the next read.
+    utils::StringBufferReader event_reader(reader.readView(event_size));
 
     BinlogEvent::UPtr ev;
 
@@ -58,6 +56,13 @@ void processEvents(utils::StreamReader& reader, ProcessFunc&& func)
     case LogEventType::WRITE_ROWS_EVENT_V1:
       ev = std::make_unique<WriteRowsEvent>(event_reader, fde.get());
       break;
+    case LogEventType::XID_EVENT:
+      ev = std::make_unique<XidEvent>(event_reader, fde.get());
+      break;
+    case LogEventType::GTID_LOG_EVENT:
+    case LogEventType::ANONYMOUS_GTID_LOG_EVENT:
+      ev = std::make_unique<GtidEvent>(event_reader, fde.get());
+      break;
     default:
       LOG_WARNING() << "Unknown event";
       process_event = false;
@@ -72,23 +77,14 @@ void processEvents(utils::StreamReader& reader, ProcessFunc&& func)
     }
   }
 }
-} // namespace
-
-namespace binlog::reader {
 
-int read(const char* file_path, std::vector<binlog::event::BinlogEvent::UPtr>& storage)
+/// @brief Prints the events of the binlog read from the start by the reader.
+int showEvents(utils::StreamReader& reader, const char* file_path)
 {
+  using namespace binlog;
   using namespace binlog::event;
-  std::ifstream binlog_file(file_path, std::ios::in | std::ios::binary);
-
   uint32_t magic_num;
 
-  if (!binlog_file) {
-    LOG_ERROR() << fmt::format("binlog file '{}' not found", file_path);
-    return -1;
-  }
-
-  utils::StreamReader reader(binlog_file);
   try {
     READ(reader, magic_num);
 
@@ -133,6 +129,17 @@ int read(const char* file_path, std::vector<binlog::event::BinlogEvent::UPtr>& s
       table_event->TableMapEvent::show();
       break;
     }
+    case LogEventType::XID_EVENT: {
+      const auto* xid_event = static_cast<const XidEvent*>(ev.get());
+      xid_event->show();
+      break;
+    }
+    case LogEventType::GTID_LOG_EVENT:
+    case LogEventType::ANONYMOUS_GTID_LOG_EVENT: {
+      const auto* gtid_event = static_cast<const GtidEvent*>(ev.get());
+      gtid_event->show();
+      break;
+    }
     default:
       LOG_INFO() << "Unknown event";
     }
@@ -141,5 +148,27 @@ int read(const char* file_path, std::vector<binlog::event::BinlogEvent::UPtr>& s
 
   return 0;
 }
+} // namespace
+
+namespace binlog::reader {
+
+int read(const char* file_path, std::vector<binlog::event::BinlogEvent::UPtr>& storage)
+{
+  // `-` reads the standard input, which may be a pipe.
+  if (std::string_view(file_path) == "-") {
+    utils::StreamReader reader(STDIN_FILENO);
+    return showEvents(reader, file_path);
+  }
+
+  std::ifstream binlog_file(file_path, std::ios::in | std::ios::binary);
+
+  if (!binlog_file) {
+    LOG_ERROR() << fmt::format("binlog file '{}' not found", file_path);
+    return -1;
+  }
+
+  utils::StreamReader reader(binlog_file);
+  return showEvents(reader, file_path);
+}
 
 } // namespace binlog::reader
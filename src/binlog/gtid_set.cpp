@@ -0,0 +1,329 @@
+#include <binlog/gtid_set.hpp>
+
+#include <algorithm>
+#include <charconv>
+#include <cstring>
+#include <fmt/format.h>
+
+namespace binlog {
+
+namespace {
+
+constexpr std::string_view WHITESPACE = " \t\r\n";
+
+std::string_view trim(std::string_view text) noexcept
+{
+  const auto begin = text.find_first_not_of(WHITESPACE);
+
+  if (begin == std::string_view::npos) {
+    return {};
+  }
+
+  return text.substr(begin, text.find_last_not_of(WHITESPACE) + 1 - begin);
+}
+
+int hexDigit(char c) noexcept
+{
+  if (c >= '0' && c <= '9') {
+    return c - '0';
+  }
+  if (c >= 'a' && c <= 'f') {
+    return c - 'a' + 10;
+  }
+  if (c >= 'A' && c <= 'F') {
+    return c - 'A' + 10;
+  }
+  return -1;
+}
+
+Uuid parseUuid(std::string_view text)
+{
+  Uuid uuid{};
+  size_t digits = 0;
+
+  for (const char c : text) {
+    if (c == '-') {
+      continue;
+    }
+
+    const int digit = hexDigit(c);
+
+    if (digit < 0 || digits == 2 * Uuid::BYTE_LENGTH) {
+      THROW(GtidSet::GtidSetError, fmt::format("Invalid server uuid `{}`", text));
+    }
+
+    uuid.bytes[digits / 2] |= digit << (digits % 2 == 0 ? 4 : 0);
+    ++digits;
+  }
+
+  if (digits != 2 * Uuid::BYTE_LENGTH) {
+    THROW(GtidSet::GtidSetError, fmt::format("Invalid server uuid `{}`", text));
+  }
+
+  return uuid;
+}
+
+int64_t parseNumber(std::string_view text)
+{
+  int64_t number = 0;
+  const auto* last = text.data() + text.size();
+  const auto [end, error] = std::from_chars(text.data(), last, number);
+
+  if (error != std::errc{} || end != last || number <= 0) {
+    THROW(GtidSet::GtidSetError, fmt::format("Invalid transaction number `{}`", text));
+  }
+
+  return number;
+}
+
+std::string formatUuid(const Uuid& uuid)
+{
+  const auto& b = uuid.bytes;
+
+  return fmt::format(
+      "{:02x}{:02x}{:02x}{:02x}-{:02x}{:02x}-{:02x}{:02x}-{:02x}{:02x}-"
+      "{:02x}{:02x}{:02x}{:02x}{:02x}{:02x}",
+      b[0], b[1], b[2], b[3], b[4], b[5], b[6], b[7], b[8], b[9], b[10], b[11], b[12],
+      b[13], b[14], b[15]
+  );
+}
+
+template<typename T>
+unsigned char* put(unsigned char* out, T value) noexcept
+{
+  std::memcpy(out, &value, sizeof(value));
+  return out + sizeof(value);
+}
+
+} // namespace
+
+GtidSet GtidSet::parse(std::string_view text)
+{
+  GtidSet result;
+
+  while (!trim(text).empty()) {
+    const auto comma = text.find(',');
+    auto sid = trim(text.substr(0, comma));
+    text = comma == std::string_view::npos ? std::string_view{} : text.substr(comma + 1);
+
+    auto colon = sid.find(':');
+
+    if (colon == std::string_view::npos) {
+      THROW(GtidSetError, fmt::format("No transactions of server `{}`", sid));
+    }
+
+    auto& list = result.intervals[parseUuid(trim(sid.substr(0, colon)))];
+
+    while (colon != std::string_view::npos) {
+      sid = sid.substr(colon + 1);
+      colon = sid.find(':');
+
+      const auto interval = trim(sid.substr(0, colon));
+      const auto dash = interval.find('-');
+      const int64_t start = parseNumber(interval.substr(0, dash));
+      const int64_t last =
+          dash == std::string_view::npos ? start : parseNumber(interval.substr(dash + 1));
+
+      if (last < start) {
+        THROW(GtidSetError, fmt::format("Invalid interval `{}`", interval));
+      }
+
+      list.push_back({start, last + 1});
+    }
+  }
+
+  result.normalize();
+
+  return result;
+}
+
+GtidSet GtidSet::decode(utils::StringBufferReader& reader)
+{
+  GtidSet result;
+  const auto n_sids = reader.read<uint64_t>();
+
+  // Tagged sets of MySQL 8.3 mark their format in the high byte.
+  if (n_sids >> 56 != 0) {
+    THROW(GtidSetError, "Tagged GTID sets are not supported");
+  }
+
+  for (uint64_t i = 0; i < n_sids; ++i) {
+    Uuid uuid;
+    reader.readCpy(reinterpret_cast<char*>(uuid.bytes.data()), uuid.bytes.size());
+
+    auto& list = result.intervals[uuid];
+    const auto n_intervals = reader.read<uint64_t>();
+
+    for (uint64_t j = 0; j < n_intervals; ++j) {
+      const auto start = reader.read<int64_t>();
+      const auto end = reader.read<int64_t>();
+
+      if (start <= 0 || end <= start) {
+        THROW(GtidSetError, fmt::format("Invalid interval [{}, {})", start, end));
+      }
+
+      list.push_back({start, end});
+    }
+  }
+
+  result.normalize();
+
+  return result;
+}
+
+void GtidSet::add(const Uuid& uuid, int64_t gno)
+{
+  auto& list = intervals[uuid];
+
+  // The first interval ending at or after `gno`, usually the last one.
+  auto it = std::lower_bound(
+      list.begin(), list.end(), gno,
+      [](const Interval& interval, int64_t value) { return interval.end < value; }
+  );
+
+  if (it != list.end() && it->start <= gno) {
+    if (gno < it->end) {
+      return;
+    }
+
+    it->end = gno + 1;
+
+    if (const auto next = std::next(it); next != list.end() && next->start == it->end) {
+      it->end = next->end;
+      list.erase(next);
+    }
+  } else if (it != list.end() && it->start == gno + 1) {
+    it->start = gno;
+  } else {
+    list.insert(it, {gno, gno + 1});
+  }
+}
+
+void GtidSet::merge(const GtidSet& other)
+{
+  for (const auto& [uuid, list] : other.intervals) {
+    auto& own = intervals[uuid];
+    own.insert(own.end(), list.begin(), list.end());
+  }
+
+  normalize();
+}
+
+bool GtidSet::contains(const Uuid& uuid, int64_t gno) const noexcept
+{
+  const auto found = intervals.find(uuid);
+
+  if (found == intervals.end()) {
+    return false;
+  }
+
+  const auto it = std::upper_bound(
+      found->second.begin(), found->second.end(), gno,
+      [](int64_t value, const Interval& interval) { return value < interval.end; }
+  );
+
+  return it != found->second.end() && it->start <= gno;
+}
+
+bool GtidSet::empty() const noexcept
+{
+  return std::all_of(intervals.begin(), intervals.end(), [](const auto& entry) {
+    return entry.second.empty();
+  });
+}
+
+std::string GtidSet::toString() const
+{
+  std::string result;
+
+  for (const auto& [uuid, list] : intervals) {
+    if (list.empty()) {
+      continue;
+    }
+
+    if (!result.empty()) {
+      result += ',';
+    }
+
+    result += formatUuid(uuid);
+
+    for (const auto& interval : list) {
+      if (interval.end == interval.start + 1) {
+        result += fmt::format(":{}", interval.start);
+      } else {
+        result += fmt::format(":{}-{}", interval.start, interval.end - 1);
+      }
+    }
+  }
+
+  return result;
+}
+
+size_t GtidSet::encodedSize() const noexcept
+{
+  size_t size = sizeof(uint64_t);
+
+  for (const auto& [uuid, list] : intervals) {
+    if (!list.empty()) {
+      size += Uuid::BYTE_LENGTH + sizeof(uint64_t) + list.size() * 2 * sizeof(int64_t);
+    }
+  }
+
+  return size;
+}
+
+void GtidSet::encode(unsigned char* out) const noexcept
+{
+  const auto n_sids =
+      std::count_if(intervals.begin(), intervals.end(), [](const auto& entry) {
+        return !entry.second.empty();
+      });
+
+  out = put<uint64_t>(out, n_sids);
+
+  for (const auto& [uuid, list] : intervals) {
+    if (list.empty()) {
+      continue;
+    }
+
+    std::memcpy(out, uuid.bytes.data(), uuid.bytes.size());
+    out = put<uint64_t>(out + uuid.bytes.size(), list.size());
+
+    for (const auto& interval : list) {
+      out = put(out, interval.start);
+      out = put(out, interval.end);
+    }
+  }
+}
+
+bool GtidSet::operator==(const GtidSet& other) const
+{
+  return toString() == other.toString();
+}
+
+void GtidSet::normalize()
+{
+  for (auto& [uuid, list] : intervals) {
+    std::sort(list.begin(), list.end(), [](const Interval& a, const Interval& b) {
+      return a.start < b.start;
+    });
+
+    if (list.empty()) {
+      continue;
+    }
+
+    auto last = list.begin();
+
+    for (auto it = std::next(list.begin()); it != list.end(); ++it) {
+      if (it->start <= last->end) {
+        last->end = std::max(last->end, it->end);
+      } else {
+        *++last = *it;
+      }
+    }
+
+    list.erase(std::next(last), list.end());
+  }
+}
+
+} // namespace binlog
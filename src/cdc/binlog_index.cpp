@@ -0,0 +1,378 @@
+#include <binlog/binlog_events.hpp>
+#include <cdc/binlog_index.hpp>
+#include <utils/string_buffer_reader.hpp>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <filesystem>
+#include <string_view>
+#include <unistd.h>
+
+#define PEEK(value, reader, ...) ((value) = (reader).peek<decltype(value)>(__VA_ARGS__))
+
+namespace cdc {
+
+namespace {
+
+constexpr std::string_view INDEX_MAGIC = "CDCBIDX1";
+
+/// @brief Header of the index file, the entries follow it.
+struct IndexHeader {
+  char magic[8];
+  /// Size of the indexed part of the binlog file, the next update continues there.
+  uint64_t indexed_bytes;
+  /// Events in the indexed part, counting every `interval`-th event continues from it.
+  uint64_t events;
+  uint64_t entries;
+  uint32_t interval;
+  /// The next event may start a transaction.
+  uint8_t boundary;
+  uint8_t reserved[3];
+};
+
+static_assert(sizeof(IndexHeader) % alignof(BinlogIndexEntry) == 0);
+
+/// @brief Closes the descriptor on every way out of the update.
+struct Descriptor {
+  ~Descriptor()
+  {
+    if (fd >= 0) {
+      close(fd);
+    }
+  }
+
+  int fd;
+};
+
+bool isRowsEvent(uint8_t type) noexcept
+{
+  using namespace binlog::event;
+
+  switch (type) {
+  case WRITE_ROWS_EVENT_V1:
+  case UPDATE_ROWS_EVENT_V1:
+  case DELETE_ROWS_EVENT_V1:
+  case WRITE_ROWS_EVENT:
+  case UPDATE_ROWS_EVENT:
+  case DELETE_ROWS_EVENT:
+  case PARTIAL_UPDATE_ROWS_EVENT:
+    return true;
+  default:
+    return false;
+  }
+}
+
+/// @returns Offset of the first event of the binlog.
+uint64_t firstEventOffset(std::string_view binlog)
+{
+  // Files written by the server start with the magic number, dumped streams don't.
+  if (binlog.size() >= sizeof(binlog::BINLOG_MAGIC)) {
+    utils::StringBufferReader reader(binlog);
+
+    if (reader.peek<uint32_t>() == binlog::BINLOG_MAGIC) {
+      return sizeof(binlog::BINLOG_MAGIC);
+    }
+  }
+
+  return 0;
+}
+
+/// @returns Header of an index built anew.
+IndexHeader emptyHeader(std::string_view binlog, uint32_t interval)
+{
+  IndexHeader header{};
+
+  std::copy(INDEX_MAGIC.begin(), INDEX_MAGIC.end(), header.magic);
+  header.interval = interval;
+  header.boundary = 1;
+  header.indexed_bytes = firstEventOffset(binlog);
+
+  return header;
+}
+
+/// @returns The format description event starting the binlog, the default one if there is
+/// none yet.
+binlog::event::FormatDescriptionEvent formatOf(std::string_view binlog)
+{
+  const auto offset = firstEventOffset(binlog);
+  binlog::event::FormatDescriptionEvent fde(
+      binlog::BINLOG_VERSION, binlog::SERVER_VERSION
+  );
+
+  if (binlog.size() - offset < binlog::LOG_EVENT_HEADER_LEN) {
+    return fde;
+  }
+
+  utils::StringBufferReader header(binlog.data() + offset, binlog::LOG_EVENT_HEADER_LEN);
+  uint8_t event_type;
+  uint32_t event_size;
+
+  PEEK(event_type, header, binlog::EVENT_TYPE_OFFSET);
+  PEEK(event_size, header, binlog::DATA_WRITTEN_OFFSET);
+
+  if (event_type == binlog::event::FORMAT_DESCRIPTION_EVENT &&
+      event_size <= binlog.size() - offset)
+  {
+    utils::StringBufferReader reader(binlog.data() + offset, event_size);
+
+    fde = binlog::event::FormatDescriptionEvent(reader, &fde);
+  }
+
+  return fde;
+}
+
+} // namespace
+
+std::string BinlogIndex::pathOf(const std::string& binlog_path)
+{
+  return binlog_path + ".idx";
+}
+
+uint64_t BinlogIndex::update(const std::string& binlog_path, BinlogIndexOptions options)
+{
+  using namespace binlog::event;
+
+  const auto index_path = pathOf(binlog_path);
+  const auto binlog = utils::MappedFile::open(binlog_path, true);
+  const auto content = binlog->content();
+  const Descriptor index{::open(index_path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644)};
+
+  if (index.fd < 0) {
+    THROW(
+        BinlogIndexError,
+        fmt::format("Can't open `{}`: {}", index_path, std::strerror(errno))
+    );
+  }
+
+  IndexHeader header;
+  // An index without events is built anew, the file may have had no magic number yet.
+  const bool valid =
+      pread(index.fd, &header, sizeof(header), 0) == sizeof(header) &&
+      std::string_view(header.magic, sizeof(header.magic)) == INDEX_MAGIC &&
+      header.interval == options.interval && header.events != 0 &&
+      header.indexed_bytes <= content.size();
+
+  if (!valid) {
+    header = emptyHeader(content, options.interval);
+  }
+
+  std::vector<BinlogIndexEntry> added;
+  uint64_t offset = header.indexed_bytes;
+  const auto events = header.events;
+  // Query texts end before the checksum the format description event describes.
+  auto fde = formatOf(content);
+
+  while (content.size() - offset >= binlog::LOG_EVENT_HEADER_LEN) {
+    utils::StringBufferReader reader(content.substr(offset));
+    uint32_t event_size;
+
+    PEEK(event_size, reader, binlog::DATA_WRITTEN_OFFSET);
+
+    if (event_size < binlog::LOG_EVENT_HEADER_LEN) {
+      THROW(
+          BinlogIndexError,
+          fmt::format(
+              "Invalid size {} of the event at {} of `{}`", event_size, offset,
+              binlog_path
+          )
+      );
+    }
+    // The server may be writing the event, the next update indexes it.
+    if (event_size > content.size() - offset) {
+      break;
+    }
+
+    BinlogIndexEntry entry{};
+    bool ends_transaction = false;
+
+    entry.offset = offset;
+    PEEK(entry.when, reader);
+    PEEK(entry.type, reader, binlog::EVENT_TYPE_OFFSET);
+
+    switch (entry.type) {
+    case GTID_LOG_EVENT:
+      reader.peekCpy(
+          reinterpret_cast<char*>(entry.uuid.bytes.data()),
+          binlog::LOG_EVENT_HEADER_LEN + 1, binlog::Uuid::BYTE_LENGTH
+      );
+      PEEK(
+          entry.gno, reader, binlog::LOG_EVENT_HEADER_LEN + 1 + binlog::Uuid::BYTE_LENGTH
+      );
+      entry.flags = BinlogIndexEntry::TRANSACTION_START | BinlogIndexEntry::HAS_GTID;
+      break;
+    case ANONYMOUS_GTID_LOG_EVENT:
+    case GTID_EVENT:
+      entry.flags = BinlogIndexEntry::TRANSACTION_START;
+      break;
+    case XID_EVENT:
+      ends_transaction = true;
+      break;
+    case QUERY_EVENT: {
+      utils::StringBufferReader event_reader(content.data() + offset, event_size);
+      const QueryEvent query_event(event_reader, &fde);
+
+      // Transactions of servers without GTIDs start with a query, `BEGIN` or a statement
+      // logged alone. Such a statement, like `COMMIT`, ends its transaction.
+      if (header.boundary) {
+        entry.flags = BinlogIndexEntry::TRANSACTION_START;
+      }
+      ends_transaction = query_event.query != "BEGIN";
+      break;
+    }
+    default:
+      if (entry.type == TABLE_MAP_EVENT || isRowsEvent(entry.type)) {
+        // Table ids take 6 bytes.
+        reader.peekCpy(
+            reinterpret_cast<char*>(&entry.table_id), binlog::LOG_EVENT_HEADER_LEN, 6
+        );
+      }
+      break;
+    }
+
+    if (entry.transactionStart()) {
+      header.boundary = 0;
+    }
+    if (ends_transaction) {
+      header.boundary = 1;
+    }
+    if (entry.transactionStart() ||
+        (options.interval != 0 && header.events % options.interval == 0))
+    {
+      added.push_back(entry);
+    }
+
+    offset += event_size;
+    ++header.events;
+  }
+
+  if (valid && offset == header.indexed_bytes) {
+    return 0;
+  }
+
+  header.indexed_bytes = offset;
+
+  const auto entries_bytes = added.size() * sizeof(BinlogIndexEntry);
+  const auto entries_offset = sizeof(header) + header.entries * sizeof(BinlogIndexEntry);
+
+  // The header is written after the entries, so an interrupted update is repeated.
+  if ((!valid && ftruncate(index.fd, 0) != 0) ||
+      pwrite(index.fd, added.data(), entries_bytes, entries_offset) !=
+          static_cast<ssize_t>(entries_bytes))
+  {
+    THROW(
+        BinlogIndexError,
+        fmt::format("Can't write `{}`: {}", index_path, std::strerror(errno))
+    );
+  }
+
+  header.entries += added.size();
+
+  if (pwrite(index.fd, &header, sizeof(header), 0) != sizeof(header)) {
+    THROW(
+        BinlogIndexError,
+        fmt::format("Can't write `{}`: {}", index_path, std::strerror(errno))
+    );
+  }
+
+  LOG_DEBUG() << fmt::format(
+      "Indexed {} events of `{}` up to {}", header.events - events, binlog_path, offset
+  );
+
+  return header.events - events;
+}
+
+BinlogIndex BinlogIndex::open(const std::string& binlog_path, BinlogIndexOptions options)
+{
+  update(binlog_path, options);
+
+  return BinlogIndex(utils::MappedFile::open(pathOf(binlog_path), false));
+}
+
+BinlogIndex::BinlogIndex(std::shared_ptr<const utils::MappedFile> mapping) :
+    mapping(std::move(mapping))
+{
+  const auto content = this->mapping->content();
+  IndexHeader header;
+
+  if (content.size() < sizeof(header)) {
+    THROW(BinlogIndexError, "The index is truncated");
+  }
+  std::memcpy(&header, content.data(), sizeof(header));
+
+  if (content.size() < sizeof(header) + header.entries * sizeof(BinlogIndexEntry)) {
+    THROW(BinlogIndexError, "The index is truncated");
+  }
+
+  // The mapping is aligned to a page and the header keeps the entries aligned.
+  items = {
+      reinterpret_cast<const BinlogIndexEntry*>(content.data() + sizeof(header)),
+      static_cast<size_t>(header.entries)
+  };
+  indexed_bytes = header.indexed_bytes;
+}
+
+const BinlogIndexEntry* BinlogIndex::atPosition(uint64_t position, bool transaction_start)
+    const
+{
+  auto it = std::upper_bound(
+      items.begin(), items.end(), position,
+      [](uint64_t position, const BinlogIndexEntry& entry) {
+        return position < entry.offset;
+      }
+  );
+
+  while (it != items.begin()) {
+    --it;
+
+    if (!transaction_start || it->transactionStart()) {
+      return &*it;
+    }
+  }
+
+  return nullptr;
+}
+
+const BinlogIndexEntry* BinlogIndex::atTime(uint32_t when) const
+{
+  auto it = std::partition_point(items.begin(), items.end(), [when](const auto& entry) {
+    return entry.when < when;
+  });
+
+  it = std::find_if(it, items.end(), [](const auto& entry) {
+    return entry.transactionStart();
+  });
+
+  return it != items.end() ? &*it : nullptr;
+}
+
+const BinlogIndexEntry* BinlogIndex::atGtid(const binlog::Uuid& uuid, int64_t gno) const
+{
+  const auto it = std::find_if(items.begin(), items.end(), [&](const auto& entry) {
+    return (entry.flags & BinlogIndexEntry::HAS_GTID) && entry.uuid == uuid &&
+           entry.gno == gno;
+  });
+
+  return it != items.end() ? &*it : nullptr;
+}
+
+std::optional<BinlogPosition> BinlogIndex::seekTime(
+    const std::vector<std::string>& binlog_paths, uint32_t when,
+    BinlogIndexOptions options
+)
+{
+  for (const auto& path : binlog_paths) {
+    const auto index = open(path, options);
+
+    if (const auto* entry = index.atTime(when)) {
+      const auto file = std::filesystem::path(path).filename().string();
+
+      return BinlogPosition{file, entry->offset};
+    }
+  }
+
+  return std::nullopt;
+}
+
+} // namespace cdc
@@ -1,75 +1,121 @@
 #include <binlog/binlog_events.hpp>
 #include <cdc/cdc.hpp>
 
+#include <algorithm>
+#include <charconv>
 #include <chrono>
 #include <components/document/document.hpp>
 #include <concepts>
+#include <fmt/ranges.h>
 #include <thread>
 #include <utility>
 
 #define READ(value, reader) ((value) = (reader).read<decltype(value)>())
 #define PEEK(value, reader, ...) ((value) = (reader).peek<decltype(value)>(__VA_ARGS__))
 
-namespace {
-
-template<std::ranges::range T>
-void toVectorBool(std::vector<bool>& result, const T& source)
-{
-  using TValueType = std::remove_cvref_t<decltype(*source.begin())>;
-  static constexpr size_t value_type_size = sizeof(TValueType) * 8;
-
-  result.clear();
-  result.reserve(source.size() * value_type_size);
-  [&]<size_t... Ind>(std::index_sequence<Ind...>) {
-    for (const auto& elem : source) {
-      (result.push_back((elem >> Ind) & 1), ...);
-    }
-  }(std::make_index_sequence<value_type_size>{});
-}
-
-std::pmr::string gen_id(uint64_t num, std::pmr::memory_resource* resource)
-{
-  static constexpr int id_len = 24;
-  std::pmr::string str_num{std::to_string(num), resource};
-  std::pmr::string result(resource);
-  result.reserve(id_len);
-  result.resize(id_len - str_num.size(), '0');
-  return result + str_num;
-}
-
-} // namespace
-
 namespace cdc {
 
 DBBufferSource::DBBufferSource(
     const char* host, const char* user, const char* passwd, const char* db,
-    unsigned int port
+    unsigned int port, PrefetchOptions prefetch_options,
+    std::optional<BinlogPosition> start_position
 ) :
     host(host),
     user(user),
     passwd(passwd),
     db(db),
-    port(port)
+    port(port),
+    prefetch_options(prefetch_options)
 {
+  if (start_position) {
+    LOG_INFO() << fmt::format(
+        "Resuming from {}:{}", start_position->file, start_position->position
+    );
+    file_path = std::move(start_position->file);
+    next_pos = static_cast<uint32_t>(start_position->position);
+    received = binlog::GtidSet::parse(start_position->gtid_set);
+    gtid_positioning = !received.empty();
+  }
+
   mysql_init(&conn);
   connect();
+
+  if (prefetch_options.enabled) {
+    pool = utils::BufferPool::create(prefetch_options.pool_bytes);
+    fetched = std::make_unique<utils::SpscRing<Fetched>>(prefetch_options.depth);
+    fetcher = std::thread([this]() {
+      prefetch();
+    });
+  }
 }
 
 DBBufferSource::~DBBufferSource()
 {
+  stopPrefetch();
   disconnect();
 }
 
+bool DBBufferSource::ready() const
+{
+  return fetched && (finished || fetched->size() != 0);
+}
+
 std::optional<Buffer> DBBufferSource::getDataImpl()
 {
-  while (true) {
+  if (!fetched) {
     const auto& buffer = nextEventBuffer();
 
     process(buffer);
 
     return buffer;
   }
-  return std::nullopt;
+
+  if (finished) {
+    return std::nullopt;
+  }
+
+  auto item = fetched->pop();
+
+  if (!item.buffer.has_value()) {
+    finished = true;
+
+    if (item.error) {
+      std::rethrow_exception(item.error);
+    }
+  }
+
+  return std::move(item.buffer);
+}
+
+void DBBufferSource::prefetch()
+{
+  try {
+    while (!stopping.load(std::memory_order_relaxed)) {
+      const auto buffer = nextEventBuffer();
+
+      process(buffer);
+      fetched->push(Fetched{pool->copy(buffer), nullptr});
+    }
+    fetched->push(Fetched{std::nullopt, nullptr});
+  } catch (...) {
+    fetched->push(Fetched{std::nullopt, std::current_exception()});
+  }
+}
+
+void DBBufferSource::stopPrefetch()
+{
+  if (!fetcher.joinable()) {
+    return;
+  }
+
+  // The fetcher checks the flag after every event or heartbeat. Draining the ring
+  // releases it if it waits for a free slot.
+  stopping.store(true, std::memory_order_relaxed);
+
+  while (!finished) {
+    finished = !fetched->pop().buffer.has_value();
+  }
+  fetcher.join();
 }
 
 void DBBufferSource::connect()
@@ -86,6 +132,15 @@ void DBBufferSource::connect()
   // To update position of next not processed event
   rotate();
 
+  // Heartbeats of an idle server let the fetching thread notice the stop request.
+  if (prefetch_options.enabled &&
+      mysql_query(&conn, "SET @master_heartbeat_period = 1000000000"))
+  {
+    LOG_WARNING() << fmt::format(
+        "Can't enable heartbeats of `{}`: {}", db, mysql_error(&conn)
+    );
+  }
+
   if (mysql_binlog_open(&conn, &rpl)) {
     mysql_close(&conn);
     THROW(DBBinlogError, "Can't open binlog source");
@@ -110,6 +165,25 @@ void DBBufferSource::rotate()
   rpl.flags = 0;
   fde = {binlog::BINLOG_VERSION, binlog::SERVER_VERSION};
 
+  // File positions differ between servers, GTIDs survive a failover.
+  if (gtid_positioning) {
+    // A partially received transaction is sent again from its start, its rows received
+    // so far are rolled back by `TableDiffAssembler`.
+    current_gtid.reset();
+    rpl.file_name = nullptr;
+    rpl.file_name_length = 0;
+    rpl.start_position = 4;
+    rpl.flags |= MYSQL_RPL_GTID;
+    rpl.gtid_set_encoded_size = received.encodedSize();
+    rpl.fix_gtid_set = [](MYSQL_RPL* rpl, unsigned char* packet) {
+      static_cast<const binlog::GtidSet*>(rpl->gtid_set_arg)->encode(packet);
+    };
+    rpl.gtid_set_arg = &received;
+
+    LOG_DEBUG() << "         rpl.gtid_set: " << received.toString();
+    return;
+  }
+
   LOG_DEBUG() << "Rotation:";
   LOG_DEBUG() << "         rpl.file_name: " << rpl.file_name;
   LOG_DEBUG() << "  rpl.file_name_length: " << rpl.file_name_length;
@@ -177,76 +251,252 @@ void DBBufferSource::process(std::string_view buffer)
     fde = binlog::event::FormatDescriptionEvent(reader, &fde);
     break;
   }
+  case binlog::event::GTID_LOG_EVENT: {
+    // The previous transaction without a commit event, e.g. DDL, is complete.
+    if (current_gtid) {
+      received.add(current_gtid->first, current_gtid->second);
+    }
+
+    const binlog::event::GtidEvent gtid_event(reader, &fde);
+    current_gtid.emplace(
+        gtid_event.tsid_parent_struct.m_uuid, gtid_event.gtid_info_struct.rpl_gtid_gno
+    );
+    break;
+  }
+  case binlog::event::XID_EVENT: {
+    if (current_gtid) {
+      received.add(current_gtid->first, current_gtid->second);
+      current_gtid.reset();
+    }
+    break;
+  }
   }
 }
 
-EventSource::EventSource(BufferSourceI::UPtr buffer_source, DataHandler data_handler) :
-    EventSourceI(data_handler),
-    buffer_source(std::move(buffer_source))
+EventParser::EventParser(binlog::GtidSet applied) :
+    applied(std::move(applied))
 {}
 
-std::optional<Binlog> EventSource::getDataImpl()
+Binlog EventParser::parse(const Buffer& buffer)
 {
   using namespace binlog;
   event::BinlogEvent::UPtr ev;
 
-  while (!ev) {
-    const auto data = buffer_source->getData();
-    if (!data) {
-      return std::nullopt;
-    }
-    static event::FormatDescriptionEvent::SPtr fde =
-        std::make_shared<event::FormatDescriptionEvent>(BINLOG_VERSION, SERVER_VERSION);
-
-    utils::StringBufferReader reader(data->data(), data->size());
-    event::LogEventType event_type;
-    PEEK(event_type, reader, EVENT_TYPE_OFFSET);
+  utils::StringBufferReader reader(buffer.data(), buffer.size());
+  event::LogEventType event_type;
+  // Rows of an owning buffer are shared instead of copied.
+  const auto& owner = buffer.owner();
+  PEEK(event_type, reader, EVENT_TYPE_OFFSET);
 
+  // A skipped transaction lasts until the next transaction or binlog file.
+  if (skipping) {
     switch (event_type) {
-    case binlog::event::LogEventType::FORMAT_DESCRIPTION_EVENT:
-      ev = std::make_unique<binlog::event::FormatDescriptionEvent>(reader, fde.get());
-      break;
+    case binlog::event::LogEventType::GTID_LOG_EVENT:
+    case binlog::event::LogEventType::ANONYMOUS_GTID_LOG_EVENT:
     case binlog::event::LogEventType::ROTATE_EVENT:
-      ev = std::make_unique<binlog::event::RotateEvent>(reader, fde.get());
-      break;
-    case binlog::event::LogEventType::TABLE_MAP_EVENT:
-      ev = std::make_unique<binlog::event::TableMapEvent>(reader, fde.get());
-      break;
-    case binlog::event::LogEventType::UPDATE_ROWS_EVENT_V1:
-      ev = std::make_unique<binlog::event::UpdateRowsEvent>(reader, fde.get());
-      break;
-    case binlog::event::LogEventType::DELETE_ROWS_EVENT_V1:
-      ev = std::make_unique<binlog::event::DeleteRowsEvent>(reader, fde.get());
-      break;
-    case binlog::event::LogEventType::WRITE_ROWS_EVENT_V1:
-      ev = std::make_unique<binlog::event::WriteRowsEvent>(reader, fde.get());
+    case binlog::event::LogEventType::FORMAT_DESCRIPTION_EVENT:
+      skipping = false;
       break;
+    default:
+      return ev;
+    }
+  }
+
+  switch (event_type) {
+  case binlog::event::LogEventType::FORMAT_DESCRIPTION_EVENT:
+    // The events of the file up to the next one are described by it.
+    fde = binlog::event::FormatDescriptionEvent(reader, &fde);
+    ev = std::make_unique<binlog::event::FormatDescriptionEvent>(fde);
+    break;
+  case binlog::event::LogEventType::ROTATE_EVENT:
+    ev = std::make_unique<binlog::event::RotateEvent>(reader, &fde);
+    break;
+  case binlog::event::LogEventType::TABLE_MAP_EVENT:
+    ev = std::make_unique<binlog::event::TableMapEvent>(reader, &fde);
+    break;
+  case binlog::event::LogEventType::UPDATE_ROWS_EVENT_V1:
+    ev = std::make_unique<binlog::event::UpdateRowsEvent>(reader, &fde, owner);
+    break;
+  case binlog::event::LogEventType::DELETE_ROWS_EVENT_V1:
+    ev = std::make_unique<binlog::event::DeleteRowsEvent>(reader, &fde, owner);
+    break;
+  case binlog::event::LogEventType::WRITE_ROWS_EVENT_V1:
+    ev = std::make_unique<binlog::event::WriteRowsEvent>(reader, &fde, owner);
+    break;
+  case binlog::event::LogEventType::XID_EVENT:
+    ev = std::make_unique<binlog::event::XidEvent>(reader, &fde);
+    break;
+  case binlog::event::LogEventType::QUERY_EVENT:
+    ev = std::make_unique<binlog::event::QueryEvent>(reader, &fde);
+    break;
+  case binlog::event::LogEventType::ANONYMOUS_GTID_LOG_EVENT:
+    ev = std::make_unique<binlog::event::GtidEvent>(reader, &fde);
+    break;
+  case binlog::event::LogEventType::GTID_LOG_EVENT: {
+    auto gtid_event = std::make_unique<binlog::event::GtidEvent>(reader, &fde);
+    skipping = applied.contains(
+        gtid_event->tsid_parent_struct.m_uuid, gtid_event->gtid_info_struct.rpl_gtid_gno
+    );
+    if (!skipping) {
+      ev = std::move(gtid_event);
     }
+    break;
+  }
+  case binlog::event::LogEventType::PREVIOUS_GTIDS_LOG_EVENT:
+    ev = std::make_unique<binlog::event::PreviousGtidEvent>(reader, &fde);
+    break;
   }
 
   return ev;
 }
 
-TableDiffSource::TableDiffSource(
-    EventSourceI::UPtr event_source, DataHandler table_diff_handler
+EventSource::EventSource(
+    BufferSourceI::UPtr buffer_source, DataHandler data_handler, binlog::GtidSet applied
 ) :
-    TableDiffSourceI(table_diff_handler),
-    event_source(std::move(event_source))
+    EventSourceI(data_handler),
+    buffer_source(std::move(buffer_source)),
+    parser(std::move(applied))
 {}
 
-std::optional<TableDiff> TableDiffSource::getDataImpl()
+bool EventSource::ready() const
+{
+  return buffer_source->ready();
+}
+
+std::optional<Binlog> EventSource::getDataImpl()
+{
+  Binlog ev;
+
+  while (!ev) {
+    const auto data = buffer_source->getData();
+    if (!data) {
+      return std::nullopt;
+    }
+    ev = parser.parse(data.value());
+  }
+
+  return ev;
+}
+
+void EventSource::getBatchImpl(std::vector<Binlog>& out, size_t max_items)
+{
+  const auto begin = out.size();
+
+  while (out.size() == begin) {
+    buffers.clear();
+    if (buffer_source->getBatch(buffers, max_items) == 0) {
+      return;
+    }
+
+    // Non-owning buffers are valid until the next fetch, so all of them are parsed here.
+    for (const auto& buffer : buffers) {
+      if (auto ev = parser.parse(buffer)) {
+        out.push_back(std::move(ev));
+      }
+    }
+  }
+}
+
+TableDiffAssembler::TableDiffAssembler(binlog::GtidSet executed)
+{
+  if (!executed.empty()) {
+    this->executed = std::move(executed);
+  }
+}
+
+std::optional<TableDiff> TableDiffAssembler::process(Binlog&& event)
 {
   using namespace binlog;
-  auto event_package = getEventPackage();
+  event::RowsEvent* rows_event;
+
+  switch (event->header.type_code) {
+  case event::LogEventType::ROTATE_EVENT:
+    binlog_file = static_cast<const event::RotateEvent&>(*event).new_log_ident;
+    return std::nullopt;
+  case event::LogEventType::PREVIOUS_GTIDS_LOG_EVENT: {
+    const auto& buf = static_cast<const event::PreviousGtidEvent&>(*event).buf;
+    utils::StringBufferReader reader(buf);
+    auto previous = GtidSet::decode(reader);
+
+    if (executed) {
+      executed->merge(previous);
+    } else {
+      executed = std::move(previous);
+    }
+    return std::nullopt;
+  }
+  case event::LogEventType::GTID_LOG_EVENT:
+  case event::LogEventType::ANONYMOUS_GTID_LOG_EVENT: {
+    const auto& gtid_event = static_cast<const event::GtidEvent&>(*event);
+    const std::pair gtid(
+        gtid_event.tsid_parent_struct.m_uuid, gtid_event.gtid_info_struct.rpl_gtid_gno
+    );
+    std::optional<TableDiff> diff;
+
+    // The stream restarts inside the transaction, e.g. after a reconnect, and sends it
+    // again from its start.
+    if (event->header.type_code == event::LogEventType::GTID_LOG_EVENT &&
+        current_gtid == gtid)
+    {
+      const bool rolled_back = std::exchange(has_rows, false);
+      return rolled_back ? std::optional(TableDiff{.type = TableDiff::ROLLBACK})
+                         : std::nullopt;
+    }
+
+    // Rows of a transaction without a commit event end before the next transaction.
+    if (has_rows) {
+      diff = commit(event->header.log_pos - event->header.data_written);
+    } else {
+      finishTransaction();
+    }
+
+    if (event->header.type_code == event::LogEventType::GTID_LOG_EVENT) {
+      current_gtid = gtid;
+    }
+    // Sequence numbers start from 1, servers before 5.7 write none.
+    if (gtid_event.sequence_number != 0) {
+      current_clock = LogicalClock{gtid_event.last_committed, gtid_event.sequence_number};
+    }
+    return diff;
+  }
+  case event::LogEventType::QUERY_EVENT: {
+    const auto& query = static_cast<const event::QueryEvent&>(*event).query;
 
-  if (!event_package.first || !event_package.second) {
+    // Transactions of non-transactional tables end with `COMMIT` instead of an XID.
+    if (query == "COMMIT") {
+      return commit(event->header.log_pos);
+    }
+    if (query == "BEGIN" && has_rows) {
+      return commit(event->header.log_pos - event->header.data_written);
+    }
+    return std::nullopt;
+  }
+  case event::LogEventType::XID_EVENT:
+    return commit(event->header.log_pos);
+  case event::LogEventType::TABLE_MAP_EVENT:
+    submitTableInfo(static_cast<const event::TableMapEvent&>(*event));
+    return std::nullopt;
+  case event::LogEventType::WRITE_ROWS_EVENT_V1:
+  case event::LogEventType::UPDATE_ROWS_EVENT_V1:
+  case event::LogEventType::DELETE_ROWS_EVENT_V1:
+    rows_event = static_cast<event::RowsEvent*>(event.get());
+    break;
+  default:
     return std::nullopt;
   }
 
-  auto& table_map_event = event_package.first;
-  auto& rows_event = event_package.second;
+  const auto* schema = findTableInfo(rows_event->m_table_id);
+
+  if (!schema) {
+    THROW(
+        TableDiffSourceError, fmt::format(
+                                  "Expected existance info for table with id({}) "
+                                  "before submiting rows event.",
+                                  rows_event->m_table_id
+                              )
+    );
+  }
 
-  assert(table_map_event->m_table_id == rows_event->m_table_id);
   auto row_type = rows_event->m_type;
   TableDiff::Type type;
 
@@ -262,103 +512,69 @@ std::optional<TableDiff> TableDiffSource::getDataImpl()
     break;
   }
 
+  has_rows = true;
+
   return TableDiff{
       .type = type,
-      .collection_name = std::move(table_map_event->m_dbnam),
-      .table_name = std::move(table_map_event->m_tblnam),
-      .column_types = std::move(table_map_event->m_coltype),
-      .column_metatypes = std::move(table_map_event->m_field_metadata),
-      .column_name_list = table_map_event->getColumnName(),
-      .column_primary_key_list = table_map_event->getSimplePrimaryKey(),
-      .column_signedness = table_map_event->getSignedness(),
+      .schema = *schema,
       .row = std::move(rows_event->row),
-      .width = table_map_event->column_count
+      .columns_before_image = std::move(rows_event->columns_before_image),
+      .columns_after_image = std::move(rows_event->columns_after_image)
   };
 }
 
-TableDiffSource::EventPackage TableDiffSource::getEventPackage()
+std::optional<TableDiff> TableDiffAssembler::finish()
 {
-  using namespace binlog;
-  event::TableMapEvent::UPtr table_map_event;
-  event::RowsEvent::UPtr rows_event;
-  // Loop until we got a pair of TableMapEvent and struct derived from RowsEvent
-  while (true) {
-    auto data = event_source->getData();
-    if (!data) {
-      return {nullptr, nullptr};
-    }
-
-    auto& data_binlog_uptr = data.value();
-    switch (data_binlog_uptr->header.type_code) {
-    case event::LogEventType::TABLE_MAP_EVENT: {
-      table_map_event = std::unique_ptr<event::TableMapEvent>(
-          static_cast<event::TableMapEvent*>(data_binlog_uptr.release())
-      );
-
-      submitTableInfo(std::move(table_map_event));
+  if (!has_rows) {
+    return std::nullopt;
+  }
 
-      break;
-    }
-    case event::LogEventType::WRITE_ROWS_EVENT_V1:
-    case event::LogEventType::UPDATE_ROWS_EVENT_V1:
-    case event::LogEventType::DELETE_ROWS_EVENT_V1: {
-      switch (data_binlog_uptr->header.type_code) {
-      case event::LogEventType::WRITE_ROWS_EVENT_V1:
-        rows_event = std::unique_ptr<event::WriteRowsEvent>(
-            static_cast<event::WriteRowsEvent*>(data_binlog_uptr.release())
-        );
-        break;
-      case event::LogEventType::UPDATE_ROWS_EVENT_V1:
-        rows_event = std::unique_ptr<event::UpdateRowsEvent>(
-            static_cast<event::UpdateRowsEvent*>(data_binlog_uptr.release())
-        );
-        break;
-      case event::LogEventType::DELETE_ROWS_EVENT_V1:
-        rows_event = std::unique_ptr<event::DeleteRowsEvent>(
-            static_cast<event::DeleteRowsEvent*>(data_binlog_uptr.release())
-        );
-        break;
-      }
-      break;
-    }
-    }
+  // The transaction isn't executed, a restart reads it again from the checkpoint.
+  LOG_WARNING() << "The stream ends inside a transaction, its rows are dropped";
+  current_gtid.reset();
+  current_clock.reset();
+  has_rows = false;
+  return TableDiff{.type = TableDiff::ROLLBACK};
+}
 
-    if (rows_event) {
-      if (!(table_map_event = extractTableInfo(rows_event->m_table_id))) {
-        THROW(
-            TableDiffSourceError, fmt::format(
-                                      "Expected existance info for table with id({}) "
-                                      "before submiting rows event.",
-                                      rows_event->m_table_id
-                                  )
-        );
-      }
-      // Got all info. Can convert to TableDiff
-      break;
-    }
-  }
-  return {std::move(table_map_event), std::move(rows_event)};
+TableDiff TableDiffAssembler::commit(uint64_t position)
+{
+  auto clock = current_clock;
+  finishTransaction();
+  return TableDiff{
+      .type = TableDiff::COMMIT,
+      .position =
+          BinlogPosition{binlog_file, position, executed ? executed->toString() : ""},
+      .clock = clock
+  };
 }
 
-void TableDiffSource::submitTableInfo(TablePtr&& tm_event)
+void TableDiffAssembler::finishTransaction()
 {
-  if (!tm_event) {
-    return;
+  if (current_gtid && executed) {
+    executed->add(current_gtid->first, current_gtid->second);
   }
+  current_gtid.reset();
+  current_clock.reset();
+  has_rows = false;
+}
 
-  const auto& table_id = tm_event->m_table_id;
-
-  auto it = table_info_map.find(table_id);
-
-  if (it == table_info_map.end()) {
-    table_info_map.emplace(table_id, std::move(tm_event));
-    return;
+void TableDiffAssembler::submitTableInfo(const binlog::event::TableMapEvent& tm_event)
+{
+  auto schema = schemas.intern(tm_event);
+
+  // A table gets a new id when it is opened again, e.g. after it is altered, and the old
+  // id is not used for it anymore.
+  if (table_info_map.insert_or_assign(tm_event.m_table_id, schema).second) {
+    std::erase_if(table_info_map, [&](const auto& entry) {
+      return entry.first != tm_event.m_table_id &&
+             entry.second->table_name == schema->table_name &&
+             entry.second->collection_name == schema->collection_name;
+    });
   }
-
-  it->second = std::move(tm_event);
 }
 
-TableDiffSource::TablePtr TableDiffSource::extractTableInfo(const uint64_t table_id)
+const TableSchema::SPtr* TableDiffAssembler::findTableInfo(const uint64_t table_id) const
 {
   auto it = table_info_map.find(table_id);
 
@@ -366,414 +582,861 @@ TableDiffSource::TablePtr TableDiffSource::extractTableInfo(const uint64_t table
     return nullptr;
   }
 
-  return TablePtr(it->second.release());
+  return &it->second;
 }
 
-const std::string OtterBrixDiffSink::PK_FIELD_NAME = "_id";
-const std::string OtterBrixDiffSink::PK_JSON_POINTER = std::string{"/"} + PK_FIELD_NAME;
-
-OtterBrixDiffSink::OtterBrixDiffSink(
-    OtterBrixConsumerI::UPtr otterbrix_consumer, std::pmr::memory_resource* resource
+TableDiffSource::TableDiffSource(
+    EventSourceI::UPtr event_source, DataHandler table_diff_handler,
+    binlog::GtidSet executed
 ) :
-    otterbrix_consumer(std::move(otterbrix_consumer)),
-    resource(resource)
+    TableDiffSourceI(table_diff_handler),
+    event_source(std::move(event_source)),
+    assembler(std::move(executed))
 {}
 
-void OtterBrixDiffSink::putDataImpl(const TableDiff& data)
+bool TableDiffSource::ready() const
 {
-  node_ptr result;
+  return event_source->ready();
+}
 
-  switch (data.type) {
-  case TableDiff::INSERT:
-    sendNodesInsert(data);
-    break;
-  case TableDiff::DELETE:
-    sendNodesDelete(data);
-    break;
-  case TableDiff::UPDATE:
-    sendNodesUpdate(data);
-    break;
+std::optional<TableDiff> TableDiffSource::getDataImpl()
+{
+  while (true) {
+    auto data = event_source->getData();
+    if (!data) {
+      return assembler.finish();
+    }
+
+    if (auto diff = assembler.process(std::move(data.value()))) {
+      return diff;
+    }
   }
 }
 
-OtterBrixDiffSink::ReadContext::ReadContext(const TableDiff& data) :
-    column_metatype_r(
-        reinterpret_cast<const char*>(data.column_metatypes.data()),
-        data.column_metatypes.size()
-    ),
-    column_type_r(
-        reinterpret_cast<const char*>(data.column_types.data()), data.column_types.size()
-    ),
-    row_r(reinterpret_cast<const char*>(data.row.data()), data.row.size()),
-    signedness_r(
-        std::string_view(data.column_signedness.data(), data.column_signedness.size())
-    ),
-    data(data)
-{}
-
-void OtterBrixDiffSink::sendNodesInsert(const TableDiff& data)
+void TableDiffSource::getBatchImpl(std::vector<TableDiff>& out, size_t max_items)
 {
-  using namespace components::logical_plan;
-
-  std::pmr::vector<components::document::document_ptr> docs;
-  collection_full_name_t collection(data.collection_name, data.table_name);
+  size_t produced = 0;
 
-  ReadContext context(data);
+  while (produced < max_items) {
+    if (produced != 0 && !event_source->ready()) {
+      break;
+    }
 
-  docs.reserve(16);
+    // Every event gives at most one diff, so the batch can't overflow.
+    events.clear();
+    if (event_source->getBatch(events, max_items - produced) == 0) {
+      if (auto diff = assembler.finish()) {
+        out.push_back(std::move(diff.value()));
+      }
+      break;
+    }
 
-  while (context.row_r.available()) {
-    docs.emplace_back() = getDocument(context);
+    for (auto& event : events) {
+      if (auto diff = assembler.process(std::move(event))) {
+        out.push_back(std::move(diff.value()));
+        ++produced;
+      }
+    }
   }
-
-  otterbrix_consumer->putData(ExtendedNode{
-      .node = make_node_insert(resource, collection, std::move(docs)),
-      .parameter = nullptr
-  });
 }
 
-void OtterBrixDiffSink::sendNodesDelete(const TableDiff& data)
+std::optional<TransactionBatch> TransactionAssembler::process(TableDiff&& diff)
 {
-  using namespace components::logical_plan;
-  using namespace components::expressions;
-  using namespace components::document;
-  using param_t = core::parameter_id_t;
+  if (diff.type == TableDiff::ROLLBACK) {
+    diffs.clear();
+    return std::nullopt;
+  }
 
-  collection_full_name_t collection(data.collection_name, data.table_name);
+  const bool commit = diff.type == TableDiff::COMMIT;
+  diffs.push_back(std::move(diff));
 
-  ReadContext context(data);
+  if (!commit) {
+    return std::nullopt;
+  }
 
-  while (context.row_r.available()) {
-    auto doc = getDocument(context);
+  return TransactionBatch{std::exchange(diffs, {})};
+}
+
+TransactionSource::TransactionSource(
+    TableDiffSourceI::UPtr table_diff_source, DataHandler transaction_handler
+) :
+    TransactionSourceI(transaction_handler),
+    table_diff_source(std::move(table_diff_source))
+{}
 
-    auto selection_params = getSelectionParameters(doc, context);
+bool TransactionSource::ready() const
+{
+  return table_diff_source->ready();
+}
 
-    auto& expr = selection_params.first;
-    auto& params = selection_params.second;
+std::optional<TransactionBatch> TransactionSource::getDataImpl()
+{
+  while (true) {
+    auto diff = table_diff_source->getData();
+    if (!diff) {
+      return std::nullopt;
+    }
 
-    otterbrix_consumer->putData(ExtendedNode{
-        .node = make_node_delete_one(
-            resource, collection, make_node_match(resource, collection, std::move(expr))
-        ),
-        .parameter = std::move(params)
-    });
+    if (auto transaction = assembler.process(std::move(diff.value()))) {
+      return transaction;
+    }
   }
 }
 
-void OtterBrixDiffSink::sendNodesUpdate(const TableDiff& data)
+void TransactionSource::getBatchImpl(std::vector<TransactionBatch>& out, size_t max_items)
 {
-  using namespace components::logical_plan;
-  collection_full_name_t collection(data.collection_name, data.table_name);
-
-  ReadContext context(data);
+  size_t produced = 0;
 
-  while (context.row_r.available()) {
-    auto old_doc = getDocument(context);
-    auto new_doc = getDocument(context);
-    auto set_doc = components::document::make_document(resource);
+  while (produced < max_items) {
+    if (produced != 0 && !table_diff_source->ready()) {
+      break;
+    }
 
-    auto selection_params = getSelectionParameters(old_doc, context);
-    auto& expr = selection_params.first;
-    auto& params = selection_params.second;
+    // Every diff gives at most one transaction, so the batch can't overflow.
+    diffs.clear();
+    if (table_diff_source->getBatch(diffs, max_items - produced) == 0) {
+      break;
+    }
+
+    for (auto& diff : diffs) {
+      if (auto transaction = assembler.process(std::move(diff))) {
+        out.push_back(std::move(transaction.value()));
+        ++produced;
+      }
+    }
+  }
+}
 
-    new_doc->remove(PK_JSON_POINTER);
-    set_doc->set("$set", new_doc);
+OtterBrixDiffSink::OtterBrixDiffSink(
+    OtterBrixConsumerI::UPtr otterbrix_consumer, std::pmr::memory_resource* resource,
+    PlanBatchOptions batch_options
+) :
+    otterbrix_consumer(std::move(otterbrix_consumer)),
+    builder(resource, batch_options)
+{}
 
-    otterbrix_consumer->putData(ExtendedNode{
-        .node = make_node_update_one(
-            resource, collection, make_node_match(resource, collection, std::move(expr)),
-            std::move(set_doc)
+void OtterBrixDiffSink::putDataImpl(const TransactionBatch& data)
+{
+  putBatchImpl({&data, 1});
+}
+
+void OtterBrixDiffSink::putBatchImpl(std::span<const TransactionBatch> batch)
+{
+  for (const auto& data : batch) {
+    for (const auto& diff : data.diffs) {
+      builder.convert(diff, nodes);
+    }
+  }
+  // Rows are coalesced across the transactions of one batch, so every batch ends with the
+  // marker of its last transaction.
+  builder.flushPending(nodes);
+  submitNodes();
+}
+
+void OtterBrixDiffSink::flushImpl()
+{
+  otterbrix_consumer->flush();
+}
+
+void OtterBrixDiffSink::idleImpl()
+{
+  otterbrix_consumer->idle();
+}
+
+void OtterBrixDiffSink::submitNodes()
+{
+  if (nodes.empty()) {
+    return;
+  }
+
+  otterbrix_consumer->putBatch(nodes);
+  nodes.clear();
+}
+
+PlanBuilder::PlanBuilder(
+    std::pmr::memory_resource* resource, PlanBatchOptions batch_options
+) :
+    resource(resource),
+    batch_options(batch_options)
+{}
+
+void PlanBuilder::convert(const TableDiff& data, std::vector<ExtendedNode>& nodes)
+{
+  if (data.type == TableDiff::COMMIT) {
+    // Commits in a row are covered by the last one with a position.
+    if (data.position) {
+      pending_checkpoint = data.position;
+    }
+    flushCheckpoint(nodes);
+    return;
+  }
+
+  // Rows of the collection are flushed whatever their partition is.
+  for (auto& pending : pending_rows) {
+    if (pending.type != data.type && isCollectionOf(pending, data)) {
+      flushRows(pending, nodes);
+    }
+  }
+
+  switch (data.type) {
+  case TableDiff::INSERT:
+  case TableDiff::DELETE:
+    appendRows(data, nodes);
+    break;
+  case TableDiff::UPDATE:
+    sendNodesUpdate(data, nodes);
+    break;
+  case TableDiff::COMMIT:
+  case TableDiff::ROLLBACK:
+    break;
+  }
+}
+
+PlanBuilder::ReadContext::ReadContext(const TableDiff& data) :
+    row_r(data.row.data(), data.row.size()),
+    data(data),
+    decoder(data.schema->decoder())
+{}
+
+void PlanBuilder::flushPending(std::vector<ExtendedNode>& nodes)
+{
+  for (auto& pending : pending_rows) {
+    flushRows(pending, nodes);
+  }
+  flushCheckpoint(nodes);
+}
+
+void PlanBuilder::deleteInserted(
+    const ExtendedNode& insert, std::vector<ExtendedNode>& nodes
+)
+{
+  using namespace components::logical_plan;
+
+  collection_full_name_t collection(
+      insert.node->database_name(), insert.node->collection_name()
+  );
+
+  // Keys of an insert are sorted and unique.
+  for (size_t begin = 0; begin < insert.keys.size(); begin += MAX_DELETE_KEYS) {
+    const auto end = std::min(begin + MAX_DELETE_KEYS, insert.keys.size());
+    std::vector<std::string> keys(insert.keys.begin() + begin, insert.keys.begin() + end);
+    auto [expr, params] = getSelectionParameters(keys);
+
+    nodes.push_back(ExtendedNode{
+        .node = make_node_delete_many(
+            resource, collection, make_node_match(resource, collection, std::move(expr))
         ),
-        .parameter = std::move(params)
+        .parameter = std::move(params),
+        .documents = {},
+        .keys = std::move(keys),
+        .partition = insert.partition
     });
   }
 }
 
-components::document::document_ptr OtterBrixDiffSink::getDocument(ReadContext& context)
+void PlanBuilder::flushCheckpoint(std::vector<ExtendedNode>& nodes)
 {
-  auto doc = components::document::make_document(resource);
-  const auto pk_index = getPrimaryKeyIndex(context);
+  if (!pending_checkpoint) {
+    return;
+  }
 
-  if (pk_index == -1) {
-    THROW(
-        OtterBrixDiffSinkError,
-        fmt::format(
-            "Table {}.{}. Primary key must be one and name == '{}'.",
-            context.data.collection_name, context.data.table_name, PK_FIELD_NAME
-        )
-    );
+  for (const auto& pending : pending_rows) {
+    if (!pending.rows.empty()) {
+      return;
+    }
   }
 
-  auto& json_pointer = context.cached_data.json_pointer;
-  auto& null_bitmap = context.cached_data.null_bitmap;
-  int null_bitmap_byte_size = (context.data.width + 7) / 8;
+  nodes.push_back(ExtendedNode{.checkpoint = std::move(pending_checkpoint)});
+  pending_checkpoint.reset();
+}
+
+bool PlanBuilder::isCollectionOf(const PendingRows& pending, const TableDiff& data)
+{
+  return pending.schema == data.schema ||
+         (pending.schema->table_name == data.schema->table_name &&
+          pending.schema->collection_name == data.schema->collection_name);
+}
 
-  context.column_type_r.restart();
-  context.column_metatype_r.restart();
-  context.signedness_r.restart();
+size_t PlanBuilder::partitionOf(const TableSchema& schema, std::string_view key) const
+{
+  if (batch_options.partitions <= 1) {
+    return 0;
+  }
 
-  toVectorBool(null_bitmap, std::string_view(context.row_r.ptr(), null_bitmap_byte_size));
-  context.row_r.skip(null_bitmap_byte_size);
+  const std::hash<std::string_view> hash;
+  const size_t table = hash(schema.collection_name) * 31 + hash(schema.table_name);
 
-  for (int i = 0; i < context.data.width; ++i) {
-    json_pointer = "/";
-    json_pointer += context.data.column_name_list[i];
-    if (i == pk_index) {
-      if (null_bitmap[i]) {
-        THROW(
-            OtterBrixDiffSinkError,
-            fmt::format(
-                "Table: {}.{}. Primary key '{}' must have value.",
-                context.data.table_name, context.data.collection_name,
-                context.data.column_name_list[pk_index]
-            )
-        );
-      }
-      using namespace binlog::event;
-      TableMapEvent::ColumnType type;
-      auto unsigned_ = context.signedness_r.read();
-      READ(type, context.column_type_r);
+  return (hash(key) ^ (table * 0x9e3779b97f4a7c15)) % batch_options.partitions;
+}
 
-      if (type != TableMapEvent::TYPE_LONGLONG || !unsigned_) {
-        THROW(
-            OtterBrixDiffSinkError,
-            fmt::format(
-                "Table: {}.{}. Type of primary key '{}' must have unsigned integral.",
-                context.data.table_name, context.data.collection_name,
-                context.data.column_name_list[pk_index]
-            )
-        );
+PlanBuilder::PendingRows& PlanBuilder::pendingFor(
+    const TableDiff& data, size_t partition, std::vector<ExtendedNode>& nodes
+)
+{
+  auto it = std::find_if(
+      pending_rows.begin(), pending_rows.end(),
+      [&](const PendingRows& pending) {
+        return pending.partition == partition && isCollectionOf(pending, data);
       }
-      uint64_t value = context.row_r.read<uint64_t>();
-      doc->set(json_pointer, gen_id(value, resource));
-    } else if (null_bitmap[i]) {
-      doc->set(json_pointer, nullptr);
+  );
+
+  if (it == pending_rows.end()) {
+    it = pending_rows.insert(
+        it, PendingRows{.type = data.type, .schema = data.schema, .partition = partition}
+    );
+  } else if (it->schema != data.schema) {
+    // The table has been altered, the plan must not mix both definitions.
+    flushRows(*it, nodes);
+    it->schema = data.schema;
+  }
+  it->type = data.type;
+
+  return *it;
+}
+
+void PlanBuilder::flushRows(PendingRows& pending, std::vector<ExtendedNode>& nodes)
+{
+  if (pending.rows.empty()) {
+    return;
+  }
+
+  // Zero-padded keys are ordered as the numbers they represent.
+  std::sort(pending.rows.begin(), pending.rows.end(), [](const auto& a, const auto& b) {
+    return a.first < b.first;
+  });
+
+  if (pending.type == TableDiff::INSERT) {
+    flushInsertRows(pending, nodes);
+  } else {
+    flushDeleteRows(pending, nodes);
+  }
+
+  // The entry is kept to reuse its buffer for the next rows of the collection.
+  pending.rows.clear();
+  pending.bytes = 0;
+}
+
+void PlanBuilder::flushInsertRows(PendingRows& pending, std::vector<ExtendedNode>& nodes)
+{
+  using namespace components::logical_plan;
+
+  std::pmr::vector<components::document::document_ptr> docs(resource);
+  std::vector<components::document::document_ptr> documents;
+  std::vector<std::string> keys;
+
+  docs.reserve(pending.rows.size());
+  documents.reserve(pending.rows.size());
+  keys.reserve(pending.rows.size());
+
+  for (auto& [key, doc] : pending.rows) {
+    docs.push_back(doc);
+    documents.push_back(std::move(doc));
+    keys.push_back(std::move(key));
+  }
+
+  collection_full_name_t collection(
+      pending.schema->collection_name, pending.schema->table_name
+  );
+
+  nodes.push_back(ExtendedNode{
+      .node = make_node_insert(resource, collection, std::move(docs)),
+      .parameter = nullptr,
+      .documents = std::move(documents),
+      .keys = std::move(keys),
+      .partition = pending.partition
+  });
+}
+
+void PlanBuilder::flushDeleteRows(PendingRows& pending, std::vector<ExtendedNode>& nodes)
+{
+  using namespace components::logical_plan;
+
+  std::vector<std::string> keys;
+
+  keys.reserve(pending.rows.size());
+
+  for (auto& [key, doc] : pending.rows) {
+    // A row may be deleted by several events only if it was inserted again between
+    // them, which flushes the run, but duplicates are harmless for the match anyway.
+    if (keys.empty() || keys.back() != key) {
+      keys.push_back(std::move(key));
+    }
+  }
+
+  collection_full_name_t collection(
+      pending.schema->collection_name, pending.schema->table_name
+  );
+  auto [expr, params] = getSelectionParameters(keys);
+
+  nodes.push_back(ExtendedNode{
+      .node = make_node_delete_many(
+          resource, collection, make_node_match(resource, collection, std::move(expr))
+      ),
+      .parameter = std::move(params),
+      .documents = {},
+      .keys = std::move(keys),
+      .partition = pending.partition
+  });
+}
+
+void PlanBuilder::appendRows(const TableDiff& data, std::vector<ExtendedNode>& nodes)
+{
+  const size_t max_rows = data.type == TableDiff::DELETE
+                              ? std::min(batch_options.max_documents, MAX_DELETE_KEYS)
+                              : batch_options.max_documents;
+
+  ReadContext context(data);
+
+  while (context.row_r.available()) {
+    const auto row_begin = context.row_r.available();
+    std::string key;
+    components::document::document_ptr doc;
+
+    if (data.type == TableDiff::DELETE) {
+      key = context.decoder.extractKey(context.row_r, data.columns_before_image);
     } else {
-      using namespace binlog::event;
-      TableMapEvent::ColumnType type;
-
-      READ(type, context.column_type_r);
-
-      switch (type) {
-      case TableMapEvent::TYPE_TINY: {
-        auto unsigned_ = context.signedness_r.read();
-
-        if (unsigned_) {
-          uint8_t value = context.row_r.read<uint8_t>();
-          doc->set<uint64_t>(json_pointer, value);
-        } else {
-          int8_t value = context.row_r.read<int8_t>();
-          doc->set<int64_t>(json_pointer, value);
-        }
-        break;
-      }
-      case TableMapEvent::TYPE_SHORT: {
-        auto unsigned_ = context.signedness_r.read();
-
-        if (unsigned_) {
-          uint16_t value = context.row_r.read<uint16_t>();
-          doc->set<uint64_t>(json_pointer, value);
-        } else {
-          int16_t value = context.row_r.read<int16_t>();
-          doc->set<int64_t>(json_pointer, value);
-        }
-        break;
-      }
-      case TableMapEvent::TYPE_INT24: {
-        auto unsigned_ = context.signedness_r.read();
-
-        if (unsigned_) {
-          uint32_t value = 0;
-          context.row_r.readCpy((char*)&value, 3);
-
-          doc->set<uint64_t>(json_pointer, value);
-        } else {
-          int32_t value;
-
-          if (context.row_r.peek<uint8_t>(2) & 128) {
-            value = (int32_t)-1 << 24;
-          } else {
-            value = 0;
-          }
-
-          context.row_r.readCpy((char*)&value, 3);
-          doc->set<int64_t>(json_pointer, value);
-        }
-        break;
-      }
-      case TableMapEvent::TYPE_LONG: {
-        auto unsigned_ = context.signedness_r.read();
-
-        if (unsigned_) {
-          uint32_t value = context.row_r.read<uint32_t>();
-          doc->set<uint64_t>(json_pointer, value);
-        } else {
-          int32_t value = context.row_r.read<int32_t>();
-          doc->set<int64_t>(json_pointer, value);
-        }
-        break;
-      }
-      case TableMapEvent::TYPE_LONGLONG: {
-        auto unsigned_ = context.signedness_r.read();
-
-        if (unsigned_) {
-          uint64_t value = context.row_r.read<uint64_t>();
-          doc->set<uint64_t>(json_pointer, value);
-        } else {
-          int64_t value = context.row_r.read<int64_t>();
-          doc->set<int64_t>(json_pointer, value);
-        }
-        break;
-      }
-      case TableMapEvent::TYPE_FLOAT:
-      case TableMapEvent::TYPE_DOUBLE: {
-        context.signedness_r.read();
-        uint8_t len = context.column_metatype_r.read<uint8_t>();
-
-        switch (len) {
-        case 4: {
-          float value = context.row_r.read<float>();
-          doc->set(json_pointer, value);
-          break;
-        }
-        case 8: {
-          double value = context.row_r.read<double>();
-          doc->set(json_pointer, value);
-          break;
-        }
-        }
-        break;
-      }
-      case TableMapEvent::TYPE_BOOL: {
-        context.signedness_r.read();
+      doc = getDocument(context);
+      key = std::string(doc->get_string(RowDecoder::PK_JSON_POINTER));
+    }
 
-        bool value = context.row_r.read<uint8_t>();
-        doc->set(json_pointer, value);
-        break;
-      }
-      case TableMapEvent::TYPE_VARCHAR: {
-        uint16_t max_length = context.column_metatype_r.read<uint16_t>();
-
-        uint16_t len = 0;
-        if (max_length <= 255) {
-          len = context.row_r.read<uint8_t>();
-        } else {
-          len = context.row_r.read<uint16_t>();
-        }
-        std::pmr::string str(resource);
-        str.resize(len, 0);
-        context.row_r.readCpy(str.data(), str.size());
-
-        doc->set(json_pointer, std::move(str));
-        break;
-      }
-      case TableMapEvent::TYPE_STRING: {
-        uint8_t real_type = context.column_metatype_r.read<uint8_t>();
-
-        if (real_type != TableMapEvent::TYPE_STRING) {
-          goto unexpected_type;
-        }
-        uint8_t& len = real_type;
-        len = context.column_metatype_r.read<uint8_t>() / 4;
-        std::pmr::string str(resource);
-        str.resize(len, ' ');
-        len = context.row_r.read<uint8_t>();
-        context.row_r.readCpy(str.data(), len);
-        doc->set(json_pointer, std::move(str));
-        break;
-      }
-      default: {
-      unexpected_type:
-        THROW(OtterBrixDiffSinkError, "Unknown type");
-      }
-      }
+    auto& pending = pendingFor(data, partitionOf(*data.schema, key), nodes);
+
+    pending.bytes += row_begin - context.row_r.available();
+    pending.rows.emplace_back(std::move(key), std::move(doc));
+
+    if (pending.rows.size() >= max_rows || pending.bytes >= batch_options.max_bytes) {
+      flushRows(pending, nodes);
     }
   }
-  return doc;
 }
 
-std::pair<compare_expression_ptr, parameter_node_ptr>
-OtterBrixDiffSink::getSelectionParameters(
-    const components::document::document_ptr& doc, ReadContext& context
+void PlanBuilder::sendNodesUpdate(
+    const TableDiff& data, std::vector<ExtendedNode>& nodes
 )
 {
-  using namespace components::expressions;
-  using param_t = core::parameter_id_t;
+  using namespace components::logical_plan;
+  collection_full_name_t collection(
+      data.schema->collection_name, data.schema->table_name
+  );
 
-  if (getPrimaryKeyIndex(context) == -1) {
-    THROW(
-        OtterBrixDiffSinkError,
-        fmt::format(
-            "Table {}.{}. Primary key must be one and name == '{}'.",
-            context.data.table_name, context.data.collection_name, PK_FIELD_NAME
-        )
+  ReadContext context(data);
+
+  while (context.row_r.available()) {
+    auto [key, changes] = context.decoder.decodeUpdate(
+        context.row_r, data.columns_before_image, data.columns_after_image, resource
     );
+
+    // ORMs often write rows back unchanged.
+    if (!changes) {
+      continue;
+    }
+
+    auto set_doc = components::document::make_document(resource);
+    const auto partition = partitionOf(*data.schema, key);
+    auto selection_params = getSelectionParameters(key);
+    auto& expr = selection_params.first;
+    auto& params = selection_params.second;
+
+    set_doc->set("$set", changes);
+
+    nodes.push_back(ExtendedNode{
+        .node = make_node_update_one(
+            resource, collection, make_node_match(resource, collection, std::move(expr)),
+            std::move(set_doc)
+        ),
+        .parameter = std::move(params),
+        .documents = {std::move(changes)},
+        .keys = {std::move(key)},
+        .partition = partition
+    });
   }
+}
 
-  auto expr = components::expressions::make_compare_expression(
-      resource, compare_type::eq, components::expressions::key_t{PK_FIELD_NAME},
-      core::parameter_id_t{1}
+components::document::document_ptr PlanBuilder::getDocument(ReadContext& context)
+{
+  return context.decoder.decode(
+      context.row_r, resource, context.data.columns_after_image
   );
-  auto params = components::logical_plan::make_parameter_node(resource);
+}
 
-  const auto logic_type = doc->type_by_key(PK_JSON_POINTER);
+std::pair<compare_expression_ptr, parameter_node_ptr>
+PlanBuilder::getSelectionParameters(const std::string& key)
+{
+  using namespace components::expressions;
+  using param_t = core::parameter_id_t;
 
-  assert(logic_type == components::types::logical_type::STRING_LITERAL);
+  auto expr = components::expressions::make_compare_expression(
+      resource, compare_type::eq,
+      components::expressions::key_t{RowDecoder::PK_FIELD_NAME}, core::parameter_id_t{1}
+  );
+  auto params = components::logical_plan::make_parameter_node(resource);
 
-  params->add_parameter(param_t{1}, doc->get_string(PK_JSON_POINTER));
+  params->add_parameter(param_t{1}, key);
 
   return {std::move(expr), std::move(params)};
 }
 
-int OtterBrixDiffSink::getPrimaryKeyIndex(const ReadContext& context) noexcept
+std::pair<compare_expression_ptr, parameter_node_ptr>
+PlanBuilder::getSelectionParameters(const std::vector<std::string>& keys)
 {
-  const auto& pk_list = context.data.column_primary_key_list;
-  const auto& column_name_list = context.data.column_name_list;
+  using namespace components::expressions;
+  using param_t = core::parameter_id_t;
+
+  assert(!keys.empty() && keys.size() <= MAX_DELETE_KEYS);
+
+  if (keys.size() == 1) {
+    return getSelectionParameters(keys.front());
+  }
+
+  const auto key = components::expressions::key_t{RowDecoder::PK_FIELD_NAME};
+  auto params = components::logical_plan::make_parameter_node(resource);
+
+  const auto number = [](const std::string& key) {
+    uint64_t value = 0;
+    std::from_chars(key.data(), key.data() + key.size(), value);
+    return value;
+  };
+
+  // Keys are sorted and unique, so they are consecutive if the ends are `size - 1` apart.
+  if (number(keys.back()) - number(keys.front()) == keys.size() - 1) {
+    auto expr = make_compare_union_expression(resource, compare_type::union_and);
+
+    expr->append_child(
+        make_compare_expression(resource, compare_type::gte, key, param_t{1})
+    );
+    expr->append_child(
+        make_compare_expression(resource, compare_type::lte, key, param_t{2})
+    );
+    params->add_parameter(param_t{1}, keys.front());
+    params->add_parameter(param_t{2}, keys.back());
+
+    return {std::move(expr), std::move(params)};
+  }
+
+  auto expr = make_compare_union_expression(resource, compare_type::union_or);
+
+  for (size_t i = 0; i < keys.size(); ++i) {
+    const param_t id{static_cast<uint16_t>(i + 1)};
 
-  if (pk_list.size() != 1 || column_name_list[pk_list[0]] != PK_FIELD_NAME) {
-    return -1;
+    expr->append_child(make_compare_expression(resource, compare_type::eq, key, id));
+    params->add_parameter(id, keys[i]);
   }
 
-  return pk_list[0];
+  return {std::move(expr), std::move(params)};
 }
 
-OtterBrixConsumerSink::OtterBrixConsumerSink(DataHandler data_handler) :
-    OtterBrixConsumerI(data_handler)
+OtterBrixConsumerSink::OtterBrixConsumerSink(
+    DataHandler data_handler, VerificationOptions verification_options,
+    CheckpointStore::SPtr checkpoints, IndexOptions index_options
+) :
+    OtterBrixConsumerI(data_handler),
+    checkpoints(std::move(checkpoints)),
+    resumed(this->checkpoints && this->checkpoints->load().has_value()),
+    verification_options(resumed ? VerificationOptions{} : verification_options),
+    index_options(std::move(index_options))
 {
   const char* path = "/tmp/test_collection_sql/base";
   auto config = configuration::config::create_config(path);
   config.log.level = log_t::level::warn;
 
-  std::filesystem::remove_all(config.main_path);
+  if (resumed) {
+    if (verification_options.enabled) {
+      LOG_WARNING() << "Verification is disabled when resuming from a checkpoint";
+    }
+    last_applied = this->checkpoints->loadApplied();
+    if (!last_applied) {
+      LOG_WARNING() << "The last applied position is unknown, the rows of every insert "
+                       "are deleted before it";
+    }
+    replaying = true;
+  } else {
+    std::filesystem::remove_all(config.main_path);
+  }
   std::filesystem::create_directories(config.main_path);
 
   otterbrix_service = otterbrix::make_otterbrix(config);
 }
 
+OtterBrixConsumerSink::~OtterBrixConsumerSink()
+{
+  std::lock_guard lock(verification_mutex);
+
+  if (pending_verification.valid()) {
+    pending_verification.wait();
+  }
+}
+
 std::pmr::memory_resource* OtterBrixConsumerSink::resource() const noexcept
 {
   return otterbrix_service->dispatcher()->resource();
 }
 
+void OtterBrixConsumerSink::extendReplayWindow(size_t markers)
+{
+  std::lock_guard lock(state_mutex);
+  window_markers = std::max(window_markers, markers);
+}
+
+bool OtterBrixConsumerSink::verify()
+{
+  if (!verification_options.enabled) {
+    LOG_WARNING() << "Verification is requested, but digests are not maintained";
+    return true;
+  }
+
+  std::vector<std::pair<std::string, std::string>> collections;
+
+  {
+    std::lock_guard lock(catalog_mutex);
+
+    for (const auto& [database_name, database] : context_storage) {
+      for (const auto& collection_name : database) {
+        collections.emplace_back(database_name, collection_name);
+      }
+    }
+  }
+
+  bool result = true;
+
+  // Every scan matches the digests of its moment, transactions applied between the scans
+  // are seen by both the digests and the scans of the later collections.
+  for (const auto& [database_name, collection_name] : collections) {
+    pauseTransactions();
+
+    try {
+      result = checkDigest(database_name, collection_name) && result;
+    } catch (...) {
+      resumeTransactions();
+      throw;
+    }
+    resumeTransactions();
+  }
+
+  return result;
+}
+
+void OtterBrixConsumerSink::beginTransaction()
+{
+  std::unique_lock lock(transactions_mutex);
+
+  transactions_changed.wait(lock, [this]() {
+    return !transactions_paused;
+  });
+  ++open_transactions;
+}
+
+void OtterBrixConsumerSink::endTransaction()
+{
+  {
+    std::lock_guard lock(transactions_mutex);
+    --open_transactions;
+  }
+  transactions_changed.notify_all();
+}
+
+void OtterBrixConsumerSink::pauseTransactions()
+{
+  std::unique_lock lock(transactions_mutex);
+
+  // Only one verification runs at a time, see `verifyAsync()`, but `verify()` may be
+  // called besides it.
+  transactions_changed.wait(lock, [this]() {
+    return !transactions_paused;
+  });
+  transactions_paused = true;
+  transactions_changed.wait(lock, [this]() {
+    return open_transactions == 0;
+  });
+}
+
+void OtterBrixConsumerSink::resumeTransactions()
+{
+  {
+    std::lock_guard lock(transactions_mutex);
+    transactions_paused = false;
+  }
+  transactions_changed.notify_all();
+}
+
+std::shared_future<bool> OtterBrixConsumerSink::verifyAsync()
+{
+  using namespace std::chrono_literals;
+  std::lock_guard lock(verification_mutex);
+
+  if (!pending_verification.valid() ||
+      pending_verification.wait_for(0s) == std::future_status::ready)
+  {
+    pending_verification = std::async(std::launch::async, [this]() {
+                             return verify();
+                           }).share();
+  }
+
+  return pending_verification;
+}
+
 void OtterBrixConsumerSink::putDataImpl(const ExtendedNode& extended_node)
 {
+  consumeCommitted({&extended_node, 1});
+}
+
+void OtterBrixConsumerSink::putBatchImpl(std::span<const ExtendedNode> batch)
+{
+  consumeCommitted(batch);
+}
+
+void OtterBrixConsumerSink::flushImpl()
+{
+  // Streams without commits have no markers.
+  consume(uncommitted);
+  uncommitted.clear();
+
+  if (checkpoints) {
+    checkpoints->flush();
+  }
+}
+
+void OtterBrixConsumerSink::consume(std::span<const ExtendedNode> batch)
+{
+  OpenTransaction transaction(*this);
+
+  for (const auto& extended_node : batch) {
+    apply(extended_node, serial_session);
+  }
+}
+
+void OtterBrixConsumerSink::consumeCommitted(std::span<const ExtendedNode> batch)
+{
+  const auto last_marker =
+      std::find_if(batch.rbegin(), batch.rend(), [](const ExtendedNode& extended_node) {
+        return extended_node.checkpoint.has_value();
+      });
+  const auto committed = batch.first(batch.rend() - last_marker);
+
+  if (!committed.empty()) {
+    OpenTransaction transaction(*this);
+
+    for (const auto& extended_node : uncommitted) {
+      apply(extended_node, serial_session);
+    }
+    for (const auto& extended_node : committed) {
+      apply(extended_node, serial_session);
+    }
+    uncommitted.clear();
+  }
+
+  uncommitted.insert(uncommitted.end(), batch.begin() + committed.size(), batch.end());
+}
+
+void OtterBrixConsumerSink::consumeConcurrently(
+    std::span<const ExtendedNode> plans, const otterbrix::session_id_t& session
+)
+{
+  for (const auto& extended_node : plans) {
+    apply(extended_node, session);
+  }
+}
+
+void OtterBrixConsumerSink::apply(
+    const ExtendedNode& extended_node, const otterbrix::session_id_t& session
+)
+{
+  if (!extended_node.node) {
+    // Plans are executed synchronously, so all changes before the marker are applied.
+    // Streams without a rotate event, like file replays, have no file to resume from.
+    if (extended_node.checkpoint && !extended_node.checkpoint->file.empty() &&
+        checkpoints)
+    {
+      checkpoints->commit(extended_node.checkpoint.value());
+      passMarker(extended_node.checkpoint.value());
+    }
+    return;
+  }
+
   auto node = boost::const_pointer_cast<node_t>(extended_node.node);
   auto params = boost::const_pointer_cast<parameter_node_t>(extended_node.parameter);
 
-  processContextStorage(node);
-  assert(otterbrix_service->dispatcher() == otterbrix_service->dispatcher());
+  {
+    std::lock_guard lock(catalog_mutex);
+    processContextStorage(node, session);
+  }
 
-  auto res = otterbrix_service->dispatcher()->execute_plan(
-      otterbrix::session_id_t(), node, params
-  );
+  // The insert may have been applied before the restart, but no checkpoint covers it.
+  if (replaying.load(std::memory_order_acquire) &&
+      node->type() == components::logical_plan::node_type::insert_t)
+  {
+    std::vector<ExtendedNode> deletes;
+
+    PlanBuilder(resource()).deleteInserted(extended_node, deletes);
+    for (const auto& extended_delete : deletes) {
+      auto deleted = execute(
+          boost::const_pointer_cast<node_t>(extended_delete.node),
+          boost::const_pointer_cast<parameter_node_t>(extended_delete.parameter), session
+      );
+
+      if (!deleted->is_success()) {
+        THROW(
+            OtterBrixConsumerError,
+            fmt::format(
+                "Rows inserted into `{}`.`{}` before the restart are not deleted",
+                node->database_name(), node->collection_name()
+            )
+        );
+      }
+    }
+  }
+
+  auto res = execute(node, params, session);
   assert(res->is_success());
 
-  // #ifndef NDEBUG
-  selectStage();
-  // #endif
+  if (!verification_options.enabled) {
+    return;
+  }
+
+  std::lock_guard lock(state_mutex);
+
+  digests.apply(extended_node);
+
+  const auto sample_interval = verification_options.sample_interval;
+
+  if (sample_interval != 0 && ++applied_plans % sample_interval == 0) {
+    // The check waits for the open transactions, so it starts after this one.
+    verifyAsync();
+  }
 }
 
-void OtterBrixConsumerSink::processContextStorage(node_ptr node)
+void OtterBrixConsumerSink::passMarker(const BinlogPosition& position)
+{
+  if (!replaying.load(std::memory_order_acquire) || !last_applied) {
+    return;
+  }
+
+  std::lock_guard lock(state_mutex);
+
+  // The transactions up to the first marker after the position may have been applied.
+  if (!binlogPositionBefore(*last_applied, position) ||
+      ++markers_after_applied <= window_markers)
+  {
+    return;
+  }
+
+  LOG_INFO() << fmt::format(
+      "The stream passed {}:{} applied before the restart, inserts are not preceded by "
+      "deletes anymore",
+      last_applied->file, last_applied->position
+  );
+  replaying.store(false, std::memory_order_release);
+}
+
+components::cursor::cursor_t_ptr OtterBrixConsumerSink::execute(
+    node_ptr node, parameter_node_ptr params, const otterbrix::session_id_t& session
+)
+{
+  return otterbrix_service->dispatcher()->execute_plan(session, node, params);
+}
+
+void OtterBrixConsumerSink::processContextStorage(
+    node_ptr node, const otterbrix::session_id_t& session
+)
 {
   const auto& database_name = node->database_name();
   const auto& collection_name = node->collection_name();
@@ -781,9 +1444,7 @@ void OtterBrixConsumerSink::processContextStorage(node_ptr node)
   auto database_it = context_storage.find(database_name);
 
   if (database_it == context_storage.end()) {
-    otterbrix_service->dispatcher()->create_database(
-        otterbrix::session_id_t(), database_name
-    );
+    otterbrix_service->dispatcher()->create_database(session, database_name);
     database_it = context_storage.emplace(database_name, set_t<std::string>{}).first;
   }
 
@@ -791,32 +1452,111 @@ void OtterBrixConsumerSink::processContextStorage(node_ptr node)
   auto collection_it = collection_set.find(collection_name);
 
   if (collection_it == collection_set.end()) {
-    otterbrix_service->dispatcher()->create_collection(
-        otterbrix::session_id_t(), database_name, collection_name
+    auto created = otterbrix_service->dispatcher()->create_collection(
+        session, database_name, collection_name
     );
+    // Collections of the previous run keep their data and indexes.
+    const bool existing = created->is_error() &&
+                          created->get_error().type ==
+                              components::cursor::error_code_t::collection_already_exists;
+
+    createIndexes(database_name, collection_name, existing, session);
     collection_it = collection_set.emplace(collection_name).first;
   }
 }
 
-void OtterBrixConsumerSink::selectStage()
+void OtterBrixConsumerSink::createIndexes(
+    const std::string& database_name, const std::string& collection_name, bool existing,
+    const otterbrix::session_id_t& session
+)
 {
-  LOG_INFO() << "++++++++++++++++++++++++++++++++++++++++++++++++";
-  for (const auto& [database_name, database] : context_storage) {
-    for (const auto& collection_name : database) {
-      LOG_INFO() << fmt::format("Collection: `{}`.`{}`", database_name, collection_name);
-      auto curson_p = otterbrix_service->dispatcher()->execute_sql(
-          otterbrix::session_id_t(),
-          fmt::format("SELECT * FROM {}.{};", database_name, collection_name)
-      );
+  const components::logical_plan::collection_full_name_t collection(
+      database_name, collection_name
+  );
+  const auto full_name = fmt::format("{}.{}", database_name, collection_name);
 
-      while (curson_p->has_next()) {
-        auto data = curson_p->next();
-        LOG_INFO() << "    " << data->to_json();
-      }
+  if (index_options.primary_key) {
+    createIndex(collection, {RowDecoder::PK_FIELD_NAME}, existing, session);
+  }
 
-      LOG_INFO() << "+++++++++++++++++++++";
+  for (const auto& index : index_options.secondary) {
+    if (index.collection == full_name) {
+      createIndex(collection, index.fields, existing, session);
     }
   }
-  LOG_INFO() << "++++++++++++++++++++++++++++++++++++++++++++++++";
 }
-} // namespace cdc
\ No newline at end of file
+
+void OtterBrixConsumerSink::createIndex(
+    const components::logical_plan::collection_full_name_t& collection,
+    const std::vector<std::string>& fields, bool existing,
+    const otterbrix::session_id_t& session
+)
+{
+  using namespace components::logical_plan;
+  auto* resource = this->resource();
+  const auto name = fmt::format("{}_idx", fmt::join(fields, "_"));
+  auto node = make_node_create_index(
+      resource, collection, name,
+      fields.size() == 1 ? index_type::single : index_type::composite
+  );
+
+  for (const auto& field : fields) {
+    node->keys().push_back(components::expressions::key_t{field});
+  }
+
+  auto res = execute(node, make_parameter_node(resource), session);
+
+  if (res->is_success()) {
+    return;
+  }
+  // The index of an existing collection is created by the previous run.
+  if (existing &&
+      res->get_error().type == components::cursor::error_code_t::index_create_fail)
+  {
+    LOG_DEBUG() << fmt::format(
+        "Index `{}` of `{}`.`{}` exists", name, collection.database, collection.collection
+    );
+    return;
+  }
+  LOG_WARNING() << fmt::format(
+      "Index `{}` of `{}`.`{}` is not created", name, collection.database,
+      collection.collection
+  );
+}
+
+bool OtterBrixConsumerSink::checkDigest(
+    const std::string& database_name, const std::string& collection_name
+)
+{
+  const auto full_name = fmt::format("{}.{}", database_name, collection_name);
+  CollectionDigest actual;
+
+  auto cursor_p = otterbrix_service->dispatcher()->execute_sql(
+      otterbrix::session_id_t(), fmt::format("SELECT * FROM {};", full_name)
+  );
+
+  while (cursor_p->has_next()) {
+    auto data = cursor_p->next();
+    ++actual.rows;
+    actual.hash += DigestTracker::documentHash(data->to_json());
+  }
+
+  const auto expected = digests.digest(full_name);
+
+  if (expected != actual) {
+    LOG_ERROR() << fmt::format(
+        "Verification of `{}`.`{}` failed: expected {} rows ({:016x}), found {} "
+        "rows ({:016x})",
+        database_name, collection_name, expected.rows, expected.hash, actual.rows,
+        actual.hash
+    );
+    return false;
+  }
+
+  LOG_DEBUG() << fmt::format(
+      "Verification of `{}`.`{}` passed: {} rows", database_name, collection_name,
+      actual.rows
+  );
+  return true;
+}
+} // namespace cdc
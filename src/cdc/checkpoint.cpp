@@ -0,0 +1,200 @@
+#include <cdc/checkpoint.hpp>
+
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <filesystem>
+#include <fstream>
+#include <unistd.h>
+#include <utility>
+
+namespace cdc {
+
+namespace {
+
+/// @returns Name without its number and the number without leading zeros.
+std::pair<std::string_view, std::string_view> splitNumber(std::string_view name) noexcept
+{
+  const auto digits = std::find_if(name.rbegin(), name.rend(), [](unsigned char c) {
+    return !std::isdigit(c);
+  });
+  auto number = name.substr(name.size() - (digits - name.rbegin()));
+
+  name.remove_suffix(number.size());
+  number.remove_prefix(std::min(number.find_first_not_of('0'), number.size()));
+
+  return {name, number};
+}
+
+} // namespace
+
+bool binlogFileBefore(std::string_view lhs, std::string_view rhs) noexcept
+{
+  const auto [lhs_base, lhs_number] = splitNumber(lhs);
+  const auto [rhs_base, rhs_number] = splitNumber(rhs);
+
+  if (lhs_base != rhs_base) {
+    return lhs < rhs;
+  }
+  // Shorter numbers are smaller.
+  if (lhs_number.size() != rhs_number.size()) {
+    return lhs_number.size() < rhs_number.size();
+  }
+  if (lhs_number != rhs_number) {
+    return lhs_number < rhs_number;
+  }
+  return lhs < rhs;
+}
+
+bool binlogPositionBefore(const BinlogPosition& lhs, const BinlogPosition& rhs) noexcept
+{
+  if (lhs.file != rhs.file) {
+    return binlogFileBefore(lhs.file, rhs.file);
+  }
+  return lhs.position < rhs.position;
+}
+
+CheckpointStore::CheckpointStore(CheckpointOptions options) :
+    options(std::move(options))
+{}
+
+CheckpointStore::~CheckpointStore()
+{
+  try {
+    flush();
+  } catch (const CheckpointError& e) {
+    LOG_ERROR() << e.what();
+  }
+
+  if (applied_fd >= 0) {
+    ::close(applied_fd);
+  }
+}
+
+std::optional<BinlogPosition> CheckpointStore::load() const
+{
+  std::ifstream file(options.path);
+
+  if (!file.is_open()) {
+    return std::nullopt;
+  }
+
+  BinlogPosition position;
+
+  if (!std::getline(file, position.file) || !(file >> position.position) ||
+      position.file.empty())
+  {
+    THROW(CheckpointError, fmt::format("Checkpoint `{}` is corrupted", options.path));
+  }
+
+  // The GTID set is optional, checkpoints of servers without GTIDs have no such line.
+  file >> std::ws;
+  std::getline(file, position.gtid_set);
+
+  return position;
+}
+
+std::optional<BinlogPosition> CheckpointStore::loadApplied() const
+{
+  std::ifstream file(options.path + ".applied");
+  BinlogPosition position;
+
+  if (!file.is_open()) {
+    return std::nullopt;
+  }
+  if (!std::getline(file, position.file) || !(file >> position.position) ||
+      position.file.empty())
+  {
+    LOG_WARNING() << fmt::format(
+        "The applied position of checkpoint `{}` is damaged", options.path
+    );
+    return std::nullopt;
+  }
+
+  return position;
+}
+
+void CheckpointStore::commit(const BinlogPosition& position)
+{
+  std::lock_guard lock(mutex);
+
+  writeApplied(position);
+  committed = position;
+  dirty = true;
+
+  if (Clock::now() - last_write >= options.flush_interval) {
+    write();
+  }
+}
+
+void CheckpointStore::flush()
+{
+  std::lock_guard lock(mutex);
+
+  if (dirty) {
+    write();
+  }
+}
+
+void CheckpointStore::write()
+{
+  const auto tmp_path = options.path + ".tmp";
+  const auto& position = committed.value();
+  const auto content =
+      fmt::format("{}\n{}\n{}\n", position.file, position.position, position.gtid_set);
+
+  std::filesystem::create_directories(std::filesystem::path(options.path).parent_path());
+
+  // The content must be on disk before the rename makes it the checkpoint.
+  const int fd = ::open(tmp_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  const bool written = fd >= 0 &&
+                       ::write(fd, content.data(), content.size()) ==
+                           static_cast<ssize_t>(content.size()) &&
+                       ::fsync(fd) == 0;
+  const int error = errno;
+
+  if (fd >= 0) {
+    ::close(fd);
+  }
+
+  if (!written || std::rename(tmp_path.c_str(), options.path.c_str()) != 0) {
+    THROW(
+        CheckpointError, fmt::format(
+                             "Can't write checkpoint `{}`: {}", options.path,
+                             std::strerror(written ? errno : error)
+                         )
+    );
+  }
+
+  dirty = false;
+  last_write = Clock::now();
+}
+
+void CheckpointStore::writeApplied(const BinlogPosition& position)
+{
+  // Records of one size overwrite each other, a shorter one would leave a tail.
+  constexpr size_t RECORD_SIZE = 512;
+  const auto path = options.path + ".applied";
+  auto content = fmt::format("{}\n{}\n", position.file, position.position);
+
+  content.resize(std::max(content.size(), RECORD_SIZE), ' ');
+
+  if (applied_fd < 0) {
+    std::filesystem::create_directories(std::filesystem::path(path).parent_path());
+    applied_fd = ::open(path.c_str(), O_WRONLY | O_CREAT, 0644);
+  }
+
+  if (applied_fd < 0 || ::pwrite(applied_fd, content.data(), content.size(), 0) !=
+                            static_cast<ssize_t>(content.size()))
+  {
+    THROW(
+        CheckpointError,
+        fmt::format("Can't write applied position `{}`: {}", path, std::strerror(errno))
+    );
+  }
+}
+
+} // namespace cdc
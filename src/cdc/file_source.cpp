@@ -0,0 +1,339 @@
+#include <cdc/file_source.hpp>
+
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+
+namespace cdc {
+
+namespace {
+
+std::string fileName(const std::string& path)
+{
+  return std::filesystem::path(path).filename().string();
+}
+
+uint32_t loadUint32(const char* data) noexcept
+{
+  uint32_t value;
+  std::memcpy(&value, data, sizeof(value));
+  return value;
+}
+
+} // namespace
+
+Buffer makeRotateEvent(const std::string& file, uint64_t position, bool checksum)
+{
+  std::string event(
+      binlog::LOG_EVENT_HEADER_LEN + sizeof(position) + file.size() +
+          (checksum ? binlog::CHECKSUM_CRC32_SIGNATURE_LEN : 0),
+      '\0'
+  );
+  const auto event_size = static_cast<uint32_t>(event.size());
+
+  event[binlog::EVENT_TYPE_OFFSET] = static_cast<char>(binlog::event::ROTATE_EVENT);
+  std::memcpy(
+      event.data() + binlog::DATA_WRITTEN_OFFSET, &event_size, sizeof(event_size)
+  );
+  std::memcpy(event.data() + binlog::LOG_EVENT_HEADER_LEN, &position, sizeof(position));
+  std::memcpy(
+      event.data() + binlog::LOG_EVENT_HEADER_LEN + sizeof(position), file.data(),
+      file.size()
+  );
+
+  return Buffer::copy(event);
+}
+
+BinlogFileBufferSource::BinlogFileBufferSource(
+    std::vector<std::string> paths, std::optional<BinlogPosition> start_position
+) :
+    paths(std::move(paths)),
+    start_position(std::move(start_position))
+{
+  // Until a file is mapped the binlog continues at the start position.
+  if (this->start_position) {
+    replayed = *this->start_position;
+    next_file = startFile(this->paths, *this->start_position);
+  }
+}
+
+std::vector<std::string> BinlogFileBufferSource::discover(const std::string& path)
+{
+  namespace fs = std::filesystem;
+  std::vector<std::string> files;
+  const fs::path source(path);
+
+  if (fs::is_directory(source)) {
+    for (const auto& entry : fs::directory_iterator(source)) {
+      const auto extension = entry.path().extension().string();
+
+      // Binlog files are numbered, e.g. `mysql-bin.000001`, unlike the index file.
+      if (entry.is_regular_file() && extension.size() > 1 &&
+          std::all_of(extension.begin() + 1, extension.end(), [](unsigned char c) {
+            return std::isdigit(c);
+          }))
+      {
+        files.push_back(entry.path().string());
+      }
+    }
+    std::sort(files.begin(), files.end(), [](const auto& lhs, const auto& rhs) {
+      return binlogFileBefore(fileName(lhs), fileName(rhs));
+    });
+  } else if (source.extension() == ".index") {
+    std::ifstream index(path);
+
+    if (!index) {
+      THROW(BinlogFileError, fmt::format("Can't open `{}`", path));
+    }
+
+    // The server lists the files relative to its data directory, where the index is.
+    for (std::string line; std::getline(index, line);) {
+      if (!line.empty() && line.back() == '\r') {
+        line.pop_back();
+      }
+      if (line.empty()) {
+        continue;
+      }
+
+      const fs::path file(line);
+      files.push_back(
+          (file.is_absolute() ? file : source.parent_path() / file)
+              .lexically_normal()
+              .string()
+      );
+    }
+  } else {
+    files.push_back(path);
+  }
+
+  if (files.empty()) {
+    THROW(BinlogFileError, fmt::format("No binlog files in `{}`", path));
+  }
+
+  return files;
+}
+
+size_t BinlogFileBufferSource::startFile(
+    const std::vector<std::string>& paths, const BinlogPosition& position
+)
+{
+  for (size_t i = 0; i < paths.size(); ++i) {
+    const auto name = fileName(paths[i]);
+
+    if (name == position.file) {
+      return i;
+    }
+    // Starting at a later file would lose the events between.
+    if (binlogFileBefore(position.file, name)) {
+      THROW(
+          BinlogFileError,
+          fmt::format("`{}` of the start position isn't replayed", position.file)
+      );
+    }
+    LOG_DEBUG() << fmt::format("Skipping `{}` before the start position", paths[i]);
+  }
+
+  return paths.size();
+}
+
+std::optional<Buffer> BinlogFileBufferSource::getDataImpl()
+{
+  while (true) {
+    if (mapping) {
+      if (auto event = nextEvent()) {
+        return event;
+      }
+      finishFile();
+    }
+
+    if (next_file == paths.size()) {
+      return std::nullopt;
+    }
+    return openNext();
+  }
+}
+
+Buffer BinlogFileBufferSource::openNext()
+{
+  const auto& path = paths[next_file++];
+  const auto name = fileName(path);
+  uint64_t position = 4;
+
+  // The first mapped file is the one of the start position, see `startFile`.
+  if (start_position) {
+    if (name == start_position->file) {
+      position = start_position->position;
+    }
+    start_position.reset();
+  }
+
+  mapping = utils::MappedFile::open(path, true);
+  content = mapping->content();
+
+  // Files written by the server start with the magic number, dumped streams don't.
+  offset = 0;
+  if (content.size() >= sizeof(binlog::BINLOG_MAGIC) &&
+      loadUint32(content.data()) == binlog::BINLOG_MAGIC)
+  {
+    offset = sizeof(binlog::BINLOG_MAGIC);
+  }
+
+  if (position > content.size()) {
+    THROW(
+        BinlogFileError,
+        fmt::format("Start position {} is beyond the end of `{}`", position, path)
+    );
+  }
+  // The rotate event is parsed with the format of the previous file.
+  const bool checksum = fde.has_checksum;
+
+  resume_offset = position;
+  fde = {binlog::BINLOG_VERSION, binlog::SERVER_VERSION};
+  rotated_to.reset();
+  replayed = {name, position};
+
+  LOG_INFO() << fmt::format("Replaying `{}` from {}", path, position);
+
+  return makeRotateEvent(name, position, checksum);
+}
+
+std::optional<Buffer> BinlogFileBufferSource::nextEvent()
+{
+  const auto& path = paths[next_file - 1];
+  const auto available = content.size() - offset;
+  uint32_t event_size = 0;
+
+  if (available == 0) {
+    return std::nullopt;
+  }
+
+  if (available >= binlog::LOG_EVENT_HEADER_LEN) {
+    event_size = loadUint32(content.data() + offset + binlog::DATA_WRITTEN_OFFSET);
+
+    if (event_size < binlog::LOG_EVENT_HEADER_LEN) {
+      THROW(
+          BinlogFileError,
+          fmt::format(
+              "Invalid size {} of the event at {} of `{}`", event_size, offset, path
+          )
+      );
+    }
+  }
+
+  if (available < binlog::LOG_EVENT_HEADER_LEN || event_size > available) {
+    if (next_file != paths.size()) {
+      THROW(
+          BinlogFileError, fmt::format("`{}` ends inside an event at {}", path, offset)
+      );
+    }
+
+    // The server may be writing the event, the live stream continues before it.
+    LOG_WARNING() << fmt::format("`{}` ends inside an event at {}", path, offset);
+    offset = content.size();
+    return std::nullopt;
+  }
+
+  Buffer event(mapping, content.substr(offset, event_size));
+  offset += event_size;
+
+  // The format description event of the file is passed before resuming.
+  if (resume_offset > offset) {
+    offset = resume_offset;
+  }
+  resume_offset = 0;
+  replayed.position = offset;
+
+  const auto event_type = static_cast<uint8_t>(event.data()[binlog::EVENT_TYPE_OFFSET]);
+
+  if (event_type == binlog::event::FORMAT_DESCRIPTION_EVENT) {
+    utils::StringBufferReader reader(event.view());
+    binlog::event::FormatDescriptionEvent start(
+        binlog::BINLOG_VERSION, binlog::SERVER_VERSION
+    );
+
+    fde = binlog::event::FormatDescriptionEvent(reader, &start);
+  } else if (event_type == binlog::event::ROTATE_EVENT) {
+    utils::StringBufferReader reader(event.view());
+    binlog::event::RotateEvent rotate_event(reader, &fde);
+
+    rotated_to = BinlogPosition{std::move(rotate_event.new_log_ident), rotate_event.pos};
+  }
+
+  return event;
+}
+
+void BinlogFileBufferSource::finishFile()
+{
+  // Buffers still viewing the file keep it mapped.
+  mapping.reset();
+  content = {};
+
+  // Without the rotate event, e.g. after a stop event, the files are replayed in order.
+  if (!rotated_to) {
+    return;
+  }
+
+  const auto next =
+      std::find_if(paths.begin() + next_file, paths.end(), [this](const auto& path) {
+        return fileName(path) == rotated_to->file;
+      });
+
+  if (next == paths.end()) {
+    LOG_INFO() << fmt::format("The replayed files end before `{}`", rotated_to->file);
+  }
+  next_file = next - paths.begin();
+  replayed = std::move(*rotated_to);
+  rotated_to.reset();
+}
+
+CatchUpBufferSource::CatchUpBufferSource(
+    std::unique_ptr<BinlogFileBufferSource> replay, LiveFactory connect_live
+) :
+    replay(std::move(replay)),
+    connect_live(std::move(connect_live))
+{}
+
+bool CatchUpBufferSource::ready() const
+{
+  return replay || live->ready();
+}
+
+std::optional<Buffer> CatchUpBufferSource::getDataImpl()
+{
+  if (replay) {
+    if (auto buffer = replay->getData()) {
+      return buffer;
+    }
+    switchToLive();
+  }
+
+  return live->getData();
+}
+
+void CatchUpBufferSource::getBatchImpl(std::vector<Buffer>& out, size_t max_items)
+{
+  if (replay) {
+    if (replay->getBatch(out, max_items) != 0) {
+      return;
+    }
+    switchToLive();
+  }
+
+  live->getBatch(out, max_items);
+}
+
+void CatchUpBufferSource::switchToLive()
+{
+  const auto position = replay->position();
+
+  LOG_INFO() << fmt::format(
+      "Replay finished, streaming from {}:{}", position.file, position.position
+  );
+  // Buffers of the replayed files keep their mappings.
+  replay.reset();
+  live = connect_live(position);
+}
+
+} // namespace cdc
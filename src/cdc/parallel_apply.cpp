@@ -0,0 +1,361 @@
+#include <cdc/parallel_apply.hpp>
+
+#include <algorithm>
+#include <limits>
+#include <utility>
+
+namespace cdc {
+
+ParallelDiffSink::ParallelDiffSink(
+    std::unique_ptr<OtterBrixConsumerSink> otterbrix_consumer,
+    ParallelApplyOptions options, PlanBatchOptions batch_options
+) :
+    otterbrix_consumer(std::move(otterbrix_consumer)),
+    options(options),
+    batch_options(batch_options)
+{
+  const auto count = std::max<size_t>(options.workers, 1);
+
+  // Scheduled transactions may be applied ahead of the committed marker.
+  this->otterbrix_consumer->extendReplayWindow(options.max_scheduled);
+
+  for (size_t i = 0; i < count; ++i) {
+    workers.emplace_back([this]() {
+      work();
+    });
+  }
+}
+
+ParallelDiffSink::~ParallelDiffSink()
+{
+  {
+    std::lock_guard lock(mutex);
+    stopping = true;
+  }
+  task_added.notify_all();
+
+  for (auto& worker : workers) {
+    worker.join();
+  }
+}
+
+void ParallelDiffSink::putDataImpl(const TransactionBatch& data)
+{
+  schedule(data);
+}
+
+void ParallelDiffSink::putBatchImpl(std::span<const TransactionBatch> batch)
+{
+  for (const auto& data : batch) {
+    schedule(data);
+  }
+}
+
+void ParallelDiffSink::flushImpl()
+{
+  {
+    std::unique_lock lock(mutex);
+    applied.wait(lock, [this]() {
+      return error || scheduled.empty();
+    });
+    checkError();
+  }
+  otterbrix_consumer->flush();
+}
+
+void ParallelDiffSink::schedule(const TransactionBatch& transaction)
+{
+  const auto& commit = transaction.diffs.back();
+  const auto& clock = commit.clock;
+  // Numbers start from 1 in every binlog file.
+  const bool barrier = !clock || clock->sequence_number <= last_sequence_number;
+
+  std::unique_lock lock(mutex);
+
+  applied.wait(lock, [&]() {
+    if (error) {
+      return true;
+    }
+    if (scheduled.size() >= options.max_scheduled) {
+      return false;
+    }
+    // The first scheduled transaction is the oldest one not applied.
+    return scheduled.empty() ||
+           (!barrier && scheduled.front().sequence_number > clock->last_committed);
+  });
+  checkError();
+
+  // Transactions after one without the clock wait for it as well.
+  last_sequence_number =
+      clock ? clock->sequence_number : std::numeric_limits<int64_t>::max();
+
+  const auto ticket = first_ticket + scheduled.size();
+
+  scheduled.push_back(
+      {last_sequence_number, ExtendedNode{.checkpoint = commit.position}}
+  );
+  tasks.push_back({ticket, transaction});
+
+  lock.unlock();
+  task_added.notify_one();
+}
+
+void ParallelDiffSink::work()
+{
+  PlanBuilder builder(otterbrix_consumer->resource(), batch_options);
+  std::vector<ExtendedNode> nodes;
+  // Plans of the workers are executed concurrently in sessions of their own.
+  const otterbrix::session_id_t session{};
+
+  while (true) {
+    Task task;
+
+    {
+      std::unique_lock lock(mutex);
+      task_added.wait(lock, [this]() {
+        return stopping || !tasks.empty();
+      });
+
+      if (stopping) {
+        return;
+      }
+
+      task = std::move(tasks.front());
+      tasks.pop_front();
+    }
+
+    std::exception_ptr failure;
+
+    try {
+      // The marker of the commit is committed in order by `completeApplied`.
+      for (const auto& diff : task.transaction.diffs) {
+        if (diff.type != TableDiff::COMMIT) {
+          builder.convert(diff, nodes);
+        }
+      }
+      builder.flushPending(nodes);
+
+      OtterBrixConsumerSink::OpenTransaction transaction(*otterbrix_consumer);
+      otterbrix_consumer->consumeConcurrently(nodes, session);
+    } catch (...) {
+      failure = std::current_exception();
+    }
+    nodes.clear();
+
+    {
+      std::lock_guard lock(mutex);
+
+      if (failure && !error) {
+        error = failure;
+      }
+      scheduled[task.ticket - first_ticket].applied = true;
+
+      try {
+        completeApplied(session);
+      } catch (...) {
+        if (!error) {
+          error = std::current_exception();
+        }
+      }
+    }
+    applied.notify_all();
+  }
+}
+
+void ParallelDiffSink::completeApplied(const otterbrix::session_id_t& session)
+{
+  while (!scheduled.empty() && scheduled.front().applied) {
+    // Nothing after a failed transaction is committed, so it is applied again on restart.
+    if (!error) {
+      otterbrix_consumer->consumeConcurrently({&scheduled.front().marker, 1}, session);
+    }
+    scheduled.pop_front();
+    ++first_ticket;
+  }
+}
+
+void ParallelDiffSink::checkError() const
+{
+  if (error) {
+    std::rethrow_exception(error);
+  }
+}
+
+PartitionedConsumerSink::PartitionedConsumerSink(
+    std::unique_ptr<OtterBrixConsumerSink> otterbrix_consumer, size_t workers,
+    size_t queue_capacity
+) :
+    otterbrix_consumer(std::move(otterbrix_consumer))
+{
+  // A worker runs ahead of the slowest one by its queue at most.
+  this->otterbrix_consumer->extendReplayWindow(queue_capacity);
+
+  for (size_t i = 0; i < std::max<size_t>(workers, 1); ++i) {
+    auto& worker = *this->workers.emplace_back(std::make_unique<Worker>(queue_capacity));
+
+    worker.thread = std::thread([this, &worker]() {
+      run(worker);
+    });
+  }
+}
+
+PartitionedConsumerSink::~PartitionedConsumerSink()
+{
+  for (auto& worker : workers) {
+    worker->ring.push(Item{Item::STOP});
+    worker->thread.join();
+  }
+
+  if (transaction_open) {
+    otterbrix_consumer->endTransaction();
+  }
+}
+
+std::vector<PartitionStats> PartitionedConsumerSink::stats() const
+{
+  std::vector<PartitionStats> result;
+
+  result.reserve(workers.size());
+
+  for (const auto& worker : workers) {
+    const auto busy_ns = worker->busy_ns.load(std::memory_order_relaxed);
+
+    result.push_back(
+        {.queued = worker->ring.size(),
+         .applied = worker->applied.load(std::memory_order_relaxed),
+         .busy = std::chrono::nanoseconds(busy_ns)}
+    );
+  }
+
+  return result;
+}
+
+void PartitionedConsumerSink::putDataImpl(const ExtendedNode& extended_node)
+{
+  putBatchImpl({&extended_node, 1});
+}
+
+void PartitionedConsumerSink::putBatchImpl(std::span<const ExtendedNode> batch)
+{
+  rethrowError();
+
+  for (const auto& extended_node : batch) {
+    if (extended_node.node) {
+      // Verification waits for the transaction until the last worker reaches its marker.
+      if (!transaction_open) {
+        otterbrix_consumer->beginTransaction();
+        transaction_open = true;
+      }
+      workers[extended_node.partition % workers.size()]->ring.push(
+          Item{Item::PLAN, extended_node}
+      );
+      continue;
+    }
+
+    auto marker = std::make_shared<Marker>(
+        extended_node, workers.size(), std::exchange(transaction_open, false)
+    );
+
+    for (auto& worker : workers) {
+      worker->ring.push(Item{Item::MARKER, {}, marker});
+    }
+  }
+}
+
+void PartitionedConsumerSink::flushImpl()
+{
+  std::latch done(static_cast<std::ptrdiff_t>(workers.size()));
+
+  for (auto& worker : workers) {
+    worker->ring.push(Item{Item::FLUSH, {}, nullptr, &done});
+  }
+  done.wait();
+
+  // Streams without commits have no markers.
+  if (std::exchange(transaction_open, false)) {
+    otterbrix_consumer->endTransaction();
+  }
+  rethrowError();
+
+  otterbrix_consumer->flush();
+
+  const auto partitions = stats();
+
+  for (size_t i = 0; i < partitions.size(); ++i) {
+    const std::chrono::duration<double> busy = partitions[i].busy;
+
+    LOG_DEBUG() << fmt::format(
+        "Partition {}: {} plans in {:.3f} s", i, partitions[i].applied, busy.count()
+    );
+  }
+}
+
+template<typename Func>
+void PartitionedConsumerSink::guarded(Func&& func)
+{
+  if (failed.load(std::memory_order_acquire)) {
+    return;
+  }
+
+  try {
+    func();
+  } catch (...) {
+    std::lock_guard lock(error_mutex);
+
+    if (!error) {
+      error = std::current_exception();
+    }
+    failed.store(true, std::memory_order_release);
+  }
+}
+
+void PartitionedConsumerSink::run(Worker& worker)
+{
+  while (true) {
+    auto item = worker.ring.pop();
+
+    switch (item.command) {
+    case Item::PLAN: {
+      const auto start = std::chrono::steady_clock::now();
+
+      guarded([&]() {
+        otterbrix_consumer->consumeConcurrently({&item.plan, 1}, worker.session);
+      });
+      worker.busy_ns.fetch_add(
+          std::chrono::nanoseconds(std::chrono::steady_clock::now() - start).count(),
+          std::memory_order_relaxed
+      );
+      worker.applied.fetch_add(1, std::memory_order_relaxed);
+      break;
+    }
+    case Item::MARKER:
+      // Every worker passes the markers in order, so they are committed in order too.
+      if (item.marker->remaining.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+        guarded([&]() {
+          otterbrix_consumer->consumeConcurrently(
+              {&item.marker->node, 1}, worker.session
+          );
+        });
+        if (item.marker->ends_transaction) {
+          otterbrix_consumer->endTransaction();
+        }
+      }
+      break;
+    case Item::FLUSH:
+      item.done->count_down();
+      break;
+    case Item::STOP:
+      return;
+    }
+  }
+}
+
+void PartitionedConsumerSink::rethrowError()
+{
+  if (failed.load(std::memory_order_acquire)) {
+    std::lock_guard lock(error_mutex);
+    std::rethrow_exception(error);
+  }
+}
+
+} // namespace cdc
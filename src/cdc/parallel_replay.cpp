@@ -0,0 +1,402 @@
+#include <cdc/file_source.hpp>
+#include <cdc/parallel_replay.hpp>
+
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+
+#define PEEK(value, reader, ...) ((value) = (reader).peek<decltype(value)>(__VA_ARGS__))
+
+namespace cdc {
+
+namespace {
+
+/// @returns Owning buffer of a previous GTIDs event of the set.
+Buffer makePreviousGtidsEvent(const binlog::GtidSet& executed)
+{
+  std::string event(binlog::LOG_EVENT_HEADER_LEN + executed.encodedSize(), '\0');
+  const auto event_size = static_cast<uint32_t>(event.size());
+
+  event[binlog::EVENT_TYPE_OFFSET] =
+      static_cast<char>(binlog::event::PREVIOUS_GTIDS_LOG_EVENT);
+  std::memcpy(
+      event.data() + binlog::DATA_WRITTEN_OFFSET, &event_size, sizeof(event_size)
+  );
+  executed.encode(
+      reinterpret_cast<unsigned char*>(event.data() + binlog::LOG_EVENT_HEADER_LEN)
+  );
+
+  return Buffer::copy(event);
+}
+
+} // namespace
+
+ParallelReplaySource::ParallelReplaySource(
+    std::vector<std::string> paths, ParallelReplayOptions options,
+    std::optional<BinlogPosition> start_position, binlog::GtidSet applied
+) :
+    paths(std::move(paths)),
+    options(options),
+    applied(std::move(applied)),
+    start_position(std::move(start_position))
+{
+  if (!this->applied.empty()) {
+    executed = this->applied;
+  }
+  if (this->start_position) {
+    next_file = BinlogFileBufferSource::startFile(this->paths, *this->start_position);
+  }
+
+  for (size_t i = 0; i < std::max<size_t>(options.workers, 1); ++i) {
+    workers.emplace_back([this]() {
+      work();
+    });
+  }
+}
+
+ParallelReplaySource::~ParallelReplaySource()
+{
+  {
+    std::lock_guard lock(mutex);
+    stopping = true;
+  }
+  task_added.notify_all();
+
+  for (auto& worker : workers) {
+    worker.join();
+  }
+}
+
+std::optional<TransactionBatch> ParallelReplaySource::getDataImpl()
+{
+  while (!current || next_transaction == current->transactions.size()) {
+    schedule();
+
+    if (chunks.empty()) {
+      current.reset();
+      return std::nullopt;
+    }
+
+    current = std::move(chunks.front());
+    chunks.pop_front();
+    next_transaction = 0;
+
+    {
+      std::unique_lock lock(mutex);
+      chunk_done.wait(lock, [this]() {
+        return current->done;
+      });
+    }
+
+    if (current->error) {
+      std::rethrow_exception(current->error);
+    }
+  }
+
+  return std::move(current->transactions[next_transaction++]);
+}
+
+void ParallelReplaySource::schedule()
+{
+  while (chunks.size() < std::max<size_t>(options.max_chunks, 1)) {
+    auto chunk = cutChunk();
+
+    if (!chunk) {
+      return;
+    }
+    chunks.push_back(chunk);
+
+    {
+      std::lock_guard lock(mutex);
+      tasks.push_back(std::move(chunk));
+    }
+    task_added.notify_one();
+  }
+}
+
+std::shared_ptr<ParallelReplaySource::Chunk> ParallelReplaySource::cutChunk()
+{
+  while (!mapping || offset == content.size()) {
+    // Chunks keep their files mapped.
+    mapping.reset();
+    content = {};
+
+    if (next_file == paths.size()) {
+      return nullptr;
+    }
+    openNext();
+  }
+
+  auto chunk = std::make_shared<Chunk>();
+
+  chunk->mapping = mapping;
+  chunk->begin = offset;
+  chunk->seeds.push_back(makeRotateEvent(file_name, offset));
+
+  // The synthesized events precede the format description event, which may describe
+  // checksums they don't have.
+  if (executed) {
+    chunk->seeds.push_back(makePreviousGtidsEvent(*executed));
+  }
+  if (offset != format_offset && !format.empty()) {
+    chunk->seeds.push_back(format);
+  }
+
+  // Only the headers are read, except for the events changing the executed set and the
+  // queries. GTIDs are added at their commits, so the set is the one of the assembler at
+  // the cut.
+  bool has_rows = false;
+
+  while (offset < content.size()) {
+    const auto& path = paths[next_file - 1];
+    const auto available = content.size() - offset;
+    uint32_t event_size = 0;
+
+    if (available >= binlog::LOG_EVENT_HEADER_LEN) {
+      utils::StringBufferReader header(
+          content.data() + offset, binlog::LOG_EVENT_HEADER_LEN
+      );
+
+      PEEK(event_size, header, binlog::DATA_WRITTEN_OFFSET);
+
+      if (event_size < binlog::LOG_EVENT_HEADER_LEN) {
+        THROW(
+            ParallelReplayError,
+            fmt::format(
+                "Invalid size {} of the event at {} of `{}`", event_size, offset, path
+            )
+        );
+      }
+    }
+
+    if (available < binlog::LOG_EVENT_HEADER_LEN || event_size > available) {
+      if (next_file != paths.size()) {
+        THROW(
+            ParallelReplayError, fmt::format("`{}` ends inside an event at {}", path, offset)
+        );
+      }
+
+      // The server may be writing the event.
+      LOG_WARNING() << fmt::format(
+          "`{}` ends inside an event at {}", path, offset
+      );
+      content = content.substr(0, offset);
+      break;
+    }
+
+    utils::StringBufferReader reader(content.data() + offset, event_size);
+    uint8_t event_type;
+    bool ends_transaction = false;
+
+    PEEK(event_type, reader, binlog::EVENT_TYPE_OFFSET);
+    offset += event_size;
+
+    switch (event_type) {
+    case binlog::event::WRITE_ROWS_EVENT_V1:
+    case binlog::event::UPDATE_ROWS_EVENT_V1:
+    case binlog::event::DELETE_ROWS_EVENT_V1:
+      has_rows = true;
+      break;
+    case binlog::event::XID_EVENT:
+      ends_transaction = true;
+      break;
+    case binlog::event::QUERY_EVENT: {
+      const binlog::event::QueryEvent query_event(reader, &fde);
+
+      // Statements logged alone and `COMMIT` end their transactions, see
+      // `TableDiffAssembler`. Rows before another statement end at the next transaction.
+      ends_transaction = query_event.query == "COMMIT" ||
+                         (query_event.query != "BEGIN" && !has_rows);
+      has_rows = has_rows && !ends_transaction && query_event.query != "BEGIN";
+      break;
+    }
+    case binlog::event::PREVIOUS_GTIDS_LOG_EVENT: {
+      const binlog::event::PreviousGtidEvent previous_event(reader, &fde);
+      utils::StringBufferReader set_reader(previous_event.buf);
+      auto previous = binlog::GtidSet::decode(set_reader);
+
+      if (executed) {
+        executed->merge(previous);
+      } else {
+        executed = std::move(previous);
+      }
+      break;
+    }
+    case binlog::event::ANONYMOUS_GTID_LOG_EVENT:
+      // Rows of a transaction without a commit event end here.
+      has_rows = false;
+      break;
+    case binlog::event::GTID_LOG_EVENT:
+      if (executed) {
+        binlog::Uuid uuid;
+        int64_t gno;
+
+        reader.peekCpy(
+            reinterpret_cast<char*>(uuid.bytes.data()), binlog::LOG_EVENT_HEADER_LEN + 1,
+            binlog::Uuid::BYTE_LENGTH
+        );
+        PEEK(gno, reader, binlog::LOG_EVENT_HEADER_LEN + 1 + binlog::Uuid::BYTE_LENGTH);
+        executed->add(uuid, gno);
+      }
+      // Rows of a transaction without a commit event end here.
+      has_rows = false;
+      break;
+    }
+
+    if (ends_transaction) {
+      has_rows = false;
+
+      if (offset - chunk->begin >= options.chunk_bytes) {
+        break;
+      }
+    }
+  }
+
+  chunk->end = offset;
+  return chunk;
+}
+
+void ParallelReplaySource::openNext()
+{
+  const auto& path = paths[next_file++];
+  const auto name = std::filesystem::path(path).filename().string();
+  uint64_t position = 0;
+
+  // The first mapped file is the one of the start position, see `startFile`.
+  if (start_position) {
+    if (name == start_position->file) {
+      position = start_position->position;
+    }
+    start_position.reset();
+  }
+
+  mapping = utils::MappedFile::open(path, true);
+  content = mapping->content();
+  file_name = name;
+  offset = 0;
+
+  // Files written by the server start with the magic number, dumped streams don't.
+  if (content.size() >= sizeof(binlog::BINLOG_MAGIC)) {
+    utils::StringBufferReader reader(content);
+
+    if (reader.peek<uint32_t>() == binlog::BINLOG_MAGIC) {
+      offset = sizeof(binlog::BINLOG_MAGIC);
+    }
+  }
+
+  format = {};
+  format_offset = offset;
+  fde = {binlog::BINLOG_VERSION, binlog::SERVER_VERSION};
+
+  if (content.size() - offset >= binlog::LOG_EVENT_HEADER_LEN) {
+    utils::StringBufferReader header(
+        content.data() + offset, binlog::LOG_EVENT_HEADER_LEN
+    );
+    uint8_t event_type;
+    uint32_t event_size;
+
+    PEEK(event_type, header, binlog::EVENT_TYPE_OFFSET);
+    PEEK(event_size, header, binlog::DATA_WRITTEN_OFFSET);
+
+    if (event_type == binlog::event::FORMAT_DESCRIPTION_EVENT &&
+        event_size <= content.size() - offset)
+    {
+      utils::StringBufferReader reader(content.data() + offset, event_size);
+      binlog::event::FormatDescriptionEvent start(
+          binlog::BINLOG_VERSION, binlog::SERVER_VERSION
+      );
+
+      format = Buffer(mapping, content.substr(offset, event_size));
+      fde = binlog::event::FormatDescriptionEvent(reader, &start);
+    }
+  }
+
+  if (position > content.size()) {
+    THROW(
+        ParallelReplayError,
+        fmt::format("Start position {} is beyond the end of `{}`", position, path)
+    );
+  }
+  offset = std::max<size_t>(offset, position);
+
+  LOG_INFO() << fmt::format("Replaying `{}` from {}", path, offset);
+}
+
+void ParallelReplaySource::work()
+{
+  while (true) {
+    std::shared_ptr<Chunk> chunk;
+
+    {
+      std::unique_lock lock(mutex);
+      task_added.wait(lock, [this]() {
+        return stopping || !tasks.empty();
+      });
+
+      if (stopping) {
+        return;
+      }
+
+      chunk = std::move(tasks.front());
+      tasks.pop_front();
+    }
+
+    try {
+      parse(*chunk);
+    } catch (...) {
+      chunk->error = std::current_exception();
+    }
+
+    {
+      std::lock_guard lock(mutex);
+      chunk->done = true;
+    }
+    chunk_done.notify_all();
+  }
+}
+
+void ParallelReplaySource::parse(Chunk& chunk) const
+{
+  EventParser parser(applied);
+  TableDiffAssembler assembler;
+  TransactionAssembler transactions;
+
+  auto add = [&](std::optional<TableDiff>&& diff) {
+    if (!diff) {
+      return;
+    }
+
+    if (auto transaction = transactions.process(std::move(diff.value()))) {
+      chunk.transactions.push_back(std::move(transaction.value()));
+    }
+  };
+  auto feed = [&](const Buffer& buffer) {
+    if (auto event = parser.parse(buffer)) {
+      add(assembler.process(std::move(event)));
+    }
+  };
+
+  for (const auto& seed : chunk.seeds) {
+    feed(seed);
+  }
+
+  const auto content = chunk.mapping->content();
+
+  // Events are owning views of the mapping, so rows share it instead of copies.
+  for (size_t offset = chunk.begin; offset < chunk.end;) {
+    utils::StringBufferReader header(
+        content.data() + offset, binlog::LOG_EVENT_HEADER_LEN
+    );
+    uint32_t event_size;
+
+    PEEK(event_size, header, binlog::DATA_WRITTEN_OFFSET);
+    feed(Buffer(chunk.mapping, content.substr(offset, event_size)));
+    offset += event_size;
+  }
+
+  // Chunks end after transactions, but a file may end inside one. It is dropped as at the
+  // end of a serial stream.
+  add(assembler.finish());
+}
+
+} // namespace cdc
@@ -0,0 +1,634 @@
+#include <cdc/row_decoder.hpp>
+
+#include <charconv>
+#include <cstring>
+#include <optional>
+
+namespace {
+
+using ColumnType = binlog::event::TableMapEvent::ColumnType;
+
+/// @returns Number of field metadata bytes of the column type in the table map event.
+size_t metadataSize(ColumnType type) noexcept
+{
+  switch (type) {
+  case ColumnType::TYPE_FLOAT:
+  case ColumnType::TYPE_DOUBLE:
+  case ColumnType::TYPE_TIMESTAMP2:
+  case ColumnType::TYPE_DATETIME2:
+  case ColumnType::TYPE_TIME2:
+  case ColumnType::TYPE_BLOB:
+  case ColumnType::TYPE_TINY_BLOB:
+  case ColumnType::TYPE_MEDIUM_BLOB:
+  case ColumnType::TYPE_LONG_BLOB:
+  case ColumnType::TYPE_GEOMETRY:
+  case ColumnType::TYPE_JSON:
+  case ColumnType::TYPE_VECTOR:
+    return 1;
+  case ColumnType::TYPE_VARCHAR:
+  case ColumnType::TYPE_VAR_STRING:
+  case ColumnType::TYPE_STRING:
+  case ColumnType::TYPE_ENUM:
+  case ColumnType::TYPE_SET:
+  case ColumnType::TYPE_BIT:
+  case ColumnType::TYPE_NEWDECIMAL:
+    return 2;
+  default:
+    return 0;
+  }
+}
+
+/// @returns `true` if the column has a bit in the signedness metadata.
+bool hasSignedness(ColumnType type) noexcept
+{
+  switch (type) {
+  case ColumnType::TYPE_TINY:
+  case ColumnType::TYPE_SHORT:
+  case ColumnType::TYPE_INT24:
+  case ColumnType::TYPE_LONG:
+  case ColumnType::TYPE_LONGLONG:
+  case ColumnType::TYPE_FLOAT:
+  case ColumnType::TYPE_DOUBLE:
+  case ColumnType::TYPE_DECIMAL:
+  case ColumnType::TYPE_NEWDECIMAL:
+  case ColumnType::TYPE_BOOL:
+    return true;
+  default:
+    return false;
+  }
+}
+
+/// @brief Formats the primary key as a zero-padded string, so keys sort as numbers.
+template<typename String>
+String gen_id(uint64_t num, String result)
+{
+  static constexpr size_t id_len = 24;
+  char digits[id_len];
+  const auto end = std::to_chars(digits, digits + id_len, num).ptr;
+
+  result.assign(id_len - (end - digits), '0');
+  result.append(digits, end);
+  return result;
+}
+
+} // namespace
+
+namespace cdc {
+
+const std::string RowDecoder::PK_FIELD_NAME = "_id";
+const std::string RowDecoder::PK_JSON_POINTER = std::string{"/"} + PK_FIELD_NAME;
+
+RowDecoder::RowImage::RowImage(
+    const RowDecoder& decoder, ColumnBitmap present_columns,
+    utils::StringBufferReader& row_r
+) :
+    present_columns(present_columns)
+{
+  const auto width = decoder.columns.size();
+  size_t present = width;
+
+  if (!present_columns.empty()) {
+    if (present_columns.size() < (width + 7) / 8) {
+      THROW(
+          RowDecoderError, fmt::format(
+                               "Table: {}.{}. Bitmap of columns is shorter than {} bits.",
+                               decoder.schema.collection_name, decoder.schema.table_name,
+                               width
+                           )
+      );
+    }
+
+    present = 0;
+    for (size_t i = 0; i < width; ++i) {
+      present += isPresent(i);
+    }
+  }
+
+  null_bitmap = reinterpret_cast<const uint8_t*>(row_r.ptr());
+  row_r.skip((present + 7) / 8);
+}
+
+bool RowDecoder::RowImage::isPresent(size_t index) const noexcept
+{
+  return present_columns.empty() || (present_columns[index / 8] >> (index % 8)) & 1;
+}
+
+bool RowDecoder::RowImage::nextIsNull() noexcept
+{
+  const bool is_null = (null_bitmap[null_bit / 8] >> (null_bit % 8)) & 1;
+
+  ++null_bit;
+  return is_null;
+}
+
+template<typename OnValue>
+std::string RowDecoder::readImage(
+    RowImage& image, utils::StringBufferReader& row_r, OnValue&& on_value
+) const
+{
+  std::optional<std::string> key;
+
+  for (size_t i = 0; i < columns.size(); ++i) {
+    if (!image.isPresent(i)) {
+      continue;
+    }
+
+    if (image.nextIsNull()) {
+      if (i == pk_index) {
+        throwNullKey();
+      }
+      on_value(i, std::string_view());
+      continue;
+    }
+
+    const auto* begin = row_r.ptr();
+
+    if (i == pk_index) {
+      key = gen_id(row_r.read<uint64_t>(), std::string());
+    } else {
+      skipValue(i, row_r);
+    }
+    on_value(i, std::string_view(begin, row_r.ptr() - begin));
+  }
+
+  if (!key) {
+    throwNullKey();
+  }
+
+  return std::move(key.value());
+}
+
+RowDecoder::RowDecoder(const TableSchema& schema) :
+    schema(schema)
+{
+  const auto& pk_list = schema.column_primary_key_list;
+  const auto& column_name_list = schema.column_name_list;
+
+  if (pk_list.size() != 1 || pk_list[0] >= column_name_list.size() ||
+      column_name_list[pk_list[0]] != PK_FIELD_NAME)
+  {
+    THROW(
+        RowDecoderError,
+        fmt::format(
+            "Table {}.{}. Primary key must be one and name == '{}'.",
+            schema.collection_name, schema.table_name, PK_FIELD_NAME
+        )
+    );
+  }
+  pk_index = pk_list[0];
+
+  if (column_name_list.size() != static_cast<size_t>(schema.width) ||
+      schema.column_types.size() != static_cast<size_t>(schema.width))
+  {
+    THROW(
+        RowDecoderError,
+        fmt::format(
+            "Table {}.{}. Names and types of all columns are required.",
+            schema.collection_name, schema.table_name
+        )
+    );
+  }
+
+  utils::StringBufferReader metadata_r(schema.column_metatypes);
+  const auto& signedness = schema.column_signedness;
+  size_t signedness_index = 0;
+
+  columns.reserve(schema.width);
+
+  for (size_t i = 0; i < static_cast<size_t>(schema.width); ++i) {
+    const auto type = static_cast<ColumnType>(schema.column_types[i]);
+    Column& column = columns.emplace_back(Column{
+        .op = Op::UNSUPPORTED, .length = 0, .json_pointer = "/" + column_name_list[i]
+    });
+    bool unsigned_ = false;
+
+    if (hasSignedness(type)) {
+      const auto byte_index = signedness_index / 8;
+
+      unsigned_ = byte_index < signedness.size() &&
+                  (signedness[byte_index] >> (7 - signedness_index % 8)) & 1;
+      ++signedness_index;
+    }
+
+    // Metadata is read by the type, so columns are never misaligned with it.
+    const auto metadata =
+        metadata_r.available() >= metadataSize(type)
+            ? std::string_view(metadata_r.ptr(), metadataSize(type))
+            : std::string_view();
+    metadata_r.skip(metadata.size());
+
+    if (i == pk_index) {
+      if (type != ColumnType::TYPE_LONGLONG || !unsigned_) {
+        THROW(
+            RowDecoderError,
+            fmt::format(
+                "Table: {}.{}. Type of primary key '{}' must have unsigned integral.",
+                schema.table_name, schema.collection_name, column_name_list[pk_index]
+            )
+        );
+      }
+      column.op = Op::PRIMARY_KEY;
+      continue;
+    }
+
+    switch (type) {
+    case ColumnType::TYPE_TINY:
+      column.op = unsigned_ ? Op::UINT8 : Op::INT8;
+      break;
+    case ColumnType::TYPE_SHORT:
+      column.op = unsigned_ ? Op::UINT16 : Op::INT16;
+      break;
+    case ColumnType::TYPE_INT24:
+      column.op = unsigned_ ? Op::UINT24 : Op::INT24;
+      break;
+    case ColumnType::TYPE_LONG:
+      column.op = unsigned_ ? Op::UINT32 : Op::INT32;
+      break;
+    case ColumnType::TYPE_LONGLONG:
+      column.op = unsigned_ ? Op::UINT64 : Op::INT64;
+      break;
+    case ColumnType::TYPE_FLOAT:
+    case ColumnType::TYPE_DOUBLE:
+      if (metadata.size() == 1 && metadata[0] == 4) {
+        column.op = Op::FLOAT;
+      } else if (metadata.size() == 1 && metadata[0] == 8) {
+        column.op = Op::DOUBLE;
+      }
+      break;
+    case ColumnType::TYPE_BOOL:
+      column.op = Op::BOOL;
+      break;
+    case ColumnType::TYPE_VARCHAR: {
+      uint16_t max_length = 0;
+
+      std::memcpy(&max_length, metadata.data(), metadata.size());
+      column.op = max_length <= 255 ? Op::VARCHAR8 : Op::VARCHAR16;
+      break;
+    }
+    case ColumnType::TYPE_STRING:
+      if (metadata.size() == 2 && static_cast<uint8_t>(metadata[0]) == type) {
+        column.op = Op::STRING;
+        column.length = static_cast<uint8_t>(metadata[1]) / 4;
+      }
+      break;
+    default:
+      break;
+    }
+  }
+}
+
+components::document::document_ptr RowDecoder::decode(
+    utils::StringBufferReader& row_r, std::pmr::memory_resource* resource,
+    ColumnBitmap present_columns
+) const
+{
+  auto doc = components::document::make_document(resource);
+  RowImage image(*this, present_columns, row_r);
+
+  for (size_t i = 0; i < columns.size(); ++i) {
+    if (!image.isPresent(i)) {
+      if (i == pk_index) {
+        throwNullKey();
+      }
+      continue;
+    }
+
+    if (image.nextIsNull()) {
+      if (i == pk_index) {
+        throwNullKey();
+      }
+      doc->set(columns[i].json_pointer, nullptr);
+      continue;
+    }
+
+    decodeValue(i, row_r, doc, resource);
+  }
+
+  return doc;
+}
+
+void RowDecoder::decodeValue(
+    size_t index, utils::StringBufferReader& row_r,
+    const components::document::document_ptr& doc, std::pmr::memory_resource* resource
+) const
+{
+  const auto& column = columns[index];
+  const auto& json_pointer = column.json_pointer;
+
+  switch (column.op) {
+  case Op::PRIMARY_KEY:
+    doc->set(json_pointer, gen_id(row_r.read<uint64_t>(), std::pmr::string(resource)));
+    break;
+  case Op::INT8:
+    doc->set<int64_t>(json_pointer, row_r.read<int8_t>());
+    break;
+  case Op::UINT8:
+    doc->set<uint64_t>(json_pointer, row_r.read<uint8_t>());
+    break;
+  case Op::INT16:
+    doc->set<int64_t>(json_pointer, row_r.read<int16_t>());
+    break;
+  case Op::UINT16:
+    doc->set<uint64_t>(json_pointer, row_r.read<uint16_t>());
+    break;
+  case Op::INT24: {
+    int32_t value = (row_r.peek<uint8_t>(2) & 128) ? (int32_t)-1 << 24 : 0;
+
+    row_r.readCpy((char*)&value, 3);
+    doc->set<int64_t>(json_pointer, value);
+    break;
+  }
+  case Op::UINT24: {
+    uint32_t value = 0;
+
+    row_r.readCpy((char*)&value, 3);
+    doc->set<uint64_t>(json_pointer, value);
+    break;
+  }
+  case Op::INT32:
+    doc->set<int64_t>(json_pointer, row_r.read<int32_t>());
+    break;
+  case Op::UINT32:
+    doc->set<uint64_t>(json_pointer, row_r.read<uint32_t>());
+    break;
+  case Op::INT64:
+    doc->set<int64_t>(json_pointer, row_r.read<int64_t>());
+    break;
+  case Op::UINT64:
+    doc->set<uint64_t>(json_pointer, row_r.read<uint64_t>());
+    break;
+  case Op::FLOAT:
+    doc->set(json_pointer, row_r.read<float>());
+    break;
+  case Op::DOUBLE:
+    doc->set(json_pointer, row_r.read<double>());
+    break;
+  case Op::BOOL:
+    doc->set(json_pointer, static_cast<bool>(row_r.read<uint8_t>()));
+    break;
+  case Op::VARCHAR8:
+  case Op::VARCHAR16: {
+    const uint16_t len = column.op == Op::VARCHAR8 ? row_r.read<uint8_t>()
+                                                   : row_r.read<uint16_t>();
+    std::pmr::string str(len, '\0', resource);
+
+    row_r.readCpy(str.data(), str.size());
+    doc->set(json_pointer, std::move(str));
+    break;
+  }
+  case Op::STRING: {
+    std::pmr::string str(column.length, ' ', resource);
+    const uint8_t len = row_r.read<uint8_t>();
+
+    if (len > str.size()) {
+      str.resize(len);
+    }
+    row_r.readCpy(str.data(), len);
+    doc->set(json_pointer, std::move(str));
+    break;
+  }
+  case Op::UNSUPPORTED:
+    throwUnsupported(index);
+  }
+}
+
+RowDecoder::Update RowDecoder::decodeUpdate(
+    utils::StringBufferReader& row_r, ColumnBitmap before_columns,
+    ColumnBitmap after_columns, std::pmr::memory_resource* resource
+) const
+{
+  Update update;
+  // Values of the before-image, empty for NULL: a non-NULL value has at least a byte.
+  std::pmr::vector<std::string_view> before(columns.size(), resource);
+  // Columns absent from the before-image have unknown values, so they always change.
+  std::pmr::vector<bool> known(columns.size(), false, resource);
+  RowImage before_image(*this, before_columns, row_r);
+
+  update.key = readImage(before_image, row_r, [&](size_t i, std::string_view value) {
+    before[i] = value;
+    known[i] = true;
+  });
+
+  const auto changes = [&update, resource]() -> auto& {
+    if (!update.changes) {
+      update.changes = components::document::make_document(resource);
+    }
+    return update.changes;
+  };
+
+  RowImage after_image(*this, after_columns, row_r);
+
+  for (size_t i = 0; i < columns.size(); ++i) {
+    if (!after_image.isPresent(i)) {
+      continue;
+    }
+
+    if (after_image.nextIsNull()) {
+      if (!known[i] || !before[i].empty()) {
+        changes()->set(columns[i].json_pointer, nullptr);
+      }
+      continue;
+    }
+
+    const auto* begin = row_r.ptr();
+
+    skipValue(i, row_r);
+
+    const std::string_view after(begin, row_r.ptr() - begin);
+
+    if (i != pk_index && (!known[i] || after != before[i])) {
+      utils::StringBufferReader value_r(after);
+      decodeValue(i, value_r, changes(), resource);
+    }
+  }
+
+  return update;
+}
+
+std::string RowDecoder::extractKey(
+    utils::StringBufferReader& row_r, ColumnBitmap present_columns
+) const
+{
+  RowImage image(*this, present_columns, row_r);
+
+  return readImage(image, row_r, [](size_t, std::string_view) {});
+}
+
+void RowDecoder::skipValue(size_t index, utils::StringBufferReader& row_r) const
+{
+  const auto& column = columns[index];
+
+  switch (column.op) {
+  case Op::INT8:
+  case Op::UINT8:
+  case Op::BOOL:
+    row_r.skip(1);
+    break;
+  case Op::INT16:
+  case Op::UINT16:
+    row_r.skip(2);
+    break;
+  case Op::INT24:
+  case Op::UINT24:
+    row_r.skip(3);
+    break;
+  case Op::INT32:
+  case Op::UINT32:
+  case Op::FLOAT:
+    row_r.skip(4);
+    break;
+  case Op::PRIMARY_KEY:
+  case Op::INT64:
+  case Op::UINT64:
+  case Op::DOUBLE:
+    row_r.skip(8);
+    break;
+  case Op::VARCHAR8:
+  case Op::STRING:
+    row_r.skip(row_r.read<uint8_t>());
+    break;
+  case Op::VARCHAR16:
+    row_r.skip(row_r.read<uint16_t>());
+    break;
+  case Op::UNSUPPORTED:
+    // The length of the value is unknown, so the rest of the row can't be found.
+    throwUnsupported(index);
+  }
+}
+
+void RowDecoder::throwNullKey() const
+{
+  THROW(
+      RowDecoderError,
+      fmt::format(
+          "Table: {}.{}. Primary key '{}' must have value.", schema.table_name,
+          schema.collection_name, schema.column_name_list[pk_index]
+      )
+  );
+}
+
+void RowDecoder::throwUnsupported(size_t index) const
+{
+  THROW(
+      RowDecoderError, fmt::format(
+                           "Table: {}.{}. Unknown type of column '{}'.",
+                           schema.collection_name, schema.table_name,
+                           schema.column_name_list[index]
+                       )
+  );
+}
+
+components::document::document_ptr RowDecoder::decodeText(
+    std::span<const std::string_view> values, std::pmr::memory_resource* resource
+) const
+{
+  if (values.size() != columns.size()) {
+    THROW(
+        RowDecoderError, fmt::format(
+                             "Table: {}.{}. Row has {} values of {} columns.",
+                             schema.collection_name, schema.table_name, values.size(),
+                             columns.size()
+                         )
+    );
+  }
+
+  auto doc = components::document::make_document(resource);
+
+  for (size_t i = 0; i < columns.size(); ++i) {
+    if (values[i].data() == nullptr) {
+      if (i == pk_index) {
+        throwNullKey();
+      }
+      doc->set(columns[i].json_pointer, nullptr);
+      continue;
+    }
+
+    decodeTextValue(i, values[i], doc, resource);
+  }
+
+  return doc;
+}
+
+void RowDecoder::decodeTextValue(
+    size_t index, std::string_view text, const components::document::document_ptr& doc,
+    std::pmr::memory_resource* resource
+) const
+{
+  const auto& column = columns[index];
+  const auto& json_pointer = column.json_pointer;
+
+  switch (column.op) {
+  case Op::PRIMARY_KEY:
+    doc->set(
+        json_pointer,
+        gen_id(parseNumber<uint64_t>(index, text), std::pmr::string(resource))
+    );
+    break;
+  case Op::INT8:
+  case Op::INT16:
+  case Op::INT24:
+  case Op::INT32:
+  case Op::INT64:
+    doc->set(json_pointer, parseNumber<int64_t>(index, text));
+    break;
+  case Op::UINT8:
+  case Op::UINT16:
+  case Op::UINT24:
+  case Op::UINT32:
+  case Op::UINT64:
+    doc->set(json_pointer, parseNumber<uint64_t>(index, text));
+    break;
+  case Op::FLOAT:
+    doc->set(json_pointer, parseNumber<float>(index, text));
+    break;
+  case Op::DOUBLE:
+    doc->set(json_pointer, parseNumber<double>(index, text));
+    break;
+  case Op::BOOL:
+    doc->set(json_pointer, parseNumber<uint64_t>(index, text) != 0);
+    break;
+  case Op::VARCHAR8:
+  case Op::VARCHAR16:
+    doc->set(json_pointer, std::pmr::string(text, resource));
+    break;
+  case Op::STRING: {
+    // The text protocol strips the padding which row images restore.
+    std::pmr::string str(text, resource);
+
+    if (str.size() < column.length) {
+      str.resize(column.length, ' ');
+    }
+    doc->set(json_pointer, std::move(str));
+    break;
+  }
+  case Op::UNSUPPORTED:
+    throwUnsupported(index);
+  }
+}
+
+template<typename T>
+T RowDecoder::parseNumber(size_t index, std::string_view text) const
+{
+  T value{};
+  const auto* last = text.data() + text.size();
+  const auto [end, error] = std::from_chars(text.data(), last, value);
+
+  if (error != std::errc{} || end != last) {
+    THROW(
+        RowDecoderError, fmt::format(
+                             "Table: {}.{}. Invalid value '{}' of column '{}'.",
+                             schema.collection_name, schema.table_name, text,
+                             schema.column_name_list[index]
+                         )
+    );
+  }
+
+  return value;
+}
+
+size_t RowDecoder::primaryKeyIndex() const noexcept
+{
+  return pk_index;
+}
+
+} // namespace cdc
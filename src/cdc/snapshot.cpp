@@ -0,0 +1,477 @@
+#include <cdc/row_decoder.hpp>
+#include <cdc/snapshot.hpp>
+
+#include <atomic>
+#include <charconv>
+#include <cstring>
+#include <exception>
+#include <fmt/ranges.h>
+#include <mutex>
+#include <thread>
+
+namespace cdc {
+
+namespace {
+
+using ColumnType = binlog::event::TableMapEvent::ColumnType;
+using Result = std::unique_ptr<MYSQL_RES, decltype(&mysql_free_result)>;
+
+std::string quoteIdentifier(std::string_view name)
+{
+  std::string result = "`";
+
+  for (const char c : name) {
+    result += c;
+    if (c == '`') {
+      result += c;
+    }
+  }
+  return result + "`";
+}
+
+/// @throws `SnapshotLoader::SnapshotError` Thrown if the key isn't an unsigned integer,
+/// which `describeTables()` doesn't let through.
+uint64_t parseKey(std::string_view value)
+{
+  uint64_t key = 0;
+  const auto [end, error] = std::from_chars(value.begin(), value.end(), key);
+
+  if (error != std::errc() || end != value.end()) {
+    THROW(
+        SnapshotLoader::SnapshotError,
+        fmt::format("Primary key `{}` is not an unsigned integer", value)
+    );
+  }
+  return key;
+}
+
+/// @returns The value of the row, empty for NULL.
+std::string_view field(MYSQL_ROW row, const unsigned long* lengths, size_t index)
+{
+  return row[index] ? std::string_view(row[index], lengths[index]) : std::string_view();
+}
+
+} // namespace
+
+class SnapshotLoader::Connection {
+public:
+  explicit Connection(const SnapshotLoader& loader)
+  {
+    mysql_init(&conn);
+
+    if (!mysql_real_connect(
+            &conn, loader.host.c_str(), loader.user.c_str(), loader.passwd.c_str(),
+            loader.db.c_str(), loader.port, nullptr, 0
+        ))
+    {
+      const std::string error = mysql_error(&conn);
+
+      mysql_close(&conn);
+      THROW(SnapshotError, fmt::format("Can't connect to `{}`: {}", loader.db, error));
+    }
+  }
+
+  Connection(const Connection&) = delete;
+  Connection& operator=(const Connection&) = delete;
+
+  ~Connection()
+  {
+    mysql_close(&conn);
+  }
+
+  void execute(const std::string& sql)
+  {
+    if (mysql_real_query(&conn, sql.data(), sql.size())) {
+      THROW(SnapshotError, fmt::format("Query `{}` failed: {}", sql, mysql_error(&conn)));
+    }
+  }
+
+  /// @returns The whole result of the query.
+  Result query(const std::string& sql)
+  {
+    execute(sql);
+    return checked(mysql_store_result(&conn), sql);
+  }
+
+  /// @returns The result of the query, rows of which are received while fetched.
+  Result stream(const std::string& sql)
+  {
+    execute(sql);
+    return checked(mysql_use_result(&conn), sql);
+  }
+
+  /// @throws `SnapshotError` Thrown if fetching of the streamed rows failed.
+  void checkFetched(const std::string& sql)
+  {
+    if (mysql_errno(&conn)) {
+      THROW(SnapshotError, fmt::format("Query `{}` failed: {}", sql, mysql_error(&conn)));
+    }
+  }
+
+  /// @returns The value as an escaped string literal.
+  std::string quote(std::string_view value)
+  {
+    std::string result(value.size() * 2 + 1, '\0');
+
+    result.resize(
+        mysql_real_escape_string(&conn, result.data(), value.data(), value.size())
+    );
+    return "'" + result + "'";
+  }
+
+private:
+  Result checked(MYSQL_RES* result, const std::string& sql)
+  {
+    if (!result) {
+      THROW(SnapshotError, fmt::format("Query `{}` has no result", sql));
+    }
+    return Result(result, &mysql_free_result);
+  }
+
+  MYSQL conn;
+};
+
+struct SnapshotLoader::Cutter {
+  std::mutex mutex;
+  /// Index of the table cut now.
+  size_t table{0};
+  /// Last key of the last chunk of the table.
+  std::optional<uint64_t> after;
+  size_t chunks{0};
+};
+
+SnapshotLoader::SnapshotLoader(
+    const char* host, const char* user, const char* passwd, const char* db,
+    unsigned int port, SnapshotOptions options
+) :
+    host(host),
+    user(user),
+    passwd(passwd),
+    db(db),
+    port(port),
+    options(options)
+{}
+
+BinlogPosition SnapshotLoader::load(OtterBrixConsumerSink& consumer)
+{
+  auto coordinator = connect();
+  std::vector<std::unique_ptr<Connection>> workers;
+
+  for (size_t i = 0; i < std::max<size_t>(options.workers, 1); ++i) {
+    workers.push_back(connect());
+  }
+
+  // Writes wait while the snapshots are opened, so all of them are at the position.
+  coordinator->execute("FLUSH TABLES WITH READ LOCK");
+
+  for (auto& worker : workers) {
+    worker->execute("SET SESSION TRANSACTION ISOLATION LEVEL REPEATABLE READ");
+    worker->execute("START TRANSACTION WITH CONSISTENT SNAPSHOT");
+  }
+
+  BinlogPosition position;
+  const auto status = coordinator->query("SHOW MASTER STATUS");
+  MYSQL_ROW row = mysql_fetch_row(status.get());
+
+  if (!row || !row[0] || !row[1]) {
+    THROW(SnapshotError, fmt::format("Binary log of `{}` is disabled", db));
+  }
+
+  position.file = row[0];
+  position.position = std::stoull(row[1]);
+
+  // Only MySQL reports the executed GTID set, as the fifth column.
+  if (mysql_num_fields(status.get()) >= 5 && row[4]) {
+    position.gtid_set = binlog::GtidSet::parse(row[4]).toString();
+  }
+
+  const auto schemas = describeTables(*coordinator);
+
+  coordinator->execute("UNLOCK TABLES");
+  coordinator.reset();
+
+  LOG_INFO() << fmt::format(
+      "Snapshot of {} tables at {}:{}", schemas.size(), position.file, position.position
+  );
+
+  Cutter cutter;
+  std::atomic<bool> failed{false};
+  std::mutex error_mutex;
+  std::exception_ptr error;
+  std::vector<std::thread> threads;
+
+  for (auto& worker : workers) {
+    threads.emplace_back([&, connection = worker.get()]() {
+      try {
+        while (!failed) {
+          const auto chunk = cutChunk(*connection, schemas, cutter);
+
+          if (!chunk) {
+            break;
+          }
+          copyChunk(*connection, *chunk, consumer);
+        }
+      } catch (...) {
+        std::lock_guard lock(error_mutex);
+
+        if (!error) {
+          error = std::current_exception();
+        }
+        failed = true;
+      }
+    });
+  }
+
+  for (auto& thread : threads) {
+    thread.join();
+  }
+
+  if (error) {
+    std::rethrow_exception(error);
+  }
+
+  LOG_INFO() << fmt::format("Snapshot of `{}` is loaded in {} chunks", db, cutter.chunks);
+
+  return position;
+}
+
+std::unique_ptr<SnapshotLoader::Connection> SnapshotLoader::connect() const
+{
+  return std::make_unique<Connection>(*this);
+}
+
+std::vector<TableSchema::SPtr> SnapshotLoader::describeTables(Connection& connection
+) const
+{
+  std::vector<TableSchema::SPtr> schemas;
+  std::vector<std::string> tables;
+
+  {
+    const auto result = connection.query(fmt::format(
+        "SELECT TABLE_NAME FROM information_schema.TABLES "
+        "WHERE TABLE_SCHEMA = {} AND TABLE_TYPE = 'BASE TABLE'",
+        connection.quote(db)
+    ));
+
+    while (MYSQL_ROW row = mysql_fetch_row(result.get())) {
+      tables.emplace_back(row[0]);
+    }
+  }
+
+  for (const auto& table : tables) {
+    const auto result = connection.query(fmt::format(
+        "SELECT COLUMN_NAME, DATA_TYPE, COLUMN_TYPE, CHARACTER_OCTET_LENGTH, COLUMN_KEY "
+        "FROM information_schema.COLUMNS WHERE TABLE_SCHEMA = {} AND TABLE_NAME = {} "
+        "ORDER BY ORDINAL_POSITION",
+        connection.quote(db), connection.quote(table)
+    ));
+
+    // Types and metadata of the columns as the table map event has them.
+    std::string types;
+    std::string metadata;
+    std::string signedness;
+    size_t signedness_bits = 0;
+    std::vector<std::string> names;
+    std::vector<uint16_t> primary_key;
+    std::vector<std::string> unsupported;
+
+    while (MYSQL_ROW row = mysql_fetch_row(result.get())) {
+      const auto* lengths = mysql_fetch_lengths(result.get());
+      const auto data_type = field(row, lengths, 1);
+      const bool is_unsigned =
+          field(row, lengths, 2).find("unsigned") != std::string_view::npos;
+      const auto octet_length = field(row, lengths, 3);
+      uint64_t max_bytes = 0;
+
+      std::from_chars(octet_length.begin(), octet_length.end(), max_bytes);
+
+      ColumnType type = ColumnType::TYPE_INVALID;
+      bool has_signedness = true;
+
+      if (data_type == "tinyint") {
+        type = ColumnType::TYPE_TINY;
+      } else if (data_type == "smallint") {
+        type = ColumnType::TYPE_SHORT;
+      } else if (data_type == "mediumint") {
+        type = ColumnType::TYPE_INT24;
+      } else if (data_type == "int") {
+        type = ColumnType::TYPE_LONG;
+      } else if (data_type == "bigint") {
+        type = ColumnType::TYPE_LONGLONG;
+      } else if (data_type == "float") {
+        type = ColumnType::TYPE_FLOAT;
+        metadata += '\x04';
+      } else if (data_type == "double") {
+        type = ColumnType::TYPE_DOUBLE;
+        metadata += '\x08';
+      } else {
+        has_signedness = false;
+
+        if (data_type == "varchar") {
+          type = ColumnType::TYPE_VARCHAR;
+          metadata += static_cast<char>(max_bytes & 0xff);
+          metadata += static_cast<char>(max_bytes >> 8 & 0xff);
+        } else if (data_type == "char") {
+          // Longer strings have another metadata, which the decoder rejects.
+          type = ColumnType::TYPE_STRING;
+          metadata += static_cast<char>(max_bytes <= 0xff ? ColumnType::TYPE_STRING : 0);
+          metadata += static_cast<char>(max_bytes <= 0xff ? max_bytes : 0);
+        }
+      }
+
+      if (has_signedness) {
+        if (signedness_bits % 8 == 0) {
+          signedness += '\0';
+        }
+        if (is_unsigned) {
+          signedness.back() |= static_cast<char>(0x80 >> signedness_bits % 8);
+        }
+        ++signedness_bits;
+      }
+
+      if (field(row, lengths, 4) == "PRI") {
+        primary_key.push_back(static_cast<uint16_t>(names.size()));
+      }
+      types += static_cast<char>(type);
+      names.emplace_back(field(row, lengths, 0));
+
+      if (type == ColumnType::TYPE_INVALID) {
+        unsupported.push_back(fmt::format("`{}` {}", names.back(), data_type));
+      }
+    }
+
+    // `RowDecoder::decodeText()` rejects such columns, which would fail the snapshot.
+    if (!unsupported.empty()) {
+      LOG_WARNING() << fmt::format(
+          "Table `{}` is not copied: unsupported columns {}", table,
+          fmt::join(unsupported, ", ")
+      );
+      continue;
+    }
+
+    auto schema = std::make_shared<const TableSchema>(
+        db, table, std::move(types), std::move(metadata), std::move(names),
+        std::move(primary_key), std::move(signedness)
+    );
+
+    try {
+      schema->decoder();
+      schemas.push_back(std::move(schema));
+    } catch (const RowDecoder::RowDecoderError& e) {
+      LOG_WARNING() << fmt::format("Table `{}` is not copied: {}", table, e.what());
+    }
+  }
+
+  return schemas;
+}
+
+std::optional<SnapshotLoader::Chunk> SnapshotLoader::cutChunk(
+    Connection& connection, const std::vector<TableSchema::SPtr>& schemas, Cutter& cutter
+) const
+{
+  const auto pk = quoteIdentifier(RowDecoder::PK_FIELD_NAME);
+  std::lock_guard lock(cutter.mutex);
+
+  if (cutter.table == schemas.size()) {
+    return std::nullopt;
+  }
+
+  const auto& schema = schemas[cutter.table];
+  // The last key of the chunk is found in the index, no rows are read.
+  const auto sql = fmt::format(
+      "SELECT {0} FROM {1}.{2}{3} ORDER BY {0} LIMIT 1 OFFSET {4}", pk,
+      quoteIdentifier(db), quoteIdentifier(schema->table_name),
+      cutter.after ? fmt::format(" WHERE {} > {}", pk, *cutter.after) : "",
+      std::max<uint64_t>(options.chunk_rows, 1) - 1
+  );
+  const auto result = connection.query(sql);
+  MYSQL_ROW row = mysql_fetch_row(result.get());
+  Chunk chunk{schema, cutter.after, std::nullopt};
+
+  if (row && row[0]) {
+    chunk.last = parseKey(row[0]);
+    cutter.after = chunk.last;
+  } else {
+    // Fewer rows are left, the chunk ends the table.
+    ++cutter.table;
+    cutter.after.reset();
+  }
+  ++cutter.chunks;
+
+  return chunk;
+}
+
+void SnapshotLoader::copyChunk(
+    Connection& connection, const Chunk& chunk, OtterBrixConsumerSink& consumer
+) const
+{
+  using namespace components::logical_plan;
+
+  const auto& schema = *chunk.schema;
+  const auto& decoder = schema.decoder();
+  auto* resource = consumer.resource();
+  std::string columns;
+
+  for (const auto& name : schema.column_name_list) {
+    columns += columns.empty() ? "" : ", ";
+    columns += quoteIdentifier(name);
+  }
+
+  const auto pk = quoteIdentifier(RowDecoder::PK_FIELD_NAME);
+  std::vector<std::string> range;
+
+  if (chunk.after) {
+    range.push_back(fmt::format("{} > {}", pk, *chunk.after));
+  }
+  if (chunk.last) {
+    range.push_back(fmt::format("{} <= {}", pk, *chunk.last));
+  }
+
+  const auto sql = fmt::format(
+      "SELECT {} FROM {}.{}{}{} ORDER BY {}", columns, quoteIdentifier(db),
+      quoteIdentifier(schema.table_name), range.empty() ? "" : " WHERE ",
+      fmt::join(range, " AND "), pk
+  );
+  const auto result = connection.stream(sql);
+  const size_t width = mysql_num_fields(result.get());
+  std::vector<std::string_view> values(width);
+  ExtendedNode insert;
+
+  const auto submit = [&]() {
+    std::pmr::vector<components::document::document_ptr> docs(
+        insert.documents.begin(), insert.documents.end(), resource
+    );
+
+    insert.node = make_node_insert(
+        resource, collection_full_name_t(schema.collection_name, schema.table_name),
+        std::move(docs)
+    );
+    consumer.consume({&insert, 1});
+    insert = ExtendedNode{};
+  };
+
+  while (MYSQL_ROW row = mysql_fetch_row(result.get())) {
+    const auto* lengths = mysql_fetch_lengths(result.get());
+
+    for (size_t i = 0; i < width; ++i) {
+      values[i] = field(row, lengths, i);
+    }
+
+    auto doc = decoder.decodeText(values, resource);
+
+    insert.keys.emplace_back(doc->get_string(RowDecoder::PK_JSON_POINTER));
+    insert.documents.push_back(std::move(doc));
+
+    if (insert.documents.size() >= options.batch_documents) {
+      submit();
+    }
+  }
+
+  connection.checkFetched(sql);
+
+  if (!insert.documents.empty()) {
+    submit();
+  }
+}
+
+} // namespace cdc
@@ -0,0 +1,102 @@
+#include <cdc/row_decoder.hpp>
+#include <cdc/table_schema.hpp>
+
+#include <functional>
+#include <string_view>
+
+namespace cdc {
+
+TableSchema::TableSchema(const binlog::event::TableMapEvent& event) :
+    collection_name(event.m_dbnam),
+    table_name(event.m_tblnam),
+    column_types(event.m_coltype),
+    column_metatypes(event.m_field_metadata),
+    column_name_list(event.getColumnName()),
+    column_primary_key_list(event.getSimplePrimaryKey()),
+    column_signedness(event.getSignedness()),
+    width(event.column_count),
+    null_bits(event.m_null_bits),
+    optional_metadata(event.m_optional_metadata)
+{}
+
+TableSchema::TableSchema(
+    std::string collection_name, std::string table_name, std::string column_types,
+    std::string column_metatypes, std::vector<std::string> column_name_list,
+    std::vector<uint16_t> column_primary_key_list, std::string column_signedness
+) :
+    collection_name(std::move(collection_name)),
+    table_name(std::move(table_name)),
+    column_types(std::move(column_types)),
+    column_metatypes(std::move(column_metatypes)),
+    column_name_list(std::move(column_name_list)),
+    column_primary_key_list(std::move(column_primary_key_list)),
+    column_signedness(std::move(column_signedness)),
+    width(static_cast<int64_t>(this->column_types.size()))
+{}
+
+TableSchema::~TableSchema() = default;
+
+const RowDecoder& TableSchema::decoder() const
+{
+  // Diffs of one schema may be converted on several threads.
+  std::call_once(decoder_flag, [this]() {
+    compiled_decoder = std::make_unique<const RowDecoder>(*this);
+  });
+
+  return *compiled_decoder;
+}
+
+bool TableSchema::matches(const binlog::event::TableMapEvent& event) const noexcept
+{
+  return width == event.column_count && collection_name == event.m_dbnam &&
+         table_name == event.m_tblnam && column_types == event.m_coltype &&
+         column_metatypes == event.m_field_metadata && null_bits == event.m_null_bits &&
+         optional_metadata == event.m_optional_metadata;
+}
+
+TableSchema::SPtr TableSchemaCache::intern(const binlog::event::TableMapEvent& event)
+{
+  const auto hash = contentHash(event);
+  auto [begin, end] = schemas.equal_range(hash);
+
+  for (auto it = begin; it != end; ++it) {
+    if (it->second->matches(event)) {
+      return it->second;
+    }
+  }
+
+  auto schema = std::make_shared<const TableSchema>(event);
+
+  // A table has one definition at a time, the schema of the previous one is dropped.
+  std::erase_if(schemas, [&schema](const auto& entry) {
+    return entry.second->table_name == schema->table_name &&
+           entry.second->collection_name == schema->collection_name;
+  });
+  schemas.emplace(hash, schema);
+  return schema;
+}
+
+size_t TableSchemaCache::size() const noexcept
+{
+  return schemas.size();
+}
+
+uint64_t TableSchemaCache::contentHash(const binlog::event::TableMapEvent& event
+) noexcept
+{
+  const std::hash<std::string_view> hasher;
+  uint64_t hash = 0;
+
+  for (std::string_view part :
+       {std::string_view(event.m_dbnam), std::string_view(event.m_tblnam),
+        std::string_view(event.m_coltype), std::string_view(event.m_field_metadata),
+        std::string_view(event.m_null_bits), std::string_view(event.m_optional_metadata)})
+  {
+    // Boost-style combination keeps the order of the parts significant.
+    hash ^= hasher(part) + 0x9e3779b97f4a7c15ULL + (hash << 6) + (hash >> 2);
+  }
+
+  return hash;
+}
+
+} // namespace cdc
@@ -0,0 +1,250 @@
+#include <cdc/cdc.hpp>
+#include <cdc/verification.hpp>
+
+#include <functional>
+
+namespace {
+
+uint64_t mix(uint64_t value) noexcept
+{
+  value += 0x9e3779b97f4a7c15ULL;
+  value = (value ^ (value >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  value = (value ^ (value >> 27)) * 0x94d049bb133111ebULL;
+  return value ^ (value >> 31);
+}
+
+uint64_t fieldHash(std::string_view key, std::string_view value) noexcept
+{
+  const std::hash<std::string_view> hasher;
+  return mix(mix(hasher(key)) ^ hasher(value));
+}
+
+size_t skipSpaces(std::string_view json, size_t pos) noexcept
+{
+  while (pos < json.size() && std::isspace(static_cast<unsigned char>(json[pos]))) {
+    ++pos;
+  }
+  return pos;
+}
+
+/// Returns position next to the closing quote of the string started at `pos`.
+size_t skipString(std::string_view json, size_t pos) noexcept
+{
+  for (++pos; pos < json.size(); ++pos) {
+    if (json[pos] == '\\') {
+      ++pos;
+    } else if (json[pos] == '"') {
+      return pos + 1;
+    }
+  }
+  return json.size();
+}
+
+/// Returns position next to the end of the value started at `pos`.
+size_t skipValue(std::string_view json, size_t pos) noexcept
+{
+  int depth = 0;
+
+  while (pos < json.size()) {
+    const char ch = json[pos];
+
+    if (ch == '"') {
+      pos = skipString(json, pos);
+      if (depth == 0) {
+        return pos;
+      }
+      continue;
+    }
+    if (ch == '{' || ch == '[') {
+      ++depth;
+    } else if (ch == '}' || ch == ']') {
+      if (depth == 0) {
+        return pos;
+      }
+      if (--depth == 0) {
+        return pos + 1;
+      }
+    } else if (ch == ',' && depth == 0) {
+      return pos;
+    }
+    ++pos;
+  }
+  return pos;
+}
+
+/// Calls `func(key, value)` for every top level field of the JSON object. Both arguments
+/// are raw JSON tokens.
+template<typename Func>
+void forEachField(std::string_view json, Func&& func)
+{
+  size_t pos = skipSpaces(json, 0);
+
+  if (pos == json.size() || json[pos] != '{') {
+    return;
+  }
+  ++pos;
+
+  while (true) {
+    pos = skipSpaces(json, pos);
+    if (pos >= json.size() || json[pos] != '"') {
+      return;
+    }
+    const size_t key_end = skipString(json, pos);
+    const auto key = json.substr(pos, key_end - pos);
+
+    pos = skipSpaces(json, key_end);
+    if (pos >= json.size() || json[pos] != ':') {
+      return;
+    }
+    pos = skipSpaces(json, pos + 1);
+
+    const size_t value_end = skipValue(json, pos);
+    func(key, json.substr(pos, value_end - pos));
+
+    pos = skipSpaces(json, value_end);
+    if (pos >= json.size() || json[pos] != ',') {
+      return;
+    }
+    ++pos;
+  }
+}
+
+std::string collectionFullName(const cdc::node_ptr& node)
+{
+  return fmt::format("{}.{}", node->database_name(), node->collection_name());
+}
+
+} // namespace
+
+namespace cdc {
+
+void DigestTracker::apply(const ExtendedNode& extended_node)
+{
+  using components::logical_plan::node_type;
+
+  const auto& node = extended_node.node;
+
+  if (!node) {
+    return;
+  }
+
+  const auto collection = collectionFullName(node);
+
+  switch (node->type()) {
+  case node_type::insert_t:
+    for (size_t i = 0; i < extended_node.documents.size(); ++i) {
+      insert(collection, extended_node.keys[i], extended_node.documents[i]->to_json());
+    }
+    break;
+  case node_type::update_t: {
+    const auto json = extended_node.documents.front()->to_json();
+
+    for (const auto& key : extended_node.keys) {
+      update(collection, key, json);
+    }
+    break;
+  }
+  case node_type::delete_t:
+    for (const auto& key : extended_node.keys) {
+      erase(collection, key);
+    }
+    break;
+  default:
+    break;
+  }
+}
+
+void DigestTracker::insert(
+    const std::string& collection, const std::string& id, std::string_view json
+)
+{
+  auto& state = collections[collection];
+  auto [row_it, inserted] = state.rows.try_emplace(id);
+
+  if (!inserted) {
+    // Insert over an existing row replaces it.
+    erase(collection, id);
+    row_it = state.rows.try_emplace(id).first;
+  }
+
+  auto& fields = row_it->second;
+
+  forEachField(json, [&](std::string_view key, std::string_view value) {
+    const auto hash = fieldHash(key, value);
+    fields[std::string(key)] = hash;
+    state.digest.hash += hash;
+  });
+  ++state.digest.rows;
+}
+
+void DigestTracker::update(
+    const std::string& collection, const std::string& id, std::string_view json
+)
+{
+  auto state_it = collections.find(collection);
+
+  if (state_it == collections.end()) {
+    return;
+  }
+
+  auto& state = state_it->second;
+  auto row_it = state.rows.find(id);
+
+  if (row_it == state.rows.end()) {
+    return;
+  }
+
+  auto& fields = row_it->second;
+
+  forEachField(json, [&](std::string_view key, std::string_view value) {
+    const auto hash = fieldHash(key, value);
+    auto& field_hash = fields[std::string(key)];
+
+    state.digest.hash += hash - field_hash;
+    field_hash = hash;
+  });
+}
+
+void DigestTracker::erase(const std::string& collection, const std::string& id)
+{
+  auto state_it = collections.find(collection);
+
+  if (state_it == collections.end()) {
+    return;
+  }
+
+  auto& state = state_it->second;
+  auto row_it = state.rows.find(id);
+
+  if (row_it == state.rows.end()) {
+    return;
+  }
+
+  for (const auto& [key, hash] : row_it->second) {
+    state.digest.hash -= hash;
+  }
+  --state.digest.rows;
+  state.rows.erase(row_it);
+}
+
+CollectionDigest DigestTracker::digest(const std::string& collection) const
+{
+  auto state_it = collections.find(collection);
+
+  if (state_it == collections.end()) {
+    return {};
+  }
+  return state_it->second.digest;
+}
+
+uint64_t DigestTracker::documentHash(std::string_view json)
+{
+  uint64_t result = 0;
+
+  forEachField(json, [&](std::string_view key, std::string_view value) {
+    result += fieldHash(key, value);
+  });
+  return result;
+}
+
+} // namespace cdc
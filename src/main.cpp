@@ -1,5 +1,11 @@
 #include <binlog/binlog_reader.hpp>
+#include <cdc/binlog_index.hpp>
 #include <cdc/cdc.hpp>
+#include <cdc/file_source.hpp>
+#include <cdc/parallel_apply.hpp>
+#include <cdc/parallel_replay.hpp>
+#include <cdc/pipeline.hpp>
+#include <cdc/snapshot.hpp>
 #include <iostream>
 #include <sstream>
 
@@ -9,28 +15,334 @@ decltype(auto) uptr(Args&&... args)
   return std::make_unique<T>(std::forward<Args>(args)...);
 }
 
-int main(int argc, char** argv)
+struct Options {
+  conveyor::ExecutionMode mode{conveyor::ExecutionMode::SYNCHRONOUS};
+  /// Run the chain composed at compile time instead of `cdc::MainProcess`.
+  bool static_chain{false};
+  /// Connections copying the tables on the first start. `0` skips the snapshot.
+  size_t snapshot_workers{4};
+  /// Threads applying independent transactions concurrently. `0` applies them in order.
+  /// Not used by the static chain.
+  size_t apply_workers{0};
+  /// Threads applying plans of disjoint sets of rows. `0` applies them on one thread.
+  /// Not used by the static chain.
+  size_t apply_partitions{0};
+  cdc::IndexOptions indexes;
+  /// Binlog files replayed instead of the stream of the server.
+  std::vector<std::string> binlog_files;
+  /// Position the replay starts from without a checkpoint.
+  std::optional<cdc::BinlogPosition> replay_from;
+  /// Unix time the replay starts from without a checkpoint, found by the binlog indexes.
+  std::optional<uint32_t> replay_from_time;
+  /// Continue with the stream of the server where the replayed files end.
+  bool then_live{false};
+  /// Threads parsing chunks of the replayed files. `0` parses them in order.
+  /// Not used with `then_live` and by the static chain.
+  size_t replay_workers{0};
+};
+
+/// @returns Index described as `database.collection:field[,field...]`.
+cdc::SecondaryIndex parseIndex(std::string_view spec)
+{
+  const auto colon = spec.find(':');
+
+  if (colon == std::string_view::npos || colon == 0) {
+    THROW(std::invalid_argument, fmt::format("Invalid index '{}'", spec));
+  }
+
+  cdc::SecondaryIndex index{
+      .collection = std::string(spec.substr(0, colon)), .fields = {}
+  };
+  size_t begin = colon + 1;
+
+  while (true) {
+    const auto comma = std::min(spec.find(',', begin), spec.size());
+
+    if (comma == begin) {
+      THROW(std::invalid_argument, fmt::format("Empty field of index '{}'", spec));
+    }
+    index.fields.emplace_back(spec.substr(begin, comma - begin));
+
+    if (comma == spec.size()) {
+      return index;
+    }
+    begin = comma + 1;
+  }
+}
+
+/// @returns Position described as `file[:position]`.
+cdc::BinlogPosition parsePosition(std::string_view spec)
+{
+  const auto colon = spec.rfind(':');
+
+  if (colon == std::string_view::npos) {
+    return {std::string(spec)};
+  }
+
+  return {
+      std::string(spec.substr(0, colon)), std::stoull(std::string(spec.substr(colon + 1)))
+  };
+}
+
+/// Accepts `--mode=sync` (default), `--mode=pipelined`, `--mode=static`,
+/// `--snapshot-workers=N`, `--apply-workers=N`, `--apply-partitions=N`, `--no-pk-index`,
+/// `--index=database.collection:field[,field...]`, which may be repeated,
+/// `--replay=PATH` of a binlog directory, index or file, `--replay-from=FILE[:POS]`,
+/// `--replay-from-time=UNIX_TIME`, `--replay-workers=N` and `--then-live`.
+Options parseOptions(int argc, char** argv)
+{
+  Options options;
+
+  for (int i = 1; i < argc; ++i) {
+    const std::string_view arg(argv[i]);
+
+    if (arg == "--mode=sync") {
+      options.mode = conveyor::ExecutionMode::SYNCHRONOUS;
+    } else if (arg == "--mode=pipelined") {
+      options.mode = conveyor::ExecutionMode::PIPELINED;
+    } else if (arg == "--mode=static") {
+      options.static_chain = true;
+    } else if (arg.starts_with("--snapshot-workers=")) {
+      options.snapshot_workers = std::stoul(std::string(arg.substr(arg.find('=') + 1)));
+    } else if (arg.starts_with("--apply-workers=")) {
+      options.apply_workers = std::stoul(std::string(arg.substr(arg.find('=') + 1)));
+    } else if (arg.starts_with("--apply-partitions=")) {
+      options.apply_partitions = std::stoul(std::string(arg.substr(arg.find('=') + 1)));
+    } else if (arg == "--no-pk-index") {
+      options.indexes.primary_key = false;
+    } else if (arg.starts_with("--index=")) {
+      options.indexes.secondary.push_back(parseIndex(arg.substr(arg.find('=') + 1)));
+    } else if (arg.starts_with("--replay=")) {
+      options.binlog_files = cdc::BinlogFileBufferSource::discover(
+          std::string(arg.substr(arg.find('=') + 1))
+      );
+    } else if (arg.starts_with("--replay-from=")) {
+      options.replay_from = parsePosition(arg.substr(arg.find('=') + 1));
+    } else if (arg.starts_with("--replay-from-time=")) {
+      options.replay_from_time = std::stoul(std::string(arg.substr(arg.find('=') + 1)));
+    } else if (arg.starts_with("--replay-workers=")) {
+      options.replay_workers = std::stoul(std::string(arg.substr(arg.find('=') + 1)));
+    } else if (arg == "--then-live") {
+      options.then_live = true;
+    } else {
+      THROW(std::invalid_argument, fmt::format("Unknown argument '{}'", arg));
+    }
+  }
+
+  return options;
+}
+
+/// @returns Transactions applied before the checkpoint, empty without GTIDs.
+binlog::GtidSet appliedGtids(const std::optional<cdc::BinlogPosition>& start_position)
+{
+  return start_position ? binlog::GtidSet::parse(start_position->gtid_set)
+                        : binlog::GtidSet{};
+}
+
+/**
+ * @brief Copies the tables into the empty otterbrix of the first start and checkpoints
+ * the position of the copy, where the binlog stream starts.
+ */
+void loadSnapshot(
+    const Options& options, cdc::OtterBrixConsumerSink& consumer,
+    cdc::CheckpointStore& checkpoints, std::optional<cdc::BinlogPosition>& start_position
+)
+{
+  // Replayed files start from the beginning of the binlog.
+  if (start_position || options.snapshot_workers == 0 || !options.binlog_files.empty()) {
+    return;
+  }
+
+  cdc::SnapshotLoader loader(
+      "dbms", "root", "person", "e_store", 3306, {.workers = options.snapshot_workers}
+  );
+
+  start_position = loader.load(consumer);
+  checkpoints.commit(start_position.value());
+  checkpoints.flush();
+}
+
+/// @returns Position the replayed files start from, `std::nullopt` from their start.
+std::optional<cdc::BinlogPosition> replayFrom(
+    const Options& options, const std::optional<cdc::BinlogPosition>& start_position
+)
+{
+  // A restart resumes from the checkpoint, which may be in the files or after them.
+  if (start_position || !options.replay_from_time) {
+    return start_position ? start_position : options.replay_from;
+  }
+
+  auto replay_from =
+      cdc::BinlogIndex::seekTime(options.binlog_files, *options.replay_from_time);
+
+  if (!replay_from) {
+    THROW(
+        std::invalid_argument,
+        fmt::format("No transaction at {} or later", *options.replay_from_time)
+    );
+  }
+
+  return replay_from;
+}
+
+/// @returns Source of the replayed files if there are any, otherwise of the server.
+cdc::BufferSourceI::UPtr makeBufferSource(
+    const Options& options, cdc::PrefetchOptions prefetch_options,
+    const std::optional<cdc::BinlogPosition>& start_position
+)
 {
-  auto db_reader_source =
-      uptr<cdc::DBBufferSource>("dbms", "root", "person", "e_store", 3306);
-  auto event_source =
-      uptr<cdc::EventSource>(std::move(db_reader_source), [](const cdc::Binlog& ev) {
-      });
+  auto connect = [prefetch_options](std::optional<cdc::BinlogPosition> position) {
+    return uptr<cdc::DBBufferSource>(
+        "dbms", "root", "person", "e_store", 3306, prefetch_options, std::move(position)
+    );
+  };
+
+  if (options.binlog_files.empty()) {
+    return connect(start_position);
+  }
+
+  auto replay = uptr<cdc::BinlogFileBufferSource>(
+      options.binlog_files, replayFrom(options, start_position)
+  );
+
+  if (!options.then_live) {
+    return replay;
+  }
+
+  return uptr<cdc::CatchUpBufferSource>(
+      std::move(replay),
+      [connect](const cdc::BinlogPosition& position) {
+        return connect(position);
+      }
+  );
+}
+
+/// @returns Source of the transactions parsed from the buffers, or parsed by the replay
+/// workers from the replayed files.
+cdc::TransactionSourceI::UPtr makeTransactionSource(
+    const Options& options, const std::optional<cdc::BinlogPosition>& start_position,
+    const binlog::GtidSet& applied
+)
+{
+  const bool pipelined = options.mode == conveyor::ExecutionMode::PIPELINED;
+
+  // The live stream continues from the position of the replayed buffers.
+  if (options.replay_workers != 0 && !options.binlog_files.empty() &&
+      !options.then_live)
+  {
+    return uptr<cdc::ParallelReplaySource>(
+        options.binlog_files,
+        cdc::ParallelReplayOptions{.workers = options.replay_workers},
+        replayFrom(options, start_position), applied
+    );
+  }
+
+  // Prefetched buffers own their data, so the network waits overlap with parsing.
+  // Buffers of the replayed files own the mapping anyway.
+  auto buffer_source = makeBufferSource(options, {.enabled = pipelined}, start_position);
+  cdc::EventSourceI::UPtr event_source =
+      uptr<cdc::EventSource>(
+          std::move(buffer_source),
+          [](const cdc::Binlog& ev) {
+          },
+          applied
+      );
+
+  if (pipelined) {
+    event_source = uptr<conveyor::StagedSource<cdc::Binlog>>(std::move(event_source));
+  }
 
   auto table_diff_source = uptr<cdc::TableDiffSource>(
       std::move(event_source),
       [](const cdc::TableDiff& table_diff) {
+      },
+      applied
+  );
+
+  return uptr<cdc::TransactionSource>(
+      std::move(table_diff_source),
+      [](const cdc::TransactionBatch& transaction) {
       }
   );
+}
+
+void runStatic(const Options& options)
+{
+  auto checkpoints = std::make_shared<cdc::CheckpointStore>();
+  auto start_position = checkpoints->load();
+  cdc::OtterBrixConsumerSink otterbrix_consumer(
+      [](const cdc::ExtendedNode& e_node) {
+      },
+      {}, checkpoints, options.indexes
+  );
+
+  loadSnapshot(options, otterbrix_consumer, *checkpoints, start_position);
+
+  const auto applied = appliedGtids(start_position);
+
+  conveyor::Pipeline pipeline(
+      conveyor::SourceStage(makeBufferSource(options, {}, start_position)),
+      cdc::ParseStage(applied), cdc::TableDiffStage(applied), cdc::TransactionStage(),
+      cdc::PlanStage(otterbrix_consumer.resource()), cdc::ApplyStage(otterbrix_consumer)
+  );
+
+  pipeline.process();
+}
+
+int main(int argc, char** argv)
+{
+  const auto options = parseOptions(argc, argv);
+
+  if (options.static_chain) {
+    runStatic(options);
+    return 0;
+  }
 
-  auto otterbrix_consumer =
-      uptr<cdc::OtterBrixConsumerSink>([](const cdc::ExtendedNode& e_node) {
-      });
-  auto otterbrik_diff_sink = uptr<cdc::OtterBrixDiffSink>(
-      std::move(otterbrix_consumer), otterbrix_consumer->resource()
+  const bool pipelined = options.mode == conveyor::ExecutionMode::PIPELINED;
+  // Restart resumes from the last transaction applied to otterbrix.
+  auto checkpoints = std::make_shared<cdc::CheckpointStore>();
+  auto start_position = checkpoints->load();
+  auto otterbrix_consumer = uptr<cdc::OtterBrixConsumerSink>(
+      [](const cdc::ExtendedNode& e_node) {
+      },
+      cdc::VerificationOptions{}, checkpoints, options.indexes
   );
+
+  loadSnapshot(options, *otterbrix_consumer, *checkpoints, start_position);
+
+  const auto applied = appliedGtids(start_position);
+
+  auto transaction_source = makeTransactionSource(options, start_position, applied);
+
+  cdc::OtterBrixDiffSinkI::UPtr otterbrik_diff_sink;
+
+  if (options.apply_workers != 0) {
+    otterbrik_diff_sink = uptr<cdc::ParallelDiffSink>(
+        std::move(otterbrix_consumer),
+        cdc::ParallelApplyOptions{.workers = options.apply_workers}
+    );
+  } else {
+    auto* resource = otterbrix_consumer->resource();
+    const size_t partitions = std::max<size_t>(options.apply_partitions, 1);
+    cdc::OtterBrixConsumerI::UPtr consumer;
+
+    if (options.apply_partitions != 0) {
+      consumer = uptr<cdc::PartitionedConsumerSink>(
+          std::move(otterbrix_consumer), options.apply_partitions
+      );
+    } else if (pipelined) {
+      consumer =
+          uptr<conveyor::StagedSink<cdc::ExtendedNode>>(std::move(otterbrix_consumer));
+    } else {
+      consumer = std::move(otterbrix_consumer);
+    }
+
+    otterbrik_diff_sink = uptr<cdc::OtterBrixDiffSink>(
+        std::move(consumer), resource, cdc::PlanBatchOptions{.partitions = partitions}
+    );
+  }
   auto main_process = uptr<cdc::MainProcess>(
-      std::move(table_diff_source), std::move(otterbrik_diff_sink)
+      std::move(transaction_source), std::move(otterbrik_diff_sink), options.mode
   );
 
   main_process->process();
@@ -0,0 +1,91 @@
+#include <utils/buffer_pool.hpp>
+
+#include <cstring>
+
+namespace utils {
+
+std::shared_ptr<BufferPool> BufferPool::create(size_t max_cached_bytes)
+{
+  return std::shared_ptr<BufferPool>(new BufferPool(max_cached_bytes));
+}
+
+BufferPool::BufferPool(size_t max_cached_bytes) noexcept :
+    max_cached_bytes(max_cached_bytes)
+{}
+
+std::shared_ptr<char[]> BufferPool::acquire(size_t size)
+{
+  if (size > MAX_BLOCK_SIZE) {
+    return std::shared_ptr<char[]>(new char[size]);
+  }
+
+  const auto class_index = classIndex(size);
+  std::unique_ptr<char[]> block;
+
+  {
+    std::lock_guard lock(mutex);
+    auto& blocks = free_blocks[class_index];
+
+    if (!blocks.empty()) {
+      block = std::move(blocks.back());
+      blocks.pop_back();
+      cached_bytes -= MIN_BLOCK_SIZE << class_index;
+    }
+  }
+
+  if (!block) {
+    block = std::make_unique_for_overwrite<char[]>(MIN_BLOCK_SIZE << class_index);
+  }
+
+  return std::shared_ptr<char[]>(
+      block.release(),
+      [pool = shared_from_this(), class_index](char* released) {
+        pool->release(released, class_index);
+      }
+  );
+}
+
+SharedView BufferPool::copy(std::string_view data)
+{
+  auto block = acquire(data.size());
+
+  std::memcpy(block.get(), data.data(), data.size());
+
+  const std::string_view view(block.get(), data.size());
+  return SharedView(std::move(block), view);
+}
+
+size_t BufferPool::cachedBytes() const
+{
+  std::lock_guard lock(mutex);
+  return cached_bytes;
+}
+
+size_t BufferPool::classIndex(size_t size) noexcept
+{
+  if (size <= MIN_BLOCK_SIZE) {
+    return 0;
+  }
+
+  return std::bit_width(size - 1) - std::bit_width(MIN_BLOCK_SIZE - 1);
+}
+
+void BufferPool::release(char* block, size_t class_index) noexcept
+{
+  std::unique_ptr<char[]> holder(block);
+  const size_t block_size = MIN_BLOCK_SIZE << class_index;
+
+  std::lock_guard lock(mutex);
+
+  if (cached_bytes + block_size > max_cached_bytes) {
+    return;
+  }
+
+  try {
+    free_blocks[class_index].push_back(std::move(holder));
+    cached_bytes += block_size;
+  } catch (const std::bad_alloc&) {
+  }
+}
+
+} // namespace utils
@@ -0,0 +1,71 @@
+#include <utils/mapped_file.hpp>
+
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace utils {
+
+std::shared_ptr<const MappedFile>
+MappedFile::open(const std::string& path, bool sequential)
+{
+  const int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+
+  if (fd < 0) {
+    THROW(
+        MappedFileError, fmt::format("Can't open `{}`: {}", path, std::strerror(errno))
+    );
+  }
+
+  struct stat file_stat;
+
+  if (fstat(fd, &file_stat) != 0) {
+    const auto error = errno;
+    close(fd);
+    THROW(
+        MappedFileError, fmt::format("Can't stat `{}`: {}", path, std::strerror(error))
+    );
+  }
+
+  const auto size = static_cast<size_t>(file_stat.st_size);
+
+  // An empty file can't be mapped.
+  if (size == 0) {
+    close(fd);
+    return std::shared_ptr<const MappedFile>(new MappedFile(nullptr, 0));
+  }
+
+  void* address = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  const auto error = errno;
+
+  // The mapping stays valid after the descriptor is closed.
+  close(fd);
+
+  if (address == MAP_FAILED) {
+    THROW(
+        MappedFileError, fmt::format("Can't map `{}`: {}", path, std::strerror(error))
+    );
+  }
+  if (sequential) {
+    madvise(address, size, MADV_SEQUENTIAL);
+  }
+
+  return std::shared_ptr<const MappedFile>(new MappedFile(address, size));
+}
+
+MappedFile::MappedFile(void* address, size_t size) noexcept :
+    address(address),
+    size(size)
+{}
+
+MappedFile::~MappedFile()
+{
+  if (address) {
+    munmap(address, size);
+  }
+}
+
+} // namespace utils
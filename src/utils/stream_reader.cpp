@@ -1,34 +1,99 @@
 #include <utils/stream_reader.hpp>
 
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <unistd.h>
+
 namespace utils {
-StreamReader::StreamReader(std::istream& in) noexcept :
-    stream(in)
+StreamReader::StreamReader(std::istream& in, size_t block_size) :
+    stream(&in),
+    block_size(std::max<size_t>(block_size, 1)),
+    buffer(this->block_size)
+{}
+
+StreamReader::StreamReader(int fd, size_t block_size) :
+    stream(nullptr),
+    fd(fd),
+    block_size(std::max<size_t>(block_size, 1)),
+    buffer(this->block_size)
 {}
 
 void StreamReader::readCpy(char* dest, size_t size)
 {
-  const auto read_size = stream.readsome(dest, size);
+  peekCpy(dest, 0, size);
+  begin += size;
+}
 
-  if (size != read_size) {
+void StreamReader::peekCpy(char* dest, size_t offset, size_t size)
+{
+  if (!fill(offset + size)) {
     THROW(BadStream, "Attempt to read more than possible");
   }
+
+  std::memcpy(dest, buffer.data() + begin + offset, size);
 }
 
-void StreamReader::peekCpy(char* dest, size_t offset, size_t size)
+std::string_view StreamReader::readView(size_t size)
 {
-  const auto start_pos = stream.tellg();
+  if (!fill(size)) {
+    THROW(BadStream, "Attempt to read more than possible");
+  }
 
-  stream.seekg(offset, std::ios::cur);
-  readCpy(dest, size);
-  stream.seekg(start_pos);
+  const std::string_view view(buffer.data() + begin, size);
+  begin += size;
+
+  return view;
 }
 
-bool StreamReader::isEnd() noexcept
+bool StreamReader::isEnd()
 {
-  char buffer;
-  bool result = stream.readsome(&buffer, sizeof(buffer)) != sizeof(buffer);
-  stream.unget();
-  return result;
+  return !fill(1);
+}
+
+bool StreamReader::fill(size_t size)
+{
+  if (end - begin >= size) {
+    return true;
+  }
+
+  // The rest of the window moves to the start of the buffer, which grows for sequences
+  // longer than a block.
+  std::memmove(buffer.data(), buffer.data() + begin, end - begin);
+  end -= begin;
+  begin = 0;
+
+  if (buffer.size() < size) {
+    buffer.resize(size);
+  }
+
+  while (end < size && !input_end) {
+    const auto read_size = readInput(buffer.data() + end, buffer.size() - end);
+
+    input_end = read_size == 0;
+    end += read_size;
+  }
+
+  return end >= size;
+}
+
+size_t StreamReader::readInput(char* dest, size_t size)
+{
+  if (stream) {
+    stream->read(dest, static_cast<std::streamsize>(size));
+    return static_cast<size_t>(stream->gcount());
+  }
+
+  while (true) {
+    const auto read_size = ::read(fd, dest, size);
+
+    if (read_size >= 0) {
+      return static_cast<size_t>(read_size);
+    }
+    if (errno != EINTR) {
+      THROW(BadStream, fmt::format("Can't read the input: {}", std::strerror(errno)));
+    }
+  }
 }
 
-} // namespace utils
\ No newline at end of file
+} // namespace utils
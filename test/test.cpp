@@ -1,13 +1,30 @@
 #include <binlog/binlog_events.hpp>
 #include <binlog/binlog_reader.hpp>
+#include <cdc/binlog_index.hpp>
 #include <cdc/cdc.hpp>
+#include <cdc/checkpoint.hpp>
+#include <cdc/file_source.hpp>
+#include <cdc/parallel_apply.hpp>
+#include <cdc/parallel_replay.hpp>
+#include <cdc/pipeline.hpp>
+#include <cdc/table_schema.hpp>
+#include <utils/buffer_pool.hpp>
+#include <utils/spsc_ring.hpp>
 #include <utils/stream_reader.hpp>
 #include <utils/string_buffer_reader.hpp>
 
 #include <array>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
 #include <fstream>
 #include <gtest/gtest.h>
 #include <iostream>
+#include <numeric>
+#include <set>
+#include <thread>
+#include <unistd.h>
 
 #define READ(reader, value) ((value) = reader.read<decltype(value)>())
 #define PEEK(reader, value, ...) ((value) = reader.peek<decltype(value)>(__VA_ARGS__))
@@ -243,6 +260,219 @@ TEST(StreamReader, All)
   }
 }
 
+TEST(StreamReader, Blocks)
+{
+  using namespace utils;
+  std::string data(64, '\0');
+  std::iota(data.begin(), data.end(), 0);
+
+  // Sequences cross the blocks and are longer than them.
+  auto check = [&data](StreamReader& reader) {
+    EXPECT_EQ(reader.peek<uint32_t>(2), 0x05040302);
+    EXPECT_EQ(reader.read<uint16_t>(), 0x0100);
+    EXPECT_EQ(reader.readView(10), std::string_view(data).substr(2, 10));
+    EXPECT_EQ(reader.peek<char>(49), 61);
+    EXPECT_EQ(reader.readView(50), std::string_view(data).substr(12, 50));
+    EXPECT_FALSE(reader.isEnd());
+    EXPECT_EQ(reader.read<uint16_t>(), 0x3f3e);
+    EXPECT_TRUE(reader.isEnd());
+    EXPECT_THROW(reader.read<char>(), BadStream);
+  };
+
+  std::istringstream stream(data);
+  StreamReader stream_reader(stream, 3);
+  check(stream_reader);
+
+  // A pipe returns the data as they are written.
+  int fds[2];
+  ASSERT_EQ(pipe(fds), 0);
+  std::thread writer([&]() {
+    for (size_t offset = 0; offset < data.size(); offset += 7) {
+      const auto size = std::min<size_t>(7, data.size() - offset);
+      EXPECT_EQ(write(fds[1], data.data() + offset, size), size);
+    }
+    close(fds[1]);
+  });
+
+  StreamReader pipe_reader(fds[0], 4);
+  check(pipe_reader);
+  writer.join();
+  close(fds[0]);
+}
+
+TEST(SpscRing, Order)
+{
+  utils::SpscRing<std::unique_ptr<int>> ring(3);
+  constexpr int count = 100000;
+
+  std::thread producer([&]() {
+    for (int i = 0; i < count; ++i) {
+      ring.push(std::make_unique<int>(i));
+    }
+  });
+
+  for (int i = 0; i < count; ++i) {
+    ASSERT_EQ(*ring.pop(), i);
+  }
+  producer.join();
+  EXPECT_FALSE(ring.tryPop().has_value());
+}
+
+TEST(BufferPool, Reuse)
+{
+  auto pool = utils::BufferPool::create(1024 * 1024);
+  const char* first_block;
+
+  {
+    auto view = pool->copy("binlog event");
+    first_block = view.data();
+
+    EXPECT_TRUE(view.owned());
+    EXPECT_EQ(view.view(), "binlog event");
+    EXPECT_EQ(pool->cachedBytes(), 0);
+  }
+  EXPECT_EQ(pool->cachedBytes(), utils::BufferPool::MIN_BLOCK_SIZE);
+
+  // The block of the same class is reused, the block of a bigger class is new.
+  auto same_class = pool->copy("another event");
+  auto bigger_class = pool->acquire(utils::BufferPool::MIN_BLOCK_SIZE + 1);
+
+  EXPECT_EQ(same_class.data(), first_block);
+  EXPECT_EQ(pool->cachedBytes(), 0);
+
+  // Blocks may outlive the pool owner and are released on any thread.
+  pool.reset();
+  std::thread([block = std::move(bigger_class)]() mutable {
+    block.reset();
+  }).join();
+  EXPECT_EQ(same_class.slice(8).view(), "event");
+}
+
+namespace {
+struct CounterSource final : conveyor::Source<int> {
+  explicit CounterSource(int limit) :
+      limit(limit)
+  {}
+
+protected:
+  virtual std::optional<int> getDataImpl() final override
+  {
+    if (current == limit) {
+      return std::nullopt;
+    }
+    return current++;
+  }
+
+private:
+  int limit;
+  int current{0};
+};
+
+/// @brief Static stage passing on the even numbers squared.
+struct EvenSquareStage {
+  template<typename Emit>
+  void operator()(int data, Emit&& emit)
+  {
+    if (data % 2 == 0) {
+      emit(data * data);
+    }
+  }
+};
+
+/// @brief Static stage collecting items, flushed after every portion of the head.
+struct CollectorStage {
+  template<typename Emit>
+  void operator()(int data, Emit&&)
+  {
+    pending.push_back(data);
+  }
+
+  template<typename Emit>
+  void flush(Emit&&)
+  {
+    result.insert(result.end(), pending.begin(), pending.end());
+    pending.clear();
+    ++flushes;
+  }
+
+  std::vector<int> pending;
+  std::vector<int> result;
+  size_t flushes{0};
+};
+
+struct CollectorSink final : conveyor::Sink<int> {
+  explicit CollectorSink(std::vector<int>& result) :
+      result(result)
+  {}
+
+protected:
+  virtual void putDataImpl(const int& data) final override
+  {
+    result.push_back(data);
+  }
+
+private:
+  std::vector<int>& result;
+};
+} // namespace
+
+TEST(Conveyor, BatchAdapters)
+{
+  CounterSource source(10);
+  std::vector<int> batch;
+
+  EXPECT_EQ(source.getBatch(batch, 4), 4);
+  EXPECT_EQ(source.getBatch(batch, 100), 6);
+  EXPECT_EQ(source.getBatch(batch, 100), 0);
+
+  std::vector<int> result;
+  CollectorSink sink(result);
+
+  sink.putBatch(batch);
+  EXPECT_EQ(result, batch);
+  EXPECT_EQ(result.size(), 10);
+}
+
+TEST(Conveyor, StaticPipeline)
+{
+  conveyor::Pipeline pipeline(
+      conveyor::SourceStage(std::make_unique<CounterSource>(10), 4), EvenSquareStage{},
+      CollectorStage{}
+  );
+
+  pipeline.process();
+
+  EXPECT_EQ(pipeline.stage<2>().result, std::vector<int>({0, 4, 16, 36, 64}));
+  EXPECT_TRUE(pipeline.stage<2>().pending.empty());
+  // Portions of 4, 4 and 2 items and the empty one at the end of data.
+  EXPECT_EQ(pipeline.stage<2>().flushes, 4);
+}
+
+TEST(Conveyor, PipelinedOrder)
+{
+  constexpr int count = 10000;
+  std::vector<int> expected(count);
+  std::iota(expected.begin(), expected.end(), 0);
+
+  for (auto mode :
+       {conveyor::ExecutionMode::SYNCHRONOUS, conveyor::ExecutionMode::PIPELINED})
+  {
+    std::vector<int> result;
+    conveyor::Source<int>::UPtr source = std::make_unique<CounterSource>(count);
+    conveyor::Sink<int>::UPtr sink = std::make_unique<CollectorSink>(result);
+
+    if (mode == conveyor::ExecutionMode::PIPELINED) {
+      source = std::make_unique<conveyor::StagedSource<int>>(std::move(source), 4);
+      sink = std::make_unique<conveyor::StagedSink<int>>(std::move(sink), 4);
+    }
+
+    conveyor::Universal<int> process(std::move(source), std::move(sink), mode, 4);
+    process.process();
+
+    EXPECT_EQ(result, expected);
+  }
+}
+
 TEST(BinlogReader, FormatDescriptionEvent)
 {
   binlog::event::FormatDescriptionEvent fde_start(
@@ -303,7 +533,18 @@ TEST(BinlogReader, FormatDescriptionEvent)
   EXPECT_EQ(fde_event.created, 1749148873UL);
   EXPECT_EQ(fde_event.common_header_len, 19UL);
   EXPECT_EQ(fde_event.post_header_len, expected_post_header_len);
-  EXPECT_TRUE(fde_event.has_checksum);
+  // The server writes the events without checksums.
+  EXPECT_EQ(fde_event.checksum_alg, binlog::BINLOG_CHECKSUM_ALG_OFF);
+  EXPECT_FALSE(fde_event.has_checksum);
+
+  std::string crc32_buffer(fde_buffer, fde_size);
+  crc32_buffer[fde_size - binlog::CHECKSUM_CRC32_SIGNATURE_LEN - 1] =
+      binlog::BINLOG_CHECKSUM_ALG_CRC32;
+  utils::StringBufferReader crc32_reader(crc32_buffer);
+  binlog::event::FormatDescriptionEvent crc32_event(crc32_reader, &fde_start);
+
+  EXPECT_EQ(crc32_event.post_header_len, expected_post_header_len);
+  EXPECT_TRUE(crc32_event.has_checksum);
 }
 
 TEST(BinlogReader, RotateEvent)
@@ -388,39 +629,833 @@ TEST(BinlogReader, TableMapEvent)
   EXPECT_EQ(std::memcmp(signedness.data(), "\x80", 1), 0);
 }
 
-TEST(BinlogReader, WriteRowsEvent)
+TEST(BinlogReader, WriteRowsEvent)
+{
+  binlog::event::FormatDescriptionEvent fde_start(
+      binlog::BINLOG_VERSION, binlog::SERVER_VERSION
+  );
+
+  const char wr_buffer[] =
+      "\x59\x0e\x42\x68\x17\x01\x0a\x0b\x0c\x2f\x00\x00\x00\x05\x00\x00\x00\x00\x00\x12"
+      "\x0A\x01\x02\x03\x0f\x01\x00\x02\x03\xfc\x01\x00\x00\x00\x00\x00\x00\x00\x07\x00"
+      "\x53\x61\x6d\x73\x75\x6e\x67";
+  const auto wr_size = sizeof(wr_buffer) - 1;
+  utils::StringBufferReader reader(wr_buffer, wr_size);
+
+  binlog::event::WriteRowsEvent wr_event(reader, &fde_start);
+
+  EXPECT_EQ(wr_event.header.when, 1749159513UL);
+  EXPECT_EQ(wr_event.header.type_code, 23UL);
+  EXPECT_EQ(wr_event.header.unmasked_server_id, 202050049UL);
+  EXPECT_EQ(wr_event.header.data_written, 47UL);
+  EXPECT_EQ(wr_event.header.log_pos, 5UL);
+  EXPECT_EQ(wr_event.header.flags, 0UL);
+
+  EXPECT_EQ(wr_event.m_type, wr_event.header.type_code);
+  EXPECT_EQ(wr_event.m_table_id, 16505592941074UL);
+  EXPECT_EQ(wr_event.m_flags, 1UL);
+  EXPECT_EQ(wr_event.m_width, 2UL);
+  EXPECT_EQ(wr_event.n_bits_len, 1);
+  EXPECT_EQ(std::memcmp(wr_event.columns_before_image.data(), "\x03", 1), 0);
+  EXPECT_EQ(std::memcmp(wr_event.columns_after_image.data(), "\x03", 1), 0);
+
+  const char expected_row[] =
+      "\xfc\x01\x00\x00\x00\x00\x00\x00\x00\x07\x00\x53\x61\x6d\x73\x75\x6e\x67";
+  EXPECT_EQ(std::memcmp(wr_event.row.data(), expected_row, sizeof(expected_row) - 1), 0);
+}
+
+TEST(BinlogReader, WriteRowsEventSharedRow)
+{
+  binlog::event::FormatDescriptionEvent fde_start(
+      binlog::BINLOG_VERSION, binlog::SERVER_VERSION
+  );
+
+  const char wr_buffer[] =
+      "\x59\x0e\x42\x68\x17\x01\x0a\x0b\x0c\x2f\x00\x00\x00\x05\x00\x00\x00\x00\x00\x12"
+      "\x0A\x01\x02\x03\x0f\x01\x00\x02\x03\xfc\x01\x00\x00\x00\x00\x00\x00\x00\x07\x00"
+      "\x53\x61\x6d\x73\x75\x6e\x67";
+  const auto wr_size = sizeof(wr_buffer) - 1;
+  const auto row_offset = 29;
+  auto pool = utils::BufferPool::create(1024);
+  auto buffer = pool->copy(std::string_view(wr_buffer, wr_size));
+
+  utils::StringBufferReader copying_reader(buffer.data(), buffer.size());
+  binlog::event::WriteRowsEvent copied(copying_reader, &fde_start);
+
+  utils::StringBufferReader sharing_reader(buffer.data(), buffer.size());
+  binlog::event::WriteRowsEvent shared(sharing_reader, &fde_start, buffer.owner());
+
+  EXPECT_EQ(copied.row.view(), shared.row.view());
+  EXPECT_NE(copied.row.data(), buffer.data() + row_offset);
+  EXPECT_EQ(shared.row.data(), buffer.data() + row_offset);
+
+  // The block goes back to the pool only when the row is released too.
+  buffer = {};
+  EXPECT_EQ(pool->cachedBytes(), 0);
+  shared.row = {};
+  EXPECT_EQ(pool->cachedBytes(), utils::BufferPool::MIN_BLOCK_SIZE);
+}
+
+TEST(Verification, DigestTracker)
+{
+  cdc::DigestTracker first;
+  cdc::DigestTracker second;
+
+  first.insert("db.coll", "1", R"({"_id": "1", "name": "a", "value": 1})");
+  first.insert("db.coll", "2", R"({"_id": "2", "name": "b,}", "value": [1, 2]})");
+  first.insert("db.coll", "3", R"({"_id": "3", "name": "c", "value": 3})");
+  first.update("db.coll", "1", R"({"name": "z"})");
+  first.erase("db.coll", "3");
+
+  second.insert("db.coll", "2", R"({"value": [1, 2], "_id": "2", "name": "b,}"})");
+  second.insert("db.coll", "1", R"({"_id": "1", "name": "z", "value": 1})");
+
+  EXPECT_EQ(first.digest("db.coll"), second.digest("db.coll"));
+  EXPECT_EQ(first.digest("db.coll").rows, 2);
+  EXPECT_EQ(
+      first.digest("db.coll").hash,
+      cdc::DigestTracker::documentHash(R"({"_id": "1", "name": "z", "value": 1})") +
+          cdc::DigestTracker::documentHash(R"({"_id":"2","name":"b,}","value":[1, 2]})")
+  );
+
+  second.update("db.coll", "1", R"({"name": "y"})");
+  EXPECT_NE(first.digest("db.coll"), second.digest("db.coll"));
+  EXPECT_EQ(first.digest("db.other"), cdc::CollectionDigest{});
+}
+
+namespace {
+const char TABLE_MAP_BUFFER[] =
+      "\x59\x0e\x42\x68\x13\x01\x0a\x00\x00\x49\x00\x00\x00\x00\x00\x00\x00\x00\x00\x12"
+      "\x00\x00\x00\x00\xff\x01\x00\x07\x65\x5f\x73\x74\x6f\x72\x65\x00\x06\x62\x72\x61"
+      "\x6e\x64\x73\x00\x02\x08\x0f\x02\xe8\x03\x00\x01\x01\x80\x02\x03\xfc\x00\x09\x04"
+      "\x09\x03\x5f\x69\x64\x04\x6e\x61\x6d\x65\x08\x01\x00";
+
+const char WRITE_ROWS_BUFFER[] =
+      "\x59\x0e\x42\x68\x17\x01\x0a\x0b\x0c\x2f\x00\x00\x00\x05\x00\x00\x00\x00\x00\x12"
+      "\x0A\x01\x02\x03\x0f\x01\x00\x02\x03\xfc\x01\x00\x00\x00\x00\x00\x00\x00\x07\x00"
+      "\x53\x61\x6d\x73\x75\x6e\x67";
+
+template<typename Event, size_t Size>
+std::unique_ptr<Event> parseEvent(const char (&buffer)[Size])
+{
+  binlog::event::FormatDescriptionEvent fde_start(
+      binlog::BINLOG_VERSION, binlog::SERVER_VERSION
+  );
+  utils::StringBufferReader reader(buffer, Size - 1);
+
+  return std::make_unique<Event>(reader, &fde_start);
+}
+} // namespace
+
+TEST(TableSchema, Interning)
+{
+  using binlog::event::TableMapEvent;
+  const auto first = parseEvent<TableMapEvent>(TABLE_MAP_BUFFER);
+  const auto second = parseEvent<TableMapEvent>(TABLE_MAP_BUFFER);
+  auto renamed = parseEvent<TableMapEvent>(TABLE_MAP_BUFFER);
+  renamed->m_tblnam = "models";
+
+  cdc::TableSchemaCache cache;
+  const auto schema = cache.intern(*first);
+
+  EXPECT_EQ(cache.intern(*second), schema);
+  EXPECT_NE(cache.intern(*renamed), schema);
+  EXPECT_EQ(cache.size(), 2);
+
+  // The schema of an altered table replaces the previous one.
+  auto altered = parseEvent<TableMapEvent>(TABLE_MAP_BUFFER);
+  for (auto& bits : altered->m_null_bits) {
+    bits = static_cast<char>(~bits);
+  }
+  EXPECT_NE(cache.intern(*altered), schema);
+  EXPECT_EQ(cache.size(), 2);
+  EXPECT_NE(cache.intern(*first), schema);
+  EXPECT_EQ(cache.size(), 2);
+
+  EXPECT_EQ(schema->collection_name, "e_store");
+  EXPECT_EQ(schema->table_name, "brands");
+  EXPECT_EQ(schema->width, 2);
+  EXPECT_EQ(schema->column_name_list, std::vector<std::string>({"_id", "name"}));
+  EXPECT_EQ(schema->column_primary_key_list, std::vector<uint16_t>({0}));
+}
+
+TEST(TableSchema, SeveralRowsEventsPerTableMap)
+{
+  using namespace binlog::event;
+  auto table_map = parseEvent<TableMapEvent>(TABLE_MAP_BUFFER);
+  const auto table_id = table_map->m_table_id;
+
+  cdc::TableDiffAssembler assembler;
+  EXPECT_FALSE(assembler.process(std::move(table_map)).has_value());
+
+  std::vector<cdc::TableDiff> diffs;
+
+  for (int i = 0; i < 2; ++i) {
+    auto rows = parseEvent<WriteRowsEvent>(WRITE_ROWS_BUFFER);
+    rows->m_table_id = table_id;
+
+    auto diff = assembler.process(std::move(rows));
+    ASSERT_TRUE(diff.has_value());
+    diffs.push_back(std::move(diff.value()));
+  }
+
+  EXPECT_EQ(diffs[0].type, cdc::TableDiff::INSERT);
+  EXPECT_EQ(diffs[0].schema, diffs[1].schema);
+  EXPECT_EQ(diffs[0].schema->table_name, "brands");
+}
+
+TEST(RowDecoder, CompiledProgram)
+{
+  using namespace binlog::event;
+  const auto table_map = parseEvent<TableMapEvent>(TABLE_MAP_BUFFER);
+  const auto rows = parseEvent<WriteRowsEvent>(WRITE_ROWS_BUFFER);
+  std::pmr::synchronized_pool_resource resource;
+
+  cdc::TableSchemaCache cache;
+  const auto schema = cache.intern(*table_map);
+  const auto& decoder = schema->decoder();
+
+  EXPECT_EQ(&schema->decoder(), &decoder);
+  EXPECT_EQ(decoder.primaryKeyIndex(), 0);
+
+  // The row of the event and a row with NULL in `name`.
+  std::string images(rows->row.view());
+  images += std::string_view("\xfe\x02\x00\x00\x00\x00\x00\x00\x00", 9);
+  utils::StringBufferReader row_r(images);
+
+  const auto first = decoder.decode(row_r, &resource);
+  const auto second = decoder.decode(row_r, &resource);
+
+  EXPECT_EQ(first->get_string("/_id"), "000000000000000000000001");
+  EXPECT_EQ(first->get_string("/name"), "Samsung");
+  EXPECT_EQ(second->get_string("/_id"), "000000000000000000000002");
+  EXPECT_EQ(row_r.available(), 0);
+
+  // Keys are extracted in the same form, and whole images are skipped.
+  utils::StringBufferReader key_r(images);
+
+  EXPECT_EQ(decoder.extractKey(key_r), "000000000000000000000001");
+  EXPECT_EQ(decoder.extractKey(key_r), "000000000000000000000002");
+  EXPECT_EQ(key_r.available(), 0);
+}
+
+TEST(RowDecoder, TextRows)
+{
+  using namespace binlog::event;
+  const auto table_map = parseEvent<TableMapEvent>(TABLE_MAP_BUFFER);
+  std::pmr::synchronized_pool_resource resource;
+
+  // Rows read by `SELECT` give the same documents as the row images.
+  cdc::TableSchemaCache cache;
+  const auto row = std::array<std::string_view, 2>{"1", "Samsung"};
+  const auto doc = cache.intern(*table_map)->decoder().decodeText(row, &resource);
+
+  EXPECT_EQ(doc->get_string("/_id"), "000000000000000000000001");
+  EXPECT_EQ(doc->get_string("/name"), "Samsung");
+
+  // Columns described by `information_schema`: BIGINT UNSIGNED, CHAR(4) of utf8mb4, INT,
+  // DATE, which isn't supported, and DOUBLE.
+  const cdc::TableSchema described(
+      "e_store", "items", "\x08\xfe\x03\xf3\x05", std::string("\xfe\x10\x08", 3),
+      {"_id", "code", "count", "created", "price"}, {0}, "\x80"
+  );
+  const auto& decoder = described.decoder();
+  auto values = std::array<std::string_view, 5>{"7", "ab", "-3", {}, "0.5"};
+  const auto text_doc = decoder.decodeText(values, &resource);
+
+  EXPECT_EQ(text_doc->get_string("/_id"), "000000000000000000000007");
+  EXPECT_EQ(text_doc->get_string("/code"), "ab  ");
+  EXPECT_EQ(text_doc->get_long("/count"), -3);
+  EXPECT_TRUE(text_doc->is_null("/created"));
+  EXPECT_EQ(text_doc->get_double("/price"), 0.5);
+
+  values[3] = "2024-01-01";
+  EXPECT_THROW(decoder.decodeText(values, &resource), cdc::RowDecoder::RowDecoderError);
+  values[3] = {};
+  values[2] = "x";
+  EXPECT_THROW(decoder.decodeText(values, &resource), cdc::RowDecoder::RowDecoderError);
+  values[0] = {};
+  EXPECT_THROW(decoder.decodeText(values, &resource), cdc::RowDecoder::RowDecoderError);
+}
+
+TEST(RowDecoder, UpdateChanges)
+{
+  using namespace binlog::event;
+  const auto table_map = parseEvent<TableMapEvent>(TABLE_MAP_BUFFER);
+  const auto rows = parseEvent<WriteRowsEvent>(WRITE_ROWS_BUFFER);
+  std::pmr::synchronized_pool_resource resource;
+
+  cdc::TableSchemaCache cache;
+  const auto& decoder = cache.intern(*table_map)->decoder();
+
+  // Null bitmap, `_id` and `name` of `Samsung` with 2 bytes of length.
+  const std::string before(rows->row.view());
+  const std::string renamed = before.substr(0, 9) + std::string("\x02\x00LG", 4);
+  const std::string nulled = "\xfe" + before.substr(1, 8);
+  const auto decode = [&](const std::string& after, std::vector<uint8_t> after_columns) {
+    const auto images = before + after;
+    utils::StringBufferReader row_r(images);
+    auto update = decoder.decodeUpdate(row_r, {}, after_columns, &resource);
+
+    EXPECT_EQ(row_r.available(), 0);
+    EXPECT_EQ(update.key, "000000000000000000000001");
+    return update.changes;
+  };
+
+  EXPECT_EQ(decode(before, {}), nullptr);
+
+  const auto changes = decode(renamed, {});
+  ASSERT_NE(changes, nullptr);
+  EXPECT_EQ(changes->get_string("/name"), "LG");
+  EXPECT_FALSE(changes->is_exists("/_id"));
+
+  ASSERT_NE(decode(nulled, {}), nullptr);
+  EXPECT_TRUE(decode(nulled, {})->is_null("/name"));
+
+  // Only `_id` is in the after-image.
+  EXPECT_EQ(decode(before.substr(0, 9), {0x01}), nullptr);
+
+  // `binlog_row_image=MINIMAL`: the before-image has `_id` only, so every column of the
+  // after-image is a change.
+  const std::vector<uint8_t> key_only = {0x01};
+  const std::string minimal = std::string(1, '\0') + before.substr(1, 8);
+  const auto images = minimal + renamed;
+  utils::StringBufferReader row_r(images);
+  const auto update = decoder.decodeUpdate(row_r, key_only, {}, &resource);
+
+  EXPECT_EQ(update.key, "000000000000000000000001");
+  ASSERT_NE(update.changes, nullptr);
+  EXPECT_EQ(update.changes->get_string("/name"), "LG");
+  EXPECT_EQ(row_r.available(), 0);
+
+  utils::StringBufferReader key_r(minimal);
+  const auto doc = decoder.decode(key_r, &resource, key_only);
+
+  EXPECT_EQ(doc->get_string("/_id"), "000000000000000000000001");
+  EXPECT_FALSE(doc->is_exists("/name"));
+}
+
+TEST(PlanBuilder, CoalescedRows)
+{
+  using namespace binlog::event;
+  using Keys = std::vector<std::string>;
+  const auto table_map = parseEvent<TableMapEvent>(TABLE_MAP_BUFFER);
+  std::pmr::synchronized_pool_resource resource;
+
+  cdc::TableSchemaCache cache;
+  const auto schema = cache.intern(*table_map);
+  const auto row = [](uint8_t id) {
+    // `name` is NULL.
+    return utils::SharedView::copy(
+        std::string("\xfe") + std::string(1, id) + std::string(7, '\0')
+    );
+  };
+  const auto key = [](char id) {
+    return std::string(23, '0') + id;
+  };
+
+  cdc::PlanBuilder builder(&resource, {.max_documents = 3});
+  std::vector<cdc::ExtendedNode> nodes;
+
+  builder.convert({cdc::TableDiff::INSERT, schema, row(3)}, nodes);
+  builder.convert({cdc::TableDiff::INSERT, schema, row(1)}, nodes);
+  EXPECT_TRUE(nodes.empty());
+
+  // Deletes must not overtake the inserts before them and are matched at once.
+  builder.convert({cdc::TableDiff::DELETE, schema, row(3)}, nodes);
+  ASSERT_EQ(nodes.size(), 1);
+  EXPECT_EQ(nodes[0].keys, (Keys{key('1'), key('3')}));
+  ASSERT_EQ(nodes[0].documents.size(), 2);
+  EXPECT_EQ(nodes[0].documents[0]->get_string("/_id"), std::string_view(key('1')));
+
+  builder.convert({cdc::TableDiff::DELETE, schema, row(1)}, nodes);
+  builder.flushPending(nodes);
+  ASSERT_EQ(nodes.size(), 2);
+  EXPECT_EQ(nodes[1].keys, (Keys{key('1'), key('3')}));
+  EXPECT_TRUE(nodes[1].documents.empty());
+
+  nodes.clear();
+  for (uint8_t id = 4; id < 8; ++id) {
+    builder.convert({cdc::TableDiff::INSERT, schema, row(id)}, nodes);
+  }
+  EXPECT_EQ(nodes.size(), 1);
+  builder.flushPending(nodes);
+  ASSERT_EQ(nodes.size(), 2);
+  EXPECT_EQ(nodes[1].keys, Keys{key('7')});
+}
+
+TEST(PlanBuilder, DeleteInserted)
+{
+  using namespace binlog::event;
+  const auto table_map = parseEvent<TableMapEvent>(TABLE_MAP_BUFFER);
+  std::pmr::synchronized_pool_resource resource;
+
+  cdc::TableSchemaCache cache;
+  const auto schema = cache.intern(*table_map);
+  std::string rows;
+
+  for (char id = 3; id > 0; --id) {
+    rows += std::string("\xfe") + id + std::string(7, '\0');
+  }
+
+  cdc::PlanBuilder builder(&resource);
+  std::vector<cdc::ExtendedNode> nodes;
+
+  builder.convert(
+      {cdc::TableDiff::INSERT, schema, utils::SharedView::copy(rows)}, nodes
+  );
+  builder.flushPending(nodes);
+  ASSERT_EQ(nodes.size(), 1);
+
+  std::vector<cdc::ExtendedNode> deletes;
+
+  builder.deleteInserted(nodes[0], deletes);
+  ASSERT_EQ(deletes.size(), 1);
+  EXPECT_EQ(deletes[0].keys, nodes[0].keys);
+  EXPECT_TRUE(deletes[0].documents.empty());
+}
+
+TEST(PlanBuilder, Partitions)
+{
+  using namespace binlog::event;
+  const auto table_map = parseEvent<TableMapEvent>(TABLE_MAP_BUFFER);
+  std::pmr::synchronized_pool_resource resource;
+
+  cdc::TableSchemaCache cache;
+  const auto schema = cache.intern(*table_map);
+  std::string rows;
+
+  for (char id = 1; id <= 16; ++id) {
+    rows += std::string("\xfe") + id + std::string(7, '\0');
+  }
+
+  cdc::PlanBuilder builder(&resource, {.partitions = 4});
+  std::vector<cdc::ExtendedNode> nodes;
+
+  builder.convert(
+      {cdc::TableDiff::INSERT, schema, utils::SharedView::copy(rows)}, nodes
+  );
+  builder.flushPending(nodes);
+  ASSERT_GT(nodes.size(), 1);
+
+  // Every partition gets one plan with all of its rows.
+  std::set<size_t> partitions;
+  size_t keys = 0;
+
+  for (const auto& node : nodes) {
+    EXPECT_LT(node.partition, 4);
+    EXPECT_TRUE(partitions.insert(node.partition).second);
+    keys += node.keys.size();
+  }
+  EXPECT_EQ(keys, 16);
+
+  // Deletes of the same rows go to the partitions of the inserts.
+  std::vector<cdc::ExtendedNode> deletes;
+
+  builder.convert(
+      {cdc::TableDiff::DELETE, schema, utils::SharedView::copy(rows)}, deletes
+  );
+  builder.flushPending(deletes);
+  ASSERT_EQ(deletes.size(), nodes.size());
+
+  for (const auto& node : nodes) {
+    const auto it = std::find_if(deletes.begin(), deletes.end(), [&](const auto& other) {
+      return other.partition == node.partition;
+    });
+
+    ASSERT_NE(it, deletes.end());
+    EXPECT_EQ(it->keys, node.keys);
+  }
+}
+
+TEST(PlanBuilder, CheckpointMarkers)
+{
+  using namespace binlog::event;
+  const auto table_map = parseEvent<TableMapEvent>(TABLE_MAP_BUFFER);
+  const auto rows = parseEvent<WriteRowsEvent>(WRITE_ROWS_BUFFER);
+  std::pmr::synchronized_pool_resource resource;
+
+  cdc::TableSchemaCache cache;
+  const auto schema = cache.intern(*table_map);
+  const auto commit = [](uint64_t position) {
+    return cdc::TableDiff{
+        .type = cdc::TableDiff::COMMIT,
+        .position = cdc::BinlogPosition{"binlog.000001", position}
+    };
+  };
+
+  cdc::PlanBuilder builder(&resource);
+  std::vector<cdc::ExtendedNode> nodes;
+
+  builder.convert(commit(100), nodes);
+  ASSERT_EQ(nodes.size(), 1);
+  EXPECT_EQ(nodes[0].node, nullptr);
+  EXPECT_EQ(nodes[0].checkpoint->position, 100);
+
+  // The marker waits for the pending rows of its transaction.
+  nodes.clear();
+  builder.convert({cdc::TableDiff::INSERT, schema, rows->row}, nodes);
+  builder.convert(commit(200), nodes);
+  builder.convert(commit(300), nodes);
+  EXPECT_TRUE(nodes.empty());
+
+  builder.flushPending(nodes);
+  ASSERT_EQ(nodes.size(), 2);
+  EXPECT_EQ(nodes[0].keys.size(), 1);
+  EXPECT_EQ(nodes[1].checkpoint, (cdc::BinlogPosition{"binlog.000001", 300}));
+}
+
+TEST(TransactionAssembler, Grouping)
+{
+  using namespace binlog::event;
+  const auto table_map = parseEvent<TableMapEvent>(TABLE_MAP_BUFFER);
+  const auto rows = parseEvent<WriteRowsEvent>(WRITE_ROWS_BUFFER);
+
+  cdc::TableSchemaCache cache;
+  const auto schema = cache.intern(*table_map);
+  const auto commit = [](uint64_t position) {
+    return cdc::TableDiff{
+        .type = cdc::TableDiff::COMMIT,
+        .position = cdc::BinlogPosition{"binlog.000001", position}
+    };
+  };
+
+  cdc::TransactionAssembler assembler;
+
+  EXPECT_FALSE(assembler.process({cdc::TableDiff::INSERT, schema, rows->row}));
+  EXPECT_FALSE(assembler.process({cdc::TableDiff::DELETE, schema, rows->row}));
+
+  auto transaction = assembler.process(commit(100));
+  ASSERT_TRUE(transaction);
+  ASSERT_EQ(transaction->diffs.size(), 3);
+  EXPECT_EQ(transaction->diffs[0].type, cdc::TableDiff::INSERT);
+  EXPECT_EQ(transaction->diffs[1].type, cdc::TableDiff::DELETE);
+  EXPECT_EQ(transaction->diffs[2].position->position, 100);
+
+  // Transactions without rows still pass their position on.
+  transaction = assembler.process(commit(200));
+  ASSERT_TRUE(transaction);
+  ASSERT_EQ(transaction->diffs.size(), 1);
+  EXPECT_EQ(transaction->diffs[0].position->position, 200);
+
+  EXPECT_FALSE(assembler.process({cdc::TableDiff::UPDATE, schema, rows->row}));
+}
+
+namespace {
+/// @returns Query event without status variables and a database.
+std::string makeQueryEvent(std::string_view text, uint32_t log_pos = 0)
+{
+  using namespace binlog::event;
+  std::string event(binlog::LOG_EVENT_HEADER_LEN + QUERY_HEADER_LEN + 1, '\0');
+  event += text;
+  const auto event_size = static_cast<uint32_t>(event.size());
+
+  event[binlog::EVENT_TYPE_OFFSET] = static_cast<char>(QUERY_EVENT);
+  std::memcpy(event.data() + binlog::DATA_WRITTEN_OFFSET, &event_size, 4);
+  std::memcpy(event.data() + binlog::LOG_POS_OFFSET, &log_pos, 4);
+
+  return event;
+}
+} // namespace
+
+TEST(TableDiffAssembler, Boundaries)
+{
+  using namespace binlog::event;
+  const auto query = [](std::string_view text, uint32_t log_pos) -> cdc::Binlog {
+    const auto event = makeQueryEvent(text, log_pos);
+    FormatDescriptionEvent fde(binlog::BINLOG_VERSION, binlog::SERVER_VERSION);
+    utils::StringBufferReader reader(event);
+
+    return std::make_unique<QueryEvent>(reader, &fde);
+  };
+  const auto begin_size = binlog::LOG_EVENT_HEADER_LEN + QUERY_HEADER_LEN + 1 + 5;
+  const auto table_map = [] {
+    return parseEvent<TableMapEvent>(TABLE_MAP_BUFFER);
+  };
+  const auto rows = [&]() -> cdc::Binlog {
+    auto event = parseEvent<WriteRowsEvent>(WRITE_ROWS_BUFFER);
+
+    event->m_table_id = table_map()->m_table_id;
+    return event;
+  };
+
+  cdc::TableDiffAssembler assembler;
+
+  EXPECT_FALSE(assembler.process(table_map()));
+  EXPECT_FALSE(assembler.process(query("CREATE TABLE t (id INT)", 100)));
+
+  // Rows without a commit event end before the next transaction.
+  EXPECT_TRUE(assembler.process(rows()));
+  auto diff = assembler.process(query("BEGIN", 300));
+  ASSERT_TRUE(diff);
+  EXPECT_EQ(diff->type, cdc::TableDiff::COMMIT);
+  EXPECT_EQ(diff->position->position, 300 - begin_size);
+
+  // Non-transactional tables commit with a query.
+  EXPECT_TRUE(assembler.process(rows()));
+  diff = assembler.process(query("COMMIT", 500));
+  ASSERT_TRUE(diff);
+  EXPECT_EQ(diff->type, cdc::TableDiff::COMMIT);
+  EXPECT_EQ(diff->position->position, 500);
+
+  EXPECT_FALSE(assembler.finish());
+
+  // Rows at the end of the stream are dropped.
+  cdc::TransactionAssembler transactions;
+
+  EXPECT_FALSE(transactions.process(*assembler.process(rows())));
+  diff = assembler.finish();
+  ASSERT_TRUE(diff);
+  EXPECT_EQ(diff->type, cdc::TableDiff::ROLLBACK);
+  EXPECT_FALSE(transactions.process(std::move(*diff)));
+  EXPECT_FALSE(assembler.finish());
+
+  // The next transaction has none of them.
+  EXPECT_FALSE(transactions.process(*assembler.process(rows())));
+  const auto transaction =
+      transactions.process(*assembler.process(query("COMMIT", 700)));
+  ASSERT_TRUE(transaction);
+  EXPECT_EQ(transaction->diffs.size(), 2);
+}
+
+TEST(Checkpoint, Store)
+{
+  const auto dir = std::filesystem::temp_directory_path() / "cdc_checkpoint_test";
+  const auto path = (dir / "checkpoint").string();
+  std::filesystem::remove_all(dir);
+
+  {
+    cdc::CheckpointStore store({.path = path, .flush_interval = std::chrono::hours(1)});
+
+    EXPECT_FALSE(store.load().has_value());
+
+    // The first position is written at once, the next ones once per interval.
+    store.commit({"binlog.000001", 120});
+    EXPECT_EQ(store.load(), (cdc::BinlogPosition{"binlog.000001", 120}));
+    store.commit({"binlog.000002", 4});
+    EXPECT_EQ(store.load(), (cdc::BinlogPosition{"binlog.000001", 120}));
+    // The applied position is recorded at every commit.
+    EXPECT_EQ(store.loadApplied(), (cdc::BinlogPosition{"binlog.000002", 4}));
+    store.commit({"binlog.000002", 340, "3e11fa47-71ca-11e1-9e33-c80aa9429562:1-5"});
+    EXPECT_EQ(store.loadApplied(), (cdc::BinlogPosition{"binlog.000002", 340}));
+  }
+
+  cdc::CheckpointStore store({.path = path});
+
+  EXPECT_EQ(
+      store.load(), (cdc::BinlogPosition{
+                        "binlog.000002", 340, "3e11fa47-71ca-11e1-9e33-c80aa9429562:1-5"
+                    })
+  );
+  EXPECT_FALSE(std::filesystem::exists(path + ".tmp"));
+
+  // Checkpoints without GTIDs have no third line.
+  std::ofstream(path) << "binlog.000003\n4\n";
+  EXPECT_EQ(store.load(), (cdc::BinlogPosition{"binlog.000003", 4}));
+
+  std::ofstream(path) << "binlog.000003\n";
+  EXPECT_THROW(store.load(), cdc::CheckpointStore::CheckpointError);
+
+  std::ofstream(path + ".applied") << "binlog.000003\n";
+  EXPECT_FALSE(store.loadApplied().has_value());
+
+  EXPECT_TRUE(cdc::binlogPositionBefore({"binlog.000002", 340}, {"binlog.000003", 4}));
+  EXPECT_TRUE(cdc::binlogPositionBefore({"binlog.000003", 4}, {"binlog.000003", 120}));
+  EXPECT_FALSE(cdc::binlogPositionBefore({"binlog.000003", 4}, {"binlog.000003", 4}));
+
+  std::filesystem::remove_all(dir);
+}
+
+namespace {
+const binlog::Uuid SERVER_UUID{{
+    0x3e, 0x11, 0xfa, 0x47, 0x71, 0xca, 0x11, 0xe1, 0x9e, 0x33, 0xc8, 0x0a, 0xa9, 0x42,
+    0x95, 0x62
+}};
+
+const char GTID_5_BUFFER[] =
+      "\x59\x0e\x42\x68\x21\x01\x00\x00\x00\x49\x00\x00\x00\xed\x03\x00\x00\x00\x00\x01"
+      "\x3e\x11\xfa\x47\x71\xca\x11\xe1\x9e\x33\xc8\x0a\xa9\x42\x95\x62\x05\x00\x00\x00"
+      "\x00\x00\x00\x00\x02\x04\x00\x00\x00\x00\x00\x00\x00\x05\x00\x00\x00\x00\x00\x00"
+      "\x00\x40\x88\x6d\xef\xd9\x36\x06\xc8\xa4\x38\x01\x00";
+
+const char GTID_6_BUFFER[] =
+      "\x59\x0e\x42\x68\x21\x01\x00\x00\x00\x49\x00\x00\x00\xee\x03\x00\x00\x00\x00\x01"
+      "\x3e\x11\xfa\x47\x71\xca\x11\xe1\x9e\x33\xc8\x0a\xa9\x42\x95\x62\x06\x00\x00\x00"
+      "\x00\x00\x00\x00\x02\x05\x00\x00\x00\x00\x00\x00\x00\x06\x00\x00\x00\x00\x00\x00"
+      "\x00\x40\x88\x6d\xef\xd9\x36\x06\xc8\xa4\x38\x01\x00";
+
+const char XID_BUFFER[] =
+      "\x59\x0e\x42\x68\x10\x01\x00\x00\x00\x1b\x00\x00\x00\x08\x04\x00\x00\x00\x00"
+      "\x2a\x00\x00\x00\x00\x00\x00\x00";
+} // namespace
+
+TEST(GtidSet, Intervals)
+{
+  auto set = binlog::GtidSet::parse(
+      "3E11FA47-71CA-11E1-9E33-C80AA9429562:1-5:7,\n"
+      "11111111-1111-1111-1111-111111111111:3"
+  );
+
+  EXPECT_EQ(
+      set.toString(), "11111111-1111-1111-1111-111111111111:3,"
+                      "3e11fa47-71ca-11e1-9e33-c80aa9429562:1-5:7"
+  );
+  EXPECT_TRUE(binlog::GtidSet::parse("").empty());
+  EXPECT_THROW(binlog::GtidSet::parse("3e11fa47:1"), binlog::GtidSet::GtidSetError);
+  EXPECT_THROW(
+      binlog::GtidSet::parse("3e11fa47-71ca-11e1-9e33-c80aa9429562:5-1"),
+      binlog::GtidSet::GtidSetError
+  );
+
+  // Adding the gap joins the intervals.
+  EXPECT_FALSE(set.contains(SERVER_UUID, 6));
+  set.add(SERVER_UUID, 6);
+  set.add(SERVER_UUID, 9);
+  EXPECT_TRUE(set.contains(SERVER_UUID, 6));
+  EXPECT_FALSE(set.contains(SERVER_UUID, 8));
+  EXPECT_EQ(
+      set.toString(), "11111111-1111-1111-1111-111111111111:3,"
+                      "3e11fa47-71ca-11e1-9e33-c80aa9429562:1-7:9"
+  );
+
+  std::string encoded(set.encodedSize(), '\0');
+  set.encode(reinterpret_cast<unsigned char*>(encoded.data()));
+  utils::StringBufferReader reader(encoded);
+  EXPECT_EQ(binlog::GtidSet::decode(reader), set);
+  EXPECT_EQ(reader.available(), 0);
+
+  auto merged = binlog::GtidSet::parse("3e11fa47-71ca-11e1-9e33-c80aa9429562:1-2");
+  merged.merge(set);
+  EXPECT_EQ(merged, set);
+}
+
+TEST(BinlogReader, GtidEvent)
+{
+  const auto gtid_event = parseEvent<binlog::event::GtidEvent>(GTID_5_BUFFER);
+
+  EXPECT_EQ(gtid_event->header.type_code, binlog::event::GTID_LOG_EVENT);
+  EXPECT_EQ(gtid_event->header.log_pos, 1005);
+  EXPECT_TRUE(gtid_event->may_have_sbr_stmts);
+  EXPECT_EQ(gtid_event->tsid_parent_struct.m_uuid, SERVER_UUID);
+  EXPECT_EQ(gtid_event->gtid_info_struct.rpl_gtid_gno, 5);
+  EXPECT_EQ(gtid_event->last_committed, 4);
+  EXPECT_EQ(gtid_event->sequence_number, 5);
+  EXPECT_EQ(gtid_event->immediate_commit_timestamp, 1749159513000000);
+  EXPECT_EQ(gtid_event->original_commit_timestamp, 1749159513000000);
+  EXPECT_EQ(gtid_event->transaction_length, 200);
+  EXPECT_EQ(gtid_event->immediate_server_version, 80036);
+  EXPECT_EQ(gtid_event->original_server_version, 80036);
+}
+
+TEST(BinlogReader, SkipAppliedTransactions)
+{
+  cdc::EventParser parser(
+      binlog::GtidSet::parse("3e11fa47-71ca-11e1-9e33-c80aa9429562:1-5")
+  );
+  const auto parse = [&]<size_t Size>(const char(&buffer)[Size]) {
+    return parser.parse(cdc::Buffer(buffer, Size - 1));
+  };
+
+  // Events of an applied transaction are dropped up to the next GTID event.
+  EXPECT_EQ(parse(GTID_5_BUFFER), nullptr);
+  EXPECT_EQ(parse(TABLE_MAP_BUFFER), nullptr);
+  EXPECT_EQ(parse(WRITE_ROWS_BUFFER), nullptr);
+
+  EXPECT_NE(parse(GTID_6_BUFFER), nullptr);
+  EXPECT_NE(parse(TABLE_MAP_BUFFER), nullptr);
+}
+
+TEST(BinlogReader, LogicalClock)
+{
+  using namespace binlog::event;
+  cdc::TableDiffAssembler assembler;
+
+  EXPECT_FALSE(assembler.process(parseEvent<GtidEvent>(GTID_5_BUFFER)));
+
+  auto commit = assembler.process(parseEvent<XidEvent>(XID_BUFFER));
+  ASSERT_TRUE(commit);
+  EXPECT_EQ(commit->position->position, 1032);
+  ASSERT_TRUE(commit->clock);
+  EXPECT_EQ(commit->clock->last_committed, 4);
+  EXPECT_EQ(commit->clock->sequence_number, 5);
+
+  // The clock belongs to the transaction of the GTID event only.
+  commit = assembler.process(parseEvent<XidEvent>(XID_BUFFER));
+  ASSERT_TRUE(commit);
+  EXPECT_FALSE(commit->clock);
+}
+
+TEST(TableDiffAssembler, RestartedTransaction)
+{
+  using namespace binlog::event;
+  const auto rows = []() -> cdc::Binlog {
+    auto event = parseEvent<WriteRowsEvent>(WRITE_ROWS_BUFFER);
+
+    event->m_table_id = parseEvent<TableMapEvent>(TABLE_MAP_BUFFER)->m_table_id;
+    return event;
+  };
+
+  cdc::TableDiffAssembler assembler;
+  cdc::TransactionAssembler transactions;
+  const auto process = [&](cdc::Binlog&& event) {
+    auto diff = assembler.process(std::move(event));
+    return diff ? transactions.process(std::move(diff.value())) : std::nullopt;
+  };
+
+  EXPECT_FALSE(process(parseEvent<GtidEvent>(GTID_5_BUFFER)));
+  EXPECT_FALSE(process(parseEvent<TableMapEvent>(TABLE_MAP_BUFFER)));
+  EXPECT_FALSE(process(rows()));
+
+  // A reconnect sends the transaction again from its start.
+  auto diff = assembler.process(parseEvent<GtidEvent>(GTID_5_BUFFER));
+  ASSERT_TRUE(diff);
+  EXPECT_EQ(diff->type, cdc::TableDiff::ROLLBACK);
+  EXPECT_FALSE(transactions.process(std::move(diff.value())));
+
+  EXPECT_FALSE(process(parseEvent<TableMapEvent>(TABLE_MAP_BUFFER)));
+  EXPECT_FALSE(process(rows()));
+
+  auto transaction = process(parseEvent<XidEvent>(XID_BUFFER));
+  ASSERT_TRUE(transaction);
+  ASSERT_EQ(transaction->diffs.size(), 2);
+  EXPECT_EQ(transaction->diffs[0].type, cdc::TableDiff::INSERT);
+
+  // Rows without a commit event end before the next GTID event.
+  EXPECT_FALSE(process(rows()));
+
+  const auto gtid_6 = parseEvent<GtidEvent>(GTID_6_BUFFER);
+  const auto gtid_6_start = gtid_6->header.log_pos - gtid_6->header.data_written;
+
+  transaction = process(parseEvent<GtidEvent>(GTID_6_BUFFER));
+  ASSERT_TRUE(transaction);
+  ASSERT_EQ(transaction->diffs.size(), 2);
+  EXPECT_EQ(transaction->diffs[1].position->position, gtid_6_start);
+}
+
+TEST(TableDiffAssembler, RemappedTable)
 {
-  binlog::event::FormatDescriptionEvent fde_start(
-      binlog::BINLOG_VERSION, binlog::SERVER_VERSION
-  );
-
-  const char wr_buffer[] =
-      "\x59\x0e\x42\x68\x17\x01\x0a\x0b\x0c\x2f\x00\x00\x00\x05\x00\x00\x00\x00\x00\x12"
-      "\x0A\x01\x02\x03\x0f\x01\x00\x02\x03\xfc\x01\x00\x00\x00\x00\x00\x00\x00\x07\x00"
-      "\x53\x61\x6d\x73\x75\x6e\x67";
-  const auto wr_size = sizeof(wr_buffer) - 1;
-  utils::StringBufferReader reader(wr_buffer, wr_size);
+  using namespace binlog::event;
+  const auto rows = [](uint64_t table_id) -> cdc::Binlog {
+    auto event = parseEvent<WriteRowsEvent>(WRITE_ROWS_BUFFER);
 
-  binlog::event::WriteRowsEvent wr_event(reader, &fde_start);
+    event->m_table_id = table_id;
+    return event;
+  };
+  auto remapped = parseEvent<TableMapEvent>(TABLE_MAP_BUFFER);
+  const auto table_id = remapped->m_table_id;
+  remapped->m_table_id = table_id + 1;
 
-  EXPECT_EQ(wr_event.header.when, 1749159513UL);
-  EXPECT_EQ(wr_event.header.type_code, 23UL);
-  EXPECT_EQ(wr_event.header.unmasked_server_id, 202050049UL);
-  EXPECT_EQ(wr_event.header.data_written, 47UL);
-  EXPECT_EQ(wr_event.header.log_pos, 5UL);
-  EXPECT_EQ(wr_event.header.flags, 0UL);
+  cdc::TableDiffAssembler assembler;
 
-  EXPECT_EQ(wr_event.m_type, wr_event.header.type_code);
-  EXPECT_EQ(wr_event.m_table_id, 16505592941074UL);
-  EXPECT_EQ(wr_event.m_flags, 1UL);
-  EXPECT_EQ(wr_event.m_width, 2UL);
-  EXPECT_EQ(wr_event.n_bits_len, 1);
-  EXPECT_EQ(std::memcmp(wr_event.columns_before_image.data(), "\x03", 1), 0);
-  EXPECT_EQ(std::memcmp(wr_event.columns_after_image.data(), "\x03", 1), 0);
+  EXPECT_FALSE(assembler.process(parseEvent<TableMapEvent>(TABLE_MAP_BUFFER)));
+  EXPECT_TRUE(assembler.process(rows(table_id)));
 
-  const char expected_row[] =
-      "\xfc\x01\x00\x00\x00\x00\x00\x00\x00\x07\x00\x53\x61\x6d\x73\x75\x6e\x67";
-  EXPECT_EQ(std::memcmp(wr_event.row.data(), expected_row, sizeof(expected_row) - 1), 0);
+  // The table is opened again under another id, the old one is forgotten.
+  EXPECT_FALSE(assembler.process(std::move(remapped)));
+  EXPECT_TRUE(assembler.process(rows(table_id + 1)));
+  EXPECT_THROW(
+      assembler.process(rows(table_id)), cdc::TableDiffAssembler::TableDiffSourceError
+  );
 }
 
 namespace cdc {
@@ -467,11 +1502,38 @@ private:
 };
 
 struct TestOtterBrixConsumerSink final : OtterBrixConsumerSink {
-  TestOtterBrixConsumerSink() :
-      OtterBrixConsumerSink([](const ExtendedNode&) {
-      })
+  explicit TestOtterBrixConsumerSink(IndexOptions index_options = {}) :
+      OtterBrixConsumerSink(
+          [](const ExtendedNode&) {
+          },
+          VerificationOptions{.enabled = true, .sample_interval = 0}, nullptr,
+          std::move(index_options)
+      )
   {}
 
+  /// @returns Error of creating the index of the fields in `e_store.table`, `none` if it
+  /// is created.
+  components::cursor::error_code_t tryCreateIndex(const std::vector<std::string>& fields)
+  {
+    using namespace components::logical_plan;
+    auto* resource = this->resource();
+    auto node = make_node_create_index(
+        resource, collection_full_name_t("e_store", "table"),
+        fmt::format("{}_idx", fmt::join(fields, "_")),
+        fields.size() == 1 ? index_type::single : index_type::composite
+    );
+
+    for (const auto& field : fields) {
+      node->keys().push_back(components::expressions::key_t{field});
+    }
+
+    auto cursor = otterbrix_service->dispatcher()->execute_plan(
+        otterbrix::session_id_t(), node, make_parameter_node(resource)
+    );
+    return cursor->is_success() ? components::cursor::error_code_t::none
+                                : cursor->get_error().type;
+  }
+
   void testFinalState()
   {
     auto cur = otterbrix_service->dispatcher()->execute_sql(
@@ -567,6 +1629,39 @@ struct TestOtterBrixConsumerSink final : OtterBrixConsumerSink {
     }
   }
 };
+
+/// @brief Counts the plans executed at once.
+struct OverlapOtterBrixConsumerSink final : OtterBrixConsumerSink {
+  OverlapOtterBrixConsumerSink() :
+      OtterBrixConsumerSink([](const ExtendedNode&) {
+      })
+  {}
+
+  std::atomic<size_t> running{0};
+  std::atomic<size_t> peak{0};
+
+protected:
+  components::cursor::cursor_t_ptr execute(
+      node_ptr node, parameter_node_ptr params, const otterbrix::session_id_t& session
+  ) override
+  {
+    using namespace std::chrono_literals;
+    const auto now = ++running;
+    auto seen = peak.load();
+
+    while (seen < now && !peak.compare_exchange_weak(seen, now)) {
+    }
+    // Gives another worker the time to start a plan of its own.
+    const auto until = std::chrono::steady_clock::now() + 50ms;
+    while (running < 2 && std::chrono::steady_clock::now() < until) {
+      std::this_thread::yield();
+    }
+
+    auto cursor = OtterBrixConsumerSink::execute(node, params, session);
+    --running;
+    return cursor;
+  }
+};
 } // namespace cdc
 
 template<typename T, typename... Args>
@@ -600,6 +1695,530 @@ std::string getFileData(const char* file_path)
   return result;
 }
 
+/// @returns The events, written without checksums, as a server with
+/// `binlog_checksum=CRC32` writes them.
+std::string withChecksums(std::string_view events)
+{
+  auto crc32 = [](std::string_view data) {
+    uint32_t crc = 0xffffffff;
+
+    for (unsigned char byte : data) {
+      crc ^= byte;
+      for (int bit = 0; bit < 8; ++bit) {
+        crc = (crc >> 1) ^ (0xedb88320 & (0 - (crc & 1)));
+      }
+    }
+    return ~crc;
+  };
+  std::string result;
+  uint32_t added = 0;
+
+  while (!events.empty()) {
+    uint32_t size;
+    std::memcpy(&size, events.data() + binlog::DATA_WRITTEN_OFFSET, sizeof(size));
+    std::string event(events.substr(0, size));
+    events.remove_prefix(size);
+
+    // The format description event always ends with a checksum, after the algorithm.
+    if (event[binlog::EVENT_TYPE_OFFSET] == binlog::event::FORMAT_DESCRIPTION_EVENT) {
+      event.resize(event.size() - binlog::CHECKSUM_CRC32_SIGNATURE_LEN);
+      event.back() = binlog::BINLOG_CHECKSUM_ALG_CRC32;
+    } else {
+      added += binlog::CHECKSUM_CRC32_SIGNATURE_LEN;
+    }
+
+    uint32_t log_pos;
+    size = event.size() + binlog::CHECKSUM_CRC32_SIGNATURE_LEN;
+    std::memcpy(&log_pos, event.data() + binlog::LOG_POS_OFFSET, sizeof(log_pos));
+    log_pos += log_pos != 0 ? added : 0;
+    std::memcpy(event.data() + binlog::DATA_WRITTEN_OFFSET, &size, sizeof(size));
+    std::memcpy(event.data() + binlog::LOG_POS_OFFSET, &log_pos, sizeof(log_pos));
+
+    const auto crc = crc32(event);
+    result += event;
+    result.append(reinterpret_cast<const char*>(&crc), sizeof(crc));
+  }
+
+  return result;
+}
+
+TEST(BinlogFileBufferSource, MappedEvents)
+{
+  const auto path = "../../static/binlog/test2.bin";
+  const auto events_buffer = getFileData(path);
+  binlog::event::FormatDescriptionEvent fde(
+      binlog::BINLOG_VERSION, binlog::SERVER_VERSION
+  );
+  std::vector<cdc::Buffer> expected;
+
+  cdc::TestBufferSource expected_source(events_buffer.data(), events_buffer.size());
+  while (auto buffer = expected_source.getData()) {
+    expected.push_back(std::move(*buffer));
+  }
+  ASSERT_GT(expected.size(), 2);
+
+  cdc::BinlogFileBufferSource source({path});
+  std::vector<cdc::Buffer> buffers;
+
+  while (source.getBatch(buffers, 16) != 0) {
+  }
+  ASSERT_EQ(buffers.size(), expected.size() + 1);
+
+  utils::StringBufferReader reader(buffers[0].data(), buffers[0].size());
+  binlog::event::RotateEvent rotate_event(reader, &fde);
+  EXPECT_EQ(rotate_event.new_log_ident, "test2.bin");
+  EXPECT_EQ(rotate_event.pos, 4);
+
+  // Buffers view the mapping and keep it alive.
+  for (size_t i = 0; i < expected.size(); ++i) {
+    EXPECT_TRUE(buffers[i + 1].owned());
+    EXPECT_EQ(buffers[i + 1].view(), expected[i].view());
+  }
+
+  // Resuming passes the format description event and jumps to the position.
+  const auto position = expected[0].size() + expected[1].size();
+  cdc::BinlogFileBufferSource resumed({path}, cdc::BinlogPosition{"test2.bin", position});
+  buffers.clear();
+
+  ASSERT_EQ(resumed.getBatch(buffers, 3), 3);
+  utils::StringBufferReader resumed_reader(buffers[0].data(), buffers[0].size());
+  EXPECT_EQ(binlog::event::RotateEvent(resumed_reader, &fde).pos, position);
+  EXPECT_EQ(buffers[1].view(), expected[0].view());
+  EXPECT_EQ(buffers[2].view(), expected[2].view());
+
+  // Files before the start position are skipped.
+  cdc::BinlogFileBufferSource skipped({path}, cdc::BinlogPosition{"test3.bin"});
+  EXPECT_FALSE(skipped.getData());
+  // The events of a missing start file can't be replayed.
+  EXPECT_THROW(
+      cdc::BinlogFileBufferSource({path}, cdc::BinlogPosition{"test1.bin"}),
+      cdc::BinlogFileBufferSource::BinlogFileError
+  );
+}
+
+TEST(BinlogFileBufferSource, FileOrder)
+{
+  EXPECT_TRUE(cdc::binlogFileBefore("mysql-bin.999999", "mysql-bin.1000000"));
+  EXPECT_FALSE(cdc::binlogFileBefore("mysql-bin.1000000", "mysql-bin.999999"));
+  EXPECT_TRUE(cdc::binlogFileBefore("mysql-bin.000009", "mysql-bin.000010"));
+  EXPECT_FALSE(cdc::binlogFileBefore("mysql-bin.000010", "mysql-bin.000010"));
+
+  const std::vector<std::string> paths{
+      "/binlog/mysql-bin.999998", "/binlog/mysql-bin.999999", "/binlog/mysql-bin.1000000"
+  };
+  EXPECT_EQ(
+      cdc::BinlogFileBufferSource::startFile(paths, {"mysql-bin.1000000", 4}), 2
+  );
+  EXPECT_EQ(cdc::BinlogFileBufferSource::startFile(paths, {"mysql-bin.1000001", 4}), 3);
+  EXPECT_THROW(
+      cdc::BinlogFileBufferSource::startFile(paths, {"mysql-bin.999997", 4}),
+      cdc::BinlogFileBufferSource::BinlogFileError
+  );
+}
+
+TEST(BinlogFileBufferSource, FollowRotate)
+{
+  const auto events = getFileData("../../static/binlog/test2.bin");
+  const auto dir = std::filesystem::temp_directory_path() / "cdc_replay_test";
+  std::filesystem::remove_all(dir);
+  std::filesystem::create_directories(dir);
+
+  const std::string magic("\xfe\x62\x69\x6e", 4);
+  const std::string next_file = "binlog.000003";
+  // Rotate event without a checksum, as the format description event of test2.bin
+  // describes.
+  std::string rotate(binlog::LOG_EVENT_HEADER_LEN + 8 + next_file.size(), '\0');
+  const auto rotate_size = static_cast<uint32_t>(rotate.size());
+  const uint64_t rotate_pos = 4;
+  rotate[binlog::EVENT_TYPE_OFFSET] = binlog::event::ROTATE_EVENT;
+  std::memcpy(rotate.data() + binlog::DATA_WRITTEN_OFFSET, &rotate_size, 4);
+  std::memcpy(rotate.data() + binlog::LOG_POS_OFFSET, &rotate_size, 4);
+  std::memcpy(rotate.data() + binlog::LOG_EVENT_HEADER_LEN, &rotate_pos, 8);
+  std::memcpy(rotate.data() + binlog::LOG_EVENT_HEADER_LEN + 8, next_file.data(), 13);
+
+  auto write = [&dir](const std::string& name, const std::string& data) {
+    std::ofstream(dir / name, std::ios::binary) << data;
+  };
+  write("binlog.000001", magic + events + rotate);
+  // Not named by the rotate event, so it is never read.
+  write("binlog.000002", magic + std::string(64, '\0'));
+  // The server is writing the last event.
+  write("binlog.000003", magic + events + events.substr(0, 10));
+  write("binlog.index", "./binlog.000001\n./binlog.000002\n./binlog.000003\n");
+
+  const auto files = cdc::BinlogFileBufferSource::discover(dir.string());
+  ASSERT_EQ(files.size(), 3);
+  EXPECT_EQ(std::filesystem::path(files[2]).filename(), next_file);
+  EXPECT_EQ(
+      cdc::BinlogFileBufferSource::discover((dir / "binlog.index").string()), files
+  );
+
+  cdc::TestBufferSource expected_source(events.data(), events.size());
+  size_t count = 0;
+  while (expected_source.getData()) {
+    ++count;
+  }
+
+  std::optional<cdc::BinlogPosition> live_position;
+  cdc::CatchUpBufferSource source(
+      std::make_unique<cdc::BinlogFileBufferSource>(files),
+      [&](const cdc::BinlogPosition& position) {
+        live_position = position;
+        return std::make_unique<cdc::TestBufferSource>(events.data(), events.size());
+      }
+  );
+  std::vector<cdc::Buffer> buffers;
+
+  while (source.getBatch(buffers, 16) != 0) {
+  }
+
+  // Both files with their rotate events, the rotate event ending the first one and the
+  // live stream.
+  EXPECT_EQ(buffers.size(), 3 * count + 3);
+  ASSERT_TRUE(live_position);
+  EXPECT_EQ(*live_position, (cdc::BinlogPosition{next_file, 4 + events.size()}));
+}
+
+TEST(BinlogFileBufferSource, Checksums)
+{
+  const auto events = getFileData("../../static/binlog/test2.bin");
+  const auto checksummed = withChecksums(events);
+  const auto dir = std::filesystem::temp_directory_path() / "cdc_replay_crc32_test";
+  std::filesystem::remove_all(dir);
+  std::filesystem::create_directories(dir);
+
+  const std::string magic("\xfe\x62\x69\x6e", 4);
+  const std::string next_file = "binlog.000002";
+  // Rotate event with the checksum the format of the file describes.
+  std::string rotate(binlog::LOG_EVENT_HEADER_LEN + 8 + next_file.size(), '\0');
+  // Positions grow by the checksums while they are added.
+  const auto rotate_pos = magic.size() + checksummed.size() + rotate.size();
+  const auto rotate_size = static_cast<uint32_t>(rotate.size());
+  const uint64_t next_pos = 4;
+  rotate[binlog::EVENT_TYPE_OFFSET] = binlog::event::ROTATE_EVENT;
+  std::memcpy(rotate.data() + binlog::DATA_WRITTEN_OFFSET, &rotate_size, 4);
+  std::memcpy(rotate.data() + binlog::LOG_POS_OFFSET, &rotate_pos, 4);
+  std::memcpy(rotate.data() + binlog::LOG_EVENT_HEADER_LEN, &next_pos, 8);
+  std::memcpy(rotate.data() + binlog::LOG_EVENT_HEADER_LEN + 8, next_file.data(), 13);
+  // The format description event of the events precedes the rotate event.
+  rotate = withChecksums(events.substr(0, 252) + rotate).substr(252);
+
+  std::vector<std::string> files;
+  for (const auto& [name, data] :
+       {std::pair{"binlog.000001", magic + checksummed + rotate},
+        std::pair{"binlog.000002", magic + checksummed}})
+  {
+    files.push_back((dir / name).string());
+    std::ofstream(files.back(), std::ios::binary) << data;
+  }
+
+  auto diffs = [](cdc::BufferSourceI::UPtr buffer_source) {
+    cdc::TableDiffSource source(
+        uptr<cdc::EventSource>(std::move(buffer_source), nullptr), nullptr
+    );
+    std::vector<std::pair<cdc::TableDiff::Type, std::string>> result;
+
+    while (auto diff = source.getData()) {
+      result.emplace_back(diff->type, std::string(diff->row.view()));
+    }
+    return result;
+  };
+
+  const auto file_diffs =
+      diffs(uptr<cdc::TestBufferSource>(events.data(), events.size()));
+  auto expected = file_diffs;
+  expected.insert(expected.end(), file_diffs.begin(), file_diffs.end());
+
+  ASSERT_GT(file_diffs.size(), 4);
+  // Rows and rotate events are parsed without their checksums.
+  EXPECT_EQ(diffs(uptr<cdc::BinlogFileBufferSource>(files)), expected);
+}
+
+TEST(BinlogIndex, SeekAndUpdate)
+{
+  const auto events = getFileData("../../static/binlog/test2.bin");
+  const auto dir = std::filesystem::temp_directory_path() / "cdc_binlog_index_test";
+  const auto path = (dir / "binlog.000001").string();
+  const std::string magic("\xfe\x62\x69\x6e", 4);
+  const cdc::BinlogIndexOptions options{.interval = 4};
+  std::filesystem::remove_all(dir);
+  std::filesystem::create_directories(dir);
+
+  // The server is writing the third transaction.
+  std::ofstream(path, std::ios::binary) << magic << events.substr(0, 2100);
+  EXPECT_EQ(cdc::BinlogIndex::update(path, options), 10);
+  EXPECT_EQ(cdc::BinlogIndex::update(path, options), 0);
+
+  std::ofstream(path, std::ios::binary | std::ios::app) << events.substr(2100);
+  EXPECT_EQ(cdc::BinlogIndex::update(path, options), 15);
+
+  const auto index = cdc::BinlogIndex::open(path, options);
+  const auto entries = index.entries();
+  EXPECT_EQ(index.indexedBytes(), magic.size() + events.size());
+  // Five transactions and every fourth of 25 events, two of them start transactions.
+  ASSERT_EQ(entries.size(), 11);
+  const auto starts =
+      std::count_if(entries.begin(), entries.end(), [](const auto& entry) {
+        return entry.transactionStart();
+      });
+  EXPECT_EQ(starts, 5);
+
+  // The incremental index is the same as the one built at once.
+  std::filesystem::remove(cdc::BinlogIndex::pathOf(path));
+  const auto rebuilt = cdc::BinlogIndex::open(path, options);
+  ASSERT_EQ(rebuilt.entries().size(), entries.size());
+  EXPECT_EQ(
+      std::memcmp(rebuilt.entries().data(), entries.data(), entries.size_bytes()), 0
+  );
+
+  // The position after a commit is the start of the next transaction.
+  EXPECT_EQ(index.atPosition(2632, true)->offset, 2632);
+  EXPECT_EQ(index.atPosition(2700, true)->offset, 2632);
+  EXPECT_EQ(index.atPosition(2700, false)->offset, 2670);
+  EXPECT_EQ(index.atPosition(3, false), nullptr);
+
+  EXPECT_EQ(index.atTime(1749460862)->offset, 334);
+  EXPECT_EQ(index.atTime(1749460863), nullptr);
+  EXPECT_EQ(
+      cdc::BinlogIndex::seekTime({path}, 0, options),
+      (cdc::BinlogPosition{"binlog.000001", 334})
+  );
+}
+
+TEST(BinlogIndex, QueryBoundaries)
+{
+  const auto events = getFileData("../../static/binlog/test2.bin");
+  const auto dir = std::filesystem::temp_directory_path() / "cdc_binlog_index_query_test";
+  const std::string magic("\xfe\x62\x69\x6e", 4);
+  const cdc::BinlogIndexOptions options{.interval = 0};
+  std::filesystem::remove_all(dir);
+  std::filesystem::create_directories(dir);
+
+  uint32_t format_size;
+  std::memcpy(&format_size, events.data() + binlog::DATA_WRITTEN_OFFSET, 4);
+
+  // Transactions of a server without GTIDs: a statement logged alone, one of a
+  // non-transactional table and one ending with an XID.
+  const auto queries =
+      makeQueryEvent("CREATE TABLE t (id INT)") + makeQueryEvent("BEGIN") +
+      makeQueryEvent("COMMIT") + makeQueryEvent("BEGIN") +
+      std::string(XID_BUFFER, sizeof(XID_BUFFER) - 1) + makeQueryEvent("BEGIN");
+  const auto format = std::string_view(events).substr(0, format_size);
+
+  for (const bool checksums : {false, true}) {
+    const auto path = (dir / (checksums ? "binlog.000002" : "binlog.000001")).string();
+    const auto data = std::string(format) + queries;
+
+    std::ofstream(path, std::ios::binary)
+        << magic << (checksums ? withChecksums(data) : data);
+
+    const auto index = cdc::BinlogIndex::open(path, options);
+    std::vector<uint64_t> starts;
+
+    for (const auto& entry : index.entries()) {
+      if (entry.transactionStart()) {
+        starts.push_back(entry.offset);
+      }
+    }
+    const size_t checksum = checksums ? 4 : 0;
+    const auto query_size = [&](size_t text_size) {
+      return binlog::LOG_EVENT_HEADER_LEN + binlog::event::QUERY_HEADER_LEN + 1 +
+             text_size + checksum;
+    };
+    // The format description event has a checksum either way.
+    const auto first = magic.size() + format_size;
+    const auto second = first + query_size(23);
+    const auto third = second + query_size(5) + query_size(6);
+    const auto fourth = third + query_size(5) + sizeof(XID_BUFFER) - 1 + checksum;
+
+    EXPECT_EQ(starts, (std::vector<uint64_t>{first, second, third, fourth}));
+  }
+}
+
+TEST(ParallelReplaySource, Order)
+{
+  const auto events = getFileData("../../static/binlog/test2.bin");
+  const auto dir = std::filesystem::temp_directory_path() / "cdc_parallel_replay_test";
+  const std::string magic("\xfe\x62\x69\x6e", 4);
+  const auto applied = binlog::GtidSet::parse("3e11fa47-71ca-11e1-9e33-c80aa9429562:1-5");
+  std::filesystem::remove_all(dir);
+  std::filesystem::create_directories(dir);
+
+  std::vector<std::string> files;
+  for (const auto* name : {"binlog.000001", "binlog.000002", "binlog.000003"}) {
+    files.push_back((dir / name).string());
+    std::ofstream(files.back(), std::ios::binary) << magic << events;
+  }
+
+  // Sizes of the diffs and the commit positions of the transactions.
+  auto collect = [](cdc::TransactionSourceI& source) {
+    std::vector<std::pair<size_t, std::optional<cdc::BinlogPosition>>> result;
+
+    while (auto transaction = source.getData()) {
+      result.emplace_back(transaction->diffs.size(), transaction->diffs.back().position);
+    }
+    return result;
+  };
+  auto serial = [&](std::optional<cdc::BinlogPosition> start_position) {
+    cdc::TransactionSource source(
+        uptr<cdc::TableDiffSource>(
+            uptr<cdc::EventSource>(
+                uptr<cdc::BinlogFileBufferSource>(files, start_position), nullptr, applied
+            ),
+            nullptr, applied
+        ),
+        nullptr
+    );
+    return collect(source);
+  };
+
+  // Every transaction is a chunk, more of them than the workers.
+  cdc::ParallelReplaySource source(
+      files, {.workers = 3, .chunk_bytes = 1, .max_chunks = 4}, std::nullopt, applied
+  );
+  const auto transactions = collect(source);
+
+  ASSERT_EQ(transactions.size(), 12);
+  EXPECT_EQ(transactions, serial(std::nullopt));
+  EXPECT_EQ(
+      transactions.back().second,
+      (cdc::BinlogPosition{"binlog.000003", 4 + events.size(), applied.toString()})
+  );
+
+  // Resuming after the first transaction of the second file.
+  const cdc::BinlogPosition start_position{"binlog.000002", 2069};
+  cdc::ParallelReplaySource resumed(files, {.workers = 2}, start_position, applied);
+  const auto resumed_transactions = collect(resumed);
+
+  ASSERT_EQ(resumed_transactions.size(), 7);
+  EXPECT_EQ(resumed_transactions, serial(start_position));
+}
+
+TEST(ParallelReplaySource, Checksums)
+{
+  const auto events = getFileData("../../static/binlog/test2.bin");
+  const auto dir = std::filesystem::temp_directory_path() / "cdc_parallel_crc32_test";
+  const std::string magic("\xfe\x62\x69\x6e", 4);
+  // Chunks start with a previous GTIDs event of the set.
+  const auto applied = binlog::GtidSet::parse("3e11fa47-71ca-11e1-9e33-c80aa9429562:1-5");
+  std::filesystem::remove_all(dir);
+  std::filesystem::create_directories(dir);
+
+  std::vector<std::string> files;
+  for (const auto* name : {"binlog.000001", "binlog.000002", "binlog.000003"}) {
+    files.push_back((dir / name).string());
+    std::ofstream(files.back(), std::ios::binary) << magic << withChecksums(events);
+  }
+
+  // Row images and commit positions of the transactions.
+  auto collect = [](cdc::TransactionSourceI& source, bool positions) {
+    std::vector<std::string> result;
+
+    while (auto transaction = source.getData()) {
+      for (const auto& diff : transaction->diffs) {
+        result.emplace_back(diff.row.view());
+      }
+      if (positions) {
+        const auto& position = *transaction->diffs.back().position;
+        result.push_back(fmt::format(
+            "{}:{}:{}", position.file, position.position, position.gtid_set
+        ));
+      }
+    }
+    return result;
+  };
+  auto serial = [&](cdc::BufferSourceI::UPtr buffer_source, bool positions) {
+    cdc::TransactionSource source(
+        uptr<cdc::TableDiffSource>(
+            uptr<cdc::EventSource>(std::move(buffer_source), nullptr, applied),
+            nullptr, applied
+        ),
+        nullptr
+    );
+    return collect(source, positions);
+  };
+
+  cdc::ParallelReplaySource source(
+      files, {.workers = 3, .chunk_bytes = 1}, std::nullopt, applied
+  );
+  const auto transactions = collect(source, true);
+
+  ASSERT_FALSE(transactions.empty());
+  EXPECT_EQ(transactions, serial(uptr<cdc::BinlogFileBufferSource>(files), true));
+
+  // The checksums are not a part of the rows.
+  const auto file_rows =
+      serial(uptr<cdc::TestBufferSource>(events.data(), events.size()), false);
+  std::vector<std::string> rows;
+  std::copy_if(
+      transactions.begin(), transactions.end(), std::back_inserter(rows),
+      [](const auto& item) {
+        return !item.starts_with("binlog.");
+      }
+  );
+  ASSERT_EQ(rows.size(), 3 * file_rows.size());
+  for (size_t i = 0; i < rows.size(); ++i) {
+    EXPECT_EQ(rows[i], file_rows[i % file_rows.size()]);
+  }
+}
+
+TEST(ParallelReplaySource, QueryBoundaries)
+{
+  const auto events = getFileData("../../static/binlog/test2.bin");
+  const auto dir = std::filesystem::temp_directory_path() / "cdc_parallel_query_test";
+  const std::string magic("\xfe\x62\x69\x6e", 4);
+  const auto applied = binlog::GtidSet::parse("3e11fa47-71ca-11e1-9e33-c80aa9429562:1-5");
+  std::filesystem::remove_all(dir);
+  std::filesystem::create_directories(dir);
+
+  // Transactions of non-transactional tables end with `COMMIT`, statements logged alone
+  // end at themselves.
+  std::string data;
+  for (size_t offset = 0; offset < events.size();) {
+    uint32_t event_size;
+    uint32_t log_pos;
+    std::memcpy(&event_size, events.data() + offset + binlog::DATA_WRITTEN_OFFSET, 4);
+    std::memcpy(&log_pos, events.data() + offset + binlog::LOG_POS_OFFSET, 4);
+
+    if (events[offset + binlog::EVENT_TYPE_OFFSET] == binlog::event::XID_EVENT) {
+      data += makeQueryEvent("COMMIT", log_pos);
+      data += makeQueryEvent("CREATE TABLE t (id INT)");
+    } else {
+      data += events.substr(offset, event_size);
+    }
+    offset += event_size;
+  }
+
+  const auto path = (dir / "binlog.000001").string();
+  std::ofstream(path, std::ios::binary) << magic << data;
+
+  auto collect = [](cdc::TransactionSourceI& source) {
+    std::vector<std::pair<size_t, std::optional<cdc::BinlogPosition>>> result;
+
+    while (auto transaction = source.getData()) {
+      result.emplace_back(transaction->diffs.size(), transaction->diffs.back().position);
+    }
+    return result;
+  };
+  cdc::TransactionSource serial(
+      uptr<cdc::TableDiffSource>(
+          uptr<cdc::EventSource>(
+              uptr<cdc::BinlogFileBufferSource>(std::vector{path}), nullptr, applied
+          ),
+          nullptr, applied
+      ),
+      nullptr
+  );
+  // Every transaction and statement is a chunk.
+  cdc::ParallelReplaySource source(
+      {path}, {.workers = 3, .chunk_bytes = 1}, std::nullopt, applied
+  );
+  const auto transactions = collect(source);
+
+  ASSERT_EQ(transactions.size(), 4);
+  EXPECT_EQ(transactions, collect(serial));
+}
+
 TEST(ChangeDataCapture, Convertion)
 {
   const auto events_buffer = getFileData("../../static/binlog/test2.bin");
@@ -615,13 +2234,19 @@ TEST(ChangeDataCapture, Convertion)
       }
   );
 
+  auto transaction_source = uptr<cdc::TransactionSource>(
+      std::move(table_diff_source),
+      [](const cdc::TransactionBatch& transaction) {
+      }
+  );
+
   auto otterbrix_consumer = uptr<cdc::TestOtterBrixConsumerSink>();
   auto* otterbrix_consumer_raw_ptr = otterbrix_consumer.get();
   auto otterbrik_diff_sink = uptr<cdc::OtterBrixDiffSink>(
       std::move(otterbrix_consumer), otterbrix_consumer->resource()
   );
   auto main_process = uptr<cdc::MainProcess>(
-      std::move(table_diff_source), std::move(otterbrik_diff_sink)
+      std::move(transaction_source), std::move(otterbrik_diff_sink)
   );
 
   main_process->process();
@@ -629,6 +2254,180 @@ TEST(ChangeDataCapture, Convertion)
   ASSERT_NE(otterbrix_consumer_raw_ptr, nullptr);
 
   otterbrix_consumer_raw_ptr->testFinalState();
+  EXPECT_TRUE(otterbrix_consumer_raw_ptr->verify());
+  EXPECT_TRUE(otterbrix_consumer_raw_ptr->verifyAsync().get());
+}
+
+TEST(ChangeDataCapture, ParallelApply)
+{
+  const auto events_buffer = getFileData("../../static/binlog/test2.bin");
+  auto transaction_source = uptr<cdc::TransactionSource>(
+      uptr<cdc::TableDiffSource>(
+          uptr<cdc::EventSource>(
+              uptr<cdc::TestBufferSource>(events_buffer.data(), events_buffer.size()),
+              nullptr
+          ),
+          nullptr
+      ),
+      nullptr
+  );
+
+  auto otterbrix_consumer = uptr<cdc::TestOtterBrixConsumerSink>();
+  auto* otterbrix_consumer_raw_ptr = otterbrix_consumer.get();
+  auto main_process = uptr<cdc::MainProcess>(
+      std::move(transaction_source),
+      uptr<cdc::ParallelDiffSink>(std::move(otterbrix_consumer))
+  );
+
+  main_process->process();
+
+  otterbrix_consumer_raw_ptr->testFinalState();
+  EXPECT_TRUE(otterbrix_consumer_raw_ptr->verify());
+}
+
+TEST(ChangeDataCapture, PartitionedApply)
+{
+  const auto events_buffer = getFileData("../../static/binlog/test2.bin");
+  auto transaction_source = uptr<cdc::TransactionSource>(
+      uptr<cdc::TableDiffSource>(
+          uptr<cdc::EventSource>(
+              uptr<cdc::TestBufferSource>(events_buffer.data(), events_buffer.size()),
+              nullptr
+          ),
+          nullptr
+      ),
+      nullptr
+  );
+
+  auto otterbrix_consumer = uptr<cdc::TestOtterBrixConsumerSink>();
+  auto* otterbrix_consumer_raw_ptr = otterbrix_consumer.get();
+  auto* resource = otterbrix_consumer->resource();
+  auto main_process = uptr<cdc::MainProcess>(
+      std::move(transaction_source),
+      uptr<cdc::OtterBrixDiffSink>(
+          uptr<cdc::PartitionedConsumerSink>(std::move(otterbrix_consumer), 4), resource,
+          cdc::PlanBatchOptions{.partitions = 4}
+      )
+  );
+
+  main_process->process();
+
+  otterbrix_consumer_raw_ptr->testFinalState();
+  EXPECT_TRUE(otterbrix_consumer_raw_ptr->verify());
+}
+
+TEST(ChangeDataCapture, ConcurrentApply)
+{
+  const auto events_buffer = getFileData("../../static/binlog/test2.bin");
+  auto transaction_source = uptr<cdc::TransactionSource>(
+      uptr<cdc::TableDiffSource>(
+          uptr<cdc::EventSource>(
+              uptr<cdc::TestBufferSource>(events_buffer.data(), events_buffer.size()),
+              nullptr
+          ),
+          nullptr
+      ),
+      nullptr
+  );
+
+  auto otterbrix_consumer = uptr<cdc::OverlapOtterBrixConsumerSink>();
+  auto* otterbrix_consumer_raw_ptr = otterbrix_consumer.get();
+  auto* resource = otterbrix_consumer->resource();
+  auto main_process = uptr<cdc::MainProcess>(
+      std::move(transaction_source),
+      uptr<cdc::OtterBrixDiffSink>(
+          uptr<cdc::PartitionedConsumerSink>(std::move(otterbrix_consumer), 4), resource,
+          cdc::PlanBatchOptions{.partitions = 4}
+      )
+  );
+
+  main_process->process();
+
+  // Plans of several partitions are executed at once.
+  EXPECT_GE(otterbrix_consumer_raw_ptr->peak, 2);
+}
+
+TEST(ChangeDataCapture, VerificationBetweenTransactions)
+{
+  using namespace std::chrono_literals;
+  const auto events_buffer = getFileData("../../static/binlog/test2.bin");
+  cdc::TestOtterBrixConsumerSink otterbrix_consumer;
+
+  conveyor::Pipeline pipeline(
+      conveyor::SourceStage(
+          uptr<cdc::TestBufferSource>(events_buffer.data(), events_buffer.size())
+      ),
+      cdc::ParseStage(), cdc::TableDiffStage(), cdc::TransactionStage(),
+      cdc::PlanStage(otterbrix_consumer.resource()), cdc::ApplyStage(otterbrix_consumer)
+  );
+
+  pipeline.process();
+
+  // E.g. a transaction spread over partitions, not all of them applied yet.
+  otterbrix_consumer.beginTransaction();
+  auto verified = otterbrix_consumer.verifyAsync();
+
+  EXPECT_EQ(verified.wait_for(100ms), std::future_status::timeout);
+  otterbrix_consumer.endTransaction();
+  EXPECT_TRUE(verified.get());
+}
+
+TEST(ChangeDataCapture, Indexes)
+{
+  const auto events_buffer = getFileData("../../static/binlog/test2.bin");
+  cdc::TestOtterBrixConsumerSink otterbrix_consumer({
+      .secondary =
+          {{"e_store.table", {"small_varchar"}}, {"e_store.table", {"s_int", "char"}}}
+  });
+
+  conveyor::Pipeline pipeline(
+      conveyor::SourceStage(
+          uptr<cdc::TestBufferSource>(events_buffer.data(), events_buffer.size())
+      ),
+      cdc::ParseStage(), cdc::TableDiffStage(), cdc::TransactionStage(),
+      cdc::PlanStage(otterbrix_consumer.resource()), cdc::ApplyStage(otterbrix_consumer)
+  );
+
+  pipeline.process();
+
+  // Indexes don't change the applied data.
+  otterbrix_consumer.testFinalState();
+  EXPECT_TRUE(otterbrix_consumer.verify());
+
+  // The indexes exist, so they can't be created again, unlike an index of other fields.
+  using components::cursor::error_code_t;
+  const auto exists = error_code_t::index_create_fail;
+  EXPECT_EQ(otterbrix_consumer.tryCreateIndex({"_id"}), exists);
+  EXPECT_EQ(otterbrix_consumer.tryCreateIndex({"small_varchar"}), exists);
+  EXPECT_EQ(otterbrix_consumer.tryCreateIndex({"s_int", "char"}), exists);
+  EXPECT_EQ(otterbrix_consumer.tryCreateIndex({"s_bigint"}), error_code_t::none);
+}
+
+TEST(ChangeDataCapture, StaticPipeline)
+{
+  const auto events_buffer = getFileData("../../static/binlog/test2.bin");
+  cdc::TestOtterBrixConsumerSink otterbrix_consumer;
+  size_t plans = 0;
+
+  conveyor::Pipeline pipeline(
+      conveyor::SourceStage(
+          uptr<cdc::TestBufferSource>(events_buffer.data(), events_buffer.size())
+      ),
+      cdc::ParseStage(), cdc::TableDiffStage(), cdc::TransactionStage(),
+      cdc::PlanStage(
+          otterbrix_consumer.resource(), cdc::PlanBatchOptions{},
+          [&plans](const cdc::ExtendedNode&) {
+            ++plans;
+          }
+      ),
+      cdc::ApplyStage(otterbrix_consumer)
+  );
+
+  pipeline.process();
+
+  EXPECT_NE(plans, 0);
+  otterbrix_consumer.testFinalState();
+  EXPECT_TRUE(otterbrix_consumer.verify());
 }
 
 int main(int argc, char** argv)